@@ -0,0 +1,74 @@
+#ifndef CRETE_NEGATION_POOL_H
+#define CRETE_NEGATION_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <deque>
+
+namespace klee {
+class InterpreterHandler;
+}
+
+typedef std::vector<std::pair<std::string, std::vector<unsigned char> > > negation_solution_ty;
+
+/* Solves negated branches of the concolic path in worker processes, while the
+ * replay continues on the concrete path.
+ *
+ * A worker is a fork() of klee taken at the branch, so that it owns a copy of the
+ * path-prefix constraints and of the solver. Klee expressions and the solvers are
+ * not thread-safe, which rules out worker threads. The worker leaves its solution
+ * in a file of the output directory, which is turned into a test case by the main
+ * process once the worker is reaped, so that test cases are numbered by a single
+ * process.
+ */
+class NegationWorkerPool
+{
+public:
+    NegationWorkerPool(klee::InterpreterHandler *handler, unsigned max_workers);
+    ~NegationWorkerPool();
+
+    // Forks a worker, after waiting for a free slot. Returns as fork(): 0 in the
+    // worker, which must end with finish_worker(), the pid of the worker in klee,
+    // or -1 on failure.
+    pid_t spawn();
+    // Worker side: writes the solution (if any) and exits the worker
+    void finish_worker(bool solved,
+                       const negation_solution_ty &solution,
+                       const std::vector<uint64_t> &addresses);
+
+    // Turns the solutions of finished workers into test cases, without blocking
+    void collect();
+    // Waits for all the workers and turns their solutions into test cases
+    void wait_all();
+
+    uint64_t get_spawned_count() const { return m_spawned; }
+    uint64_t get_solved_count() const { return m_solved; }
+
+private:
+    struct Worker
+    {
+        pid_t m_pid;
+        std::string m_solution_file;
+    };
+
+    std::string get_solution_file(uint64_t job) const;
+    // Reaps w, blocking if wait is set. Returns false if w is still running.
+    bool reap(const Worker &w, bool wait);
+
+private:
+    klee::InterpreterHandler *m_handler;
+    unsigned m_max_workers;
+    std::deque<Worker> m_workers; // running workers, by order of spawn
+
+    bool m_is_worker;
+    std::string m_worker_solution_file;
+
+    uint64_t m_spawned;
+    uint64_t m_solved;
+};
+
+#endif // CRETE_NEGATION_POOL_H
@@ -9,6 +9,8 @@
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/map.hpp>
 
+#include "crete/trace_file.h"
+
 using namespace std;
 
 namespace klee {
@@ -28,6 +30,9 @@ extern uint64_t g_test_case_count;
 const uint64_t KLEE_ALLOC_RANGE_LOW  = 0x70000000;
 const uint64_t KLEE_ALLOC_RANGE_HIGH = 0x7FFFFFFF;
 
+// Size of the pages modelling guest memory (see MemoryManager::allocateGuestPage())
+const uint64_t CRETE_GUEST_PAGE_SIZE = 4096;
+
 /*****************************/
 /* Functions for klee */
 QemuRuntimeInfo* qemu_rt_info_initialize();
@@ -84,6 +89,48 @@ struct CPUStateElement{
     }
 };
 
+// Compact record of a CPUState field changed by code out of interest, whose bytes are
+// stored in CPUStateSyncTable::m_data, starting from m_data_offset
+struct CPUStateSideEffect {
+    uint32_t m_field_id; // index of the field within the table of traced CPUState fields
+    uint32_t m_offset;
+    uint32_t m_size;
+    uint32_t m_data_offset;
+
+    CPUStateSideEffect(uint32_t field_id, uint32_t offset, uint32_t size, uint32_t data_offset)
+    :m_field_id(field_id), m_offset(offset), m_size(size), m_data_offset(data_offset) {}
+
+    // For serialization
+    CPUStateSideEffect()
+    :m_field_id(0), m_offset(0), m_size(0), m_data_offset(0) {}
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_field_id;
+        ar & m_offset;
+        ar & m_size;
+        ar & m_data_offset;
+    }
+};
+
+struct CPUStateSyncTable {
+    bool m_valid;
+    vector<CPUStateSideEffect> m_elements;
+    vector<uint8_t> m_data;
+
+    CPUStateSyncTable()
+    :m_valid(false) {}
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_valid;
+        ar & m_elements;
+        ar & m_data;
+    }
+};
+
 struct QemuInterruptInfo {
     int m_intno;
     int m_is_int;
@@ -108,14 +155,30 @@ struct QemuInterruptInfo {
     }
 };
 
-typedef vector< pair<uint64_t, uint8_t> > memoSyncTable_ty;
-typedef vector<memoSyncTable_ty> memoSyncTables_ty;
+// Contiguous guest memory bytes loaded by a TB, whose values are stored in
+// MemoSyncTable::m_data, starting from m_data_offset
+struct MemoSyncRun {
+    uint64_t m_addr;
+    uint32_t m_size;
+    uint32_t m_data_offset;
+
+    MemoSyncRun(uint64_t addr, uint32_t size, uint32_t data_offset)
+    :m_addr(addr), m_size(size), m_data_offset(data_offset) {}
+};
+
+// Runs are sorted by address and neither overlap nor adjoin each other
+struct MemoSyncTable {
+    vector<MemoSyncRun> m_runs;
+    vector<uint8_t> m_data;
+};
+
+typedef MemoSyncTable memoSyncTable_ty;
+
+typedef CPUStateSyncTable cpuStateSyncTable_ty;
 
 // bool: valid table or not
 // vector<>: contents
-typedef pair<bool, vector<CPUStateElement> > cpuStateSyncTable_ty;
-
-typedef pair<QemuInterruptInfo, bool> interruptState_ty;
+typedef pair<bool, vector<CPUStateElement> > debug_cpuStateSyncTable_ty;
 
 class QemuRuntimeInfo {
 private:
@@ -124,8 +187,17 @@ private:
 	concolics_ty m_concolics;
 
 	vector<uint8_t> m_initial_cpuState;
-    vector<cpuStateSyncTable_ty> m_cpuStateSyncTables;
-	memoSyncTables_ty m_memoSyncTables;
+
+	// "dump_trace.bin": cpuState sync tables, memo sync tables and interrupt states,
+	// which are mmap'ed and decoded on demand for the TB being replayed
+	crete::trace::TraceReader m_trace;
+	// Whether the trace has the concrete writes of sliced TBs
+	bool m_has_tbPostSyncTables;
+
+	// The memo sync table decoded last, and the scratch bytes to decode it
+	uint64_t m_memoSyncTable_index;
+	memoSyncTable_ty m_memoSyncTable;
+	vector< pair<uint64_t, uint8_t> > m_memoSyncBytes;
 
 	// For Streaming Tracing
     uint64_t m_streamed_tb_count;
@@ -133,9 +205,7 @@ private:
 
     // For Debugging Purpose:
     // The CPUState after each interested TB being executed for cross checking on klee side
-    vector<cpuStateSyncTable_ty> m_debug_cpuStateSyncTables;
-	// Interrupt State Info dumped from QEMU
-	vector< interruptState_ty > m_interruptStates;
+    vector<debug_cpuStateSyncTable_ty> m_debug_cpuStateSyncTables;
 
 public:
 	QemuRuntimeInfo();
@@ -145,9 +215,12 @@ public:
 	vector<uint8_t> get_initial_cpuState();
 
 	void sync_cpuState(klee::ObjectState *wos, uint64_t tb_index);
+	// Apply the concrete writes left out of the bitcode of a sliced TB
+	void sync_cpuState_post_tb(klee::ObjectState *wos, uint64_t tb_index);
 	void cross_check_cpuState(klee::ExecutionState &state,
 	        klee::ObjectState *wos, uint64_t tb_index);
 
+	// Valid until the next call
 	const memoSyncTable_ty& get_memoSyncTable(uint64_t tb_index);
 
 	// For Debugging
@@ -166,12 +239,13 @@ private:
 	void cleanup_concolics();
 
 	void read_streamed_trace();
-	uint32_t read_cpuSyncTables();
+	void apply_cpuSyncRecords(klee::ObjectState *wos, crete::trace::ChunkType type,
+	        uint64_t tb_index);
+	void read_cpuSyncTable(uint64_t tb_index, cpuStateSyncTable_ty &cpuStateSyncTable) const;
 	uint32_t read_debug_cpuSyncTables();
 	void read_debug_cpuState_offsets();
 
-	void init_memoSyncTables();
-	void init_interruptStates();
+	void read_memoSyncTable(uint64_t tb_index, memoSyncTable_ty &memoSyncTable);
 	//    uint32_t read_memoSyncTables();
 	//    uint32_t read_interruptStates();
 
@@ -182,6 +256,7 @@ private:
 	// Debugging
 	void init_debug_cpuOffsetTable();
 	void print_memoSyncTables();
+	void print_memoSyncRuns(const memoSyncTable_ty &table) const;
 	void print_cpuSyncTable(uint64_t tb_index) const;
 
 public:
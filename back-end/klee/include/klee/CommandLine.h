@@ -29,6 +29,12 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+extern llvm::cl::opt<std::string> SolverCacheFile;
+
+extern llvm::cl::opt<unsigned> SolverCacheSize;
+
+extern llvm::cl::opt<bool> IncrementalCoreSolver;
+
 ///The different query logging solvers that can switched on/off
 enum QueryLoggingSolverType
 {
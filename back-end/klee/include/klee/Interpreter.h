@@ -45,6 +45,14 @@ public:
   virtual void processTestCase(const ExecutionState &state,
                                const char *err, 
                                const char *suffix) = 0;
+
+#if defined(CRETE_CONFIG)
+  // Test case of a solution computed out of any live state, e.g. by a solver
+  // worker (see NegationWorkerPool)
+  virtual void processTestCaseSolution(const std::vector< std::pair<std::string,
+                                       std::vector<unsigned char> > > &solution,
+                                       const std::vector<uint64_t> &addresses) = 0;
+#endif // CRETE_CONFIG
 };
 
 class Interpreter {
@@ -283,6 +283,14 @@ namespace klee {
   Solver *createSMTLIBLoggingSolver(Solver *s, std::string path,
                                     int minQueryTimeToLog);
 
+  /// createPersistentCachingSolver - Create a solver which will cache query
+  /// results in the file at the given path, shared by all the processes using
+  /// it. A new file holds size bytes of results, evicting the least recently
+  /// used ones. Half of them is a log for the results larger than a slot of
+  /// the cache, such as the initial values of inputs, which are evicted in
+  /// order.
+  Solver *createPersistentCachingSolver(Solver *s, const std::string &path,
+                                        uint64_t size);
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
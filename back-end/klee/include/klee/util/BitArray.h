@@ -35,6 +35,32 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  // Word-wide operations over the bits of [begin, end)
+  bool isAllSet(unsigned begin, unsigned end) const {
+    while (begin < end) {
+      uint32_t mask = rangeMask(begin, end);
+      if ((bits[begin/32] & mask) != mask)
+        return false;
+      begin = (begin & ~0x1Fu) + 32;
+    }
+    return true;
+  }
+  void setRange(unsigned begin, unsigned end) {
+    while (begin < end) {
+      bits[begin/32] |= rangeMask(begin, end);
+      begin = (begin & ~0x1Fu) + 32;
+    }
+  }
+
+private:
+  // Mask of the bits of [begin, end) within the word of begin
+  static uint32_t rangeMask(unsigned begin, unsigned end) {
+    unsigned shift = begin & 0x1F;
+    unsigned count = end - begin < 32 - shift ? end - begin : 32 - shift;
+    uint32_t mask = count == 32 ? 0xFFFFFFFFu : ((1u << count) - 1);
+    return mask << shift;
+  }
 };
 
 } // End klee namespace
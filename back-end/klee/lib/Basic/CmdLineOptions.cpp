@@ -55,6 +55,30 @@ CoreSolverOptimizeDivides("solver-optimize-divides",
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=on)"),
                  llvm::cl::init(true));
 
+llvm::cl::opt<std::string>
+SolverCacheFile("solver-cache-file",
+                llvm::cl::desc("Cache the results of queries reaching the solver in this file, "
+                               "shared by all the klee instances using it (default=off)"),
+                llvm::cl::init(""));
+
+llvm::cl::opt<bool>
+IncrementalCoreSolver("incremental-solver",
+                      llvm::cl::init(false),
+                      llvm::cl::desc("Keep the constraints of consecutive queries asserted in an "
+                                     "in-process STP, so that a query only asserts the constraints "
+                                     "past the common prefix with the previous one, e.g. the new "
+                                     "branches of a concolic path. Disables --use-forked-solver and "
+                                     "--use-independent-solver, and is ignored with a solver "
+                                     "timeout or metaSMT (default=off)"));
+
+llvm::cl::opt<unsigned>
+SolverCacheSize("solver-cache-size",
+                llvm::cl::desc("Size of a new --solver-cache-file, whose least recently used "
+                               "results are evicted. Half of it holds the results larger than "
+                               "480 bytes, e.g. initial values (default=256)"),
+                llvm::cl::init(256),
+                llvm::cl::value_desc("MB"));
+
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
  * if an option is set. Unfortunately with gcc4.7 cl::bits<> is broken with LLVM2.9 and I doubt everyone
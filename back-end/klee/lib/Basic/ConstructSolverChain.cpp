@@ -42,6 +42,14 @@ namespace klee
 			  << baseSolverQuerySMT2LogPath.c_str() << std::endl;
 	  }
 
+	  if (!SolverCacheFile.empty())
+	  {
+		solver = createPersistentCachingSolver(solver, SolverCacheFile,
+						       (uint64_t)SolverCacheSize << 20);
+		std::cerr << "Caching solver results in "
+			  << SolverCacheFile.c_str() << std::endl;
+	  }
+
 	  if (UseFastCexSolver)
 		solver = createFastCexSolver(solver);
 
@@ -51,7 +59,9 @@ namespace klee
 	  if (UseCache)
 		solver = createCachingSolver(solver);
 
-	  if (UseIndependentSolver)
+	  // The incremental mode keeps the path prefix asserted, which the subsets of
+	  // constraints sent by the independence solver would keep retracting
+	  if (UseIndependentSolver && !IncrementalCoreSolver)
 		solver = createIndependentSolver(solver);
 
 	  if (DebugValidateSolver)
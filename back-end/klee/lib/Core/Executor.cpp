@@ -262,6 +262,20 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+#if defined(CRETE_CONFIG)
+  cl::opt<bool>
+  CreteGuestPageMemory("crete-guest-page-memory",
+            cl::desc("Model guest memory as pages allocated on first touch, instead of objects "
+                     "of the accessed bytes being merged on overlaps (default=on)"),
+            cl::init(true));
+
+  cl::opt<unsigned>
+  CreteNegationWorkers("crete-negation-workers",
+            cl::desc("Solve negated branches of the concolic path in this many worker processes, "
+                     "while the replay continues on the concrete path (default=0 (off))"),
+            cl::init(0));
+#endif // CRETE_CONFIG
 }
 
 
@@ -295,6 +309,18 @@ Executor::Executor(const InterpreterOptions &opts,
 
   if (coreSolverTimeout) UseForkedCoreSolver = true;
 
+  // Only the forked solver can be timed out, and only STP is incremental
+  if (IncrementalCoreSolver && coreSolverTimeout) {
+    klee_warning("--incremental-solver ignored, as solver timeouts need --use-forked-solver");
+    IncrementalCoreSolver = false;
+  }
+#ifdef SUPPORT_METASMT
+  if (IncrementalCoreSolver && UseMetaSMT != METASMT_BACKEND_NONE) {
+    klee_warning("--incremental-solver ignored with --use-metasmt");
+    IncrementalCoreSolver = false;
+  }
+#endif /* SUPPORT_METASMT */
+
   Solver *coreSolver = NULL;
 
 #ifdef SUPPORT_METASMT
@@ -342,6 +368,8 @@ Executor::Executor(const InterpreterOptions &opts,
 
 #if defined(CRETE_CONFIG)
   g_qemu_rt_Info = qemu_rt_info_initialize();
+  crete_negation_pool = CreteNegationWorkers ?
+          new NegationWorkerPool(ih, CreteNegationWorkers) : 0;
 #endif // CRETE_CONFIG
 }
 
@@ -398,6 +426,7 @@ Executor::~Executor() {
   }
 
 #if defined(CRETE_CONFIG)
+  delete crete_negation_pool;
   qemu_rt_info_cleanup(g_qemu_rt_Info);
 #endif // CRETE_CONFIG
 }
@@ -3264,8 +3293,50 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       );
   }
 
+  // Fast path: an access within a page of guest memory is performed on the page
+  // directly, without resolveOne() and its bounds check. Stores allocate the page
+  // on its first touch.
+  if (CreteGuestPageMemory) {
+    uint64_t guest_address = cast<ConstantExpr>(address)->getZExtValue();
+    if (guest_address % CRETE_GUEST_PAGE_SIZE + bytes <= CRETE_GUEST_PAGE_SIZE) {
+      const ObjectState *os = NULL;
+      const MemoryObject *mo = crete_get_guest_page(state, guest_address, isWrite, os);
+      if (mo) {
+        unsigned offset = guest_address - mo->address;
+        if (isWrite) {
+          if (os->readOnly) {
+            terminateStateOnError(state,
+                                  "memory error: object read only",
+                                  "readonly.err");
+          } else {
+            ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+            wos->write(offset, value);
+          }
+        } else {
+          ref<Expr> result = os->read(offset, type);
+
+          if (interpreterOpts.MakeConcreteSymbolic)
+            result = replaceReadWithSymbolic(state, result);
+
+          bindLocal(target, state, result);
+        }
+
+        return;
+      }
+    }
+  }
+
   crete_preprocess_memory_operation(state, isWrite, address,
           value, bytes, target);
+
+  if (CreteGuestPageMemory) {
+    uint64_t guest_address = cast<ConstantExpr>(address)->getZExtValue();
+    if (guest_address % CRETE_GUEST_PAGE_SIZE + bytes > CRETE_GUEST_PAGE_SIZE) {
+      crete_execute_page_crossing_memory_operation(state, isWrite, guest_address,
+              value, type, target);
+      return;
+    }
+  }
 #endif // CRETE_CONFIG
 
   // fast path: single in-bounds resolution
@@ -3551,6 +3622,15 @@ void Executor::runFunctionAsMain(Function *f,
   delete processTree;
   processTree = 0;
 
+#if defined(CRETE_CONFIG)
+  if (crete_negation_pool) {
+    crete_negation_pool->wait_all();
+    klee_message("negation workers: %llu spawned, %llu solved",
+                 (unsigned long long)crete_negation_pool->get_spawned_count(),
+                 (unsigned long long)crete_negation_pool->get_solved_count());
+  }
+#endif // CRETE_CONFIG
+
   // hack to clear memory objects
   delete memory;
   memory = new MemoryManager();
@@ -3723,6 +3803,23 @@ void Executor::crete_init_symbolics(ExecutionState &state) {
     MemoryObject *temp_mo;
     for(concolics_ty::iterator it = temp_concolics.begin();
             it != temp_concolics.end(); ++it) {
+        if(CreteGuestPageMemory) {
+            // Pages holding concolic variables are allocated, the variables are
+            // written when crete_make_symbolic() is invoked
+            uint64_t end_addr = (*it)->m_guest_addr + (*it)->m_data_size;
+            for(uint64_t addr = (*it)->m_guest_addr; addr < end_addr;
+                    addr = (addr / CRETE_GUEST_PAGE_SIZE + 1) * CRETE_GUEST_PAGE_SIZE) {
+                const ObjectState *page_os;
+                if(!crete_get_guest_page(state, addr, true, page_os)) {
+                    state.print_stack();
+                    assert(0 && "[CRETE ERROR] the page of a concolic variable overlaps other objects\n");
+                }
+            }
+
+            state.pushCreteConcolic(**it);
+            continue;
+        }
+
         temp_mo = memory->allocateFixed((*it)->m_guest_addr, (*it)->m_data_size, 0, true);
         if(temp_mo == NULL) {
             state.print_stack();
@@ -3836,18 +3933,23 @@ Executor::crete_concolic_fork(ExecutionState &current, ref<Expr> condition)
     assert(!RandomizeFork &&
             "RandomizeFork is enabled, which means the statePair returned by fork could be swapped.\n");
 
+    ref<Expr> evalResult = current.concolics.evaluate(condition);
+    assert(isa<ConstantExpr>(evalResult));
+    ref<ConstantExpr> condition_value = dyn_cast<ConstantExpr>(evalResult);
+
     Executor::StatePair branches;
     // Fork now is only disabled when handling crete_assume()
-    if(current.crete_fork_enabled)
-    	branches = fork(current, condition, false);
+    if(current.crete_fork_enabled) {
+        // With negation workers, the current state proceeds with the concrete path
+        // below, as if fork() had not forked
+        if(!crete_negation_pool || isa<ConstantExpr>(condition) ||
+                !crete_spawn_negation(current, condition, condition_value->isTrue()))
+            branches = fork(current, condition, false);
+    }
 
     ExecutionState *trueState  = branches.first;
     ExecutionState *falseState = branches.second;
 
-    ref<Expr> evalResult = current.concolics.evaluate(condition);
-    assert(isa<ConstantExpr>(evalResult));
-    ref<ConstantExpr> condition_value = dyn_cast<ConstantExpr>(evalResult);
-
     if(trueState && falseState){
         if (condition_value->isTrue()) {
             terminateStateEarly(*falseState,
@@ -3877,6 +3979,42 @@ Executor::crete_concolic_fork(ExecutionState &current, ref<Expr> condition)
     return branches;
 }
 
+/*
+ * Hands the negated branch to a worker of crete_negation_pool, which solves the
+ * path-prefix constraints of current with the negated condition. Returns false if
+ * no worker could be spawned.
+ */
+bool Executor::crete_spawn_negation(ExecutionState &current, ref<Expr> condition,
+        bool concrete_direction)
+{
+    assert(crete_negation_pool);
+
+    pid_t pid = crete_negation_pool->spawn();
+    if(pid != 0)
+        return pid > 0;
+
+    // Worker process
+    ref<Expr> negated = concrete_direction ? Expr::createIsZero(condition) : condition;
+
+    std::vector<std::pair<std::string, std::vector<unsigned char> > > solution;
+    std::vector<uint64_t> addresses;
+    bool solved = false;
+
+    solver->setTimeout(coreSolverTimeout);
+    bool feasible = false;
+    bool success = solver->mayBeTrue(current, negated, feasible);
+    solver->setTimeout(0);
+
+    if(success && feasible) {
+        current.addConstraint(negated);
+        solved = getSymbolicSolution(current, solution, addresses);
+    }
+
+    crete_negation_pool->finish_worker(solved, solution, addresses);
+    assert(0 && "[CRETE ERROR] A negation worker should exit in finish_worker().\n");
+    return false;
+}
+
 void Executor::crete_concolic_branch(ExecutionState &state,
         const std::vector< ref<Expr> > &conditions,
         std::vector<ExecutionState*> &result)
@@ -3902,9 +4040,8 @@ void Executor::crete_concolic_branch(ExecutionState &state,
     assert(count_matched_case == 1 && "There should only be only match case.");
 }
 /*
- * Mainly to merge existing MOs, as CRETE creates memory on-the-fly
- * For read memory operation, just creat a new MO for the given address with the given size
- * if no overlapped MO was found
+ * Make sure memory being accessed exists, as CRETE creates memory on-the-fly: either
+ * the pages of guest memory, or MOs of the accessed bytes (see crete_preprocess_memory_range())
  */
 void Executor::crete_preprocess_memory_operation(ExecutionState &state,
         bool isWrite,
@@ -3916,14 +4053,51 @@ void Executor::crete_preprocess_memory_operation(ExecutionState &state,
     ConstantExpr *temp_ce =  dyn_cast<ConstantExpr>(address);
     uint64_t temp_addr = temp_ce->getZExtValue();
 
-    bool is_overlapped =  memory->isOverlappedMO(temp_addr, bytes);
+    if(!CreteGuestPageMemory) {
+        crete_preprocess_memory_range(state, isWrite, temp_addr, bytes);
+        return;
+    }
+
+    // Allocate the pages touched by a store. Accesses to memory that can't be
+    // paged (e.g. klee's own objects) fall back to objects of the accessed bytes
+    uint64_t end_addr = temp_addr + bytes;
+    for(uint64_t addr = temp_addr; addr < end_addr; ) {
+        uint64_t page_end = (addr / CRETE_GUEST_PAGE_SIZE + 1) * CRETE_GUEST_PAGE_SIZE;
+        uint64_t size = std::min(page_end, end_addr) - addr;
+
+        const ObjectState *os;
+        if(!crete_get_guest_page(state, addr, isWrite, os)) {
+            crete_preprocess_memory_range(state, isWrite, addr, size);
+        }
+
+        addr += size;
+    }
+}
+
+/// crete internal functions
+
+/*
+ * Mainly to merge existing MOs, as CRETE creates memory on-the-fly
+ * For read memory operation, just creat a new MO for the given address with the given size
+ * if no overlapped MO was found
+ */
+void Executor::crete_preprocess_memory_range(ExecutionState &state,
+        bool isWrite, uint64_t address, uint64_t size) {
+    // An object of the state already covers the range
+    ObjectPair op;
+    if(state.addressSpace.resolveOne(ConstantExpr::alloc(address, Expr::Int64), op) &&
+            address + size <= op.first->address + op.first->size) {
+        return;
+    }
+
+    bool is_overlapped =  memory->isOverlappedMO(address, size);
     if(is_overlapped){
-        crete_merge_overlapped_mos(state, temp_addr, bytes, isWrite);
+        crete_merge_overlapped_mos(state, address, size, isWrite);
     } else {
         if(!isWrite) {
             CRETE_DBG(
             std::cerr << "[CRETE Error] Missing address for load MO is: "
-                      << std::hex << temp_addr << '\n' << std::dec;
+                      << std::hex << address << '\n' << std::dec;
             state.print_stack();
             );
 
@@ -3931,7 +4105,7 @@ void Executor::crete_preprocess_memory_operation(ExecutionState &state,
         }
 
         // If no overlapped existing mo is found, just create a new mo for this address and size
-        MemoryObject *temp_mo = memory->allocateFixed(temp_addr, bytes, 0, true);
+        MemoryObject *temp_mo = memory->allocateFixed(address, size, 0, true);
         if(temp_mo == NULL) {
             state.print_stack();
             assert(0);
@@ -3940,7 +4114,92 @@ void Executor::crete_preprocess_memory_operation(ExecutionState &state,
     }
 }
 
-/// crete internal functions
+/* Return the page of guest memory holding the given address, and its os in the
+ * given state. The page is bound in the state on its first touch by the state.
+ * Return NULL if the page was not allocated and create is not set, or if the page
+ * overlaps objects other than guest pages.
+ */
+const MemoryObject *Executor::crete_get_guest_page(ExecutionState &state,
+        uint64_t address, bool create, const ObjectState *&os) {
+    uint64_t page_index = address / CRETE_GUEST_PAGE_SIZE;
+
+    MemoryObject *mo = memory->findGuestPage(page_index);
+    if(!mo) {
+        if(!create)
+            return NULL;
+
+        mo = memory->allocateGuestPage(page_index);
+        if(!mo)
+            return NULL;
+    }
+
+    os = state.addressSpace.findObject(mo);
+    if(!os) {
+        os = bindObjectInState(state, mo, false);
+    }
+
+    return mo;
+}
+
+/* An access crossing a page boundary spans two objects, which klee does not
+ * resolve, so it is split at the boundary and performed on each page, in
+ * little-endian as the guest. Memory that is not paged is resolved per object.
+ */
+void Executor::crete_execute_page_crossing_memory_operation(ExecutionState &state,
+        bool isWrite, uint64_t address, ref<Expr> value, Expr::Width type,
+        KInstruction *target) {
+    unsigned bytes = Expr::getMinBytesForWidth(type);
+    assert(type == bytes * 8 &&
+            "[CRETE ERROR] page-crossing memory operation of a non byte-sized type\n");
+
+    ref<Expr> result;
+    for(unsigned i = 0; i < bytes; ) {
+        uint64_t addr = address + i;
+        uint64_t page_end = (addr / CRETE_GUEST_PAGE_SIZE + 1) * CRETE_GUEST_PAGE_SIZE;
+
+        const ObjectState *os = NULL;
+        const MemoryObject *mo = crete_get_guest_page(state, addr, false, os);
+        if(!mo) {
+            ObjectPair op;
+            bool found = state.addressSpace.resolveOne(
+                    ConstantExpr::alloc(addr, Expr::Int64), op);
+            assert(found && "[CRETE ERROR] page-crossing memory operation on missing memory\n");
+
+            mo = op.first;
+            os = op.second;
+            page_end = std::min(page_end, mo->address + mo->size);
+        }
+
+        unsigned offset = addr - mo->address;
+        unsigned size = std::min<uint64_t>(page_end - addr, bytes - i);
+
+        if(isWrite) {
+            if(os->readOnly) {
+                terminateStateOnError(state,
+                                      "memory error: object read only",
+                                      "readonly.err");
+                return;
+            }
+
+            ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+            for(unsigned j = 0; j < size; ++j) {
+                wos->write8(offset + j, ExtractExpr::create(value, 8 * (i + j), Expr::Int8));
+            }
+        } else {
+            ref<Expr> part = os->read(offset, size * 8);
+            result = (i == 0) ? part : ConcatExpr::create(part, result);
+        }
+
+        i += size;
+    }
+
+    if(!isWrite) {
+        if (interpreterOpts.MakeConcreteSymbolic)
+            result = replaceReadWithSymbolic(state, result);
+
+        bindLocal(target, state, result);
+    }
+}
 
 /* Merge the current existed MOs with the given MO. Bytes that were not allocated will be assigned as 0.
  * mo_start_addr: the start address of the given MO
@@ -4077,48 +4336,135 @@ void Executor::crete_sync_memory(ExecutionState &state, uint64_t tb_index)
 {
     const memoSyncTable_ty& memo_sync_table = g_qemu_rt_Info->get_memoSyncTable(tb_index);
 
-	for(memoSyncTable_ty::const_iterator it = memo_sync_table.begin();
-			it != memo_sync_table.end(); ++it ) {
-
-		uint64_t addr = it->first;
-		uint8_t dumped_byte_value = it->second;
-
-		ObjectPair res;
-	    bool found = state.addressSpace.resolveOne(ConstantExpr::alloc(addr, Expr::Int64), res);
-	    if(found) {
-	        const MemoryObject *mo = res.first;
-	        const ObjectState *os = res.second;
-	        assert(mo && os);
-	        assert(addr >= mo->address);
-
-	        // read the current value
-	        ref<Expr>  ref_current_value_byte = os->read8(addr - mo->address);
-            if(!isa<ConstantExpr>(ref_current_value_byte)) {
-                ref_current_value_byte = state.concolics.evaluate(
-                        state.constraints.simplifyExpr(ref_current_value_byte));
+    for(std::vector<MemoSyncRun>::const_iterator it = memo_sync_table.m_runs.begin();
+            it != memo_sync_table.m_runs.end(); ++it ) {
+        uint64_t addr = it->m_addr;
+        uint64_t end = it->m_addr + it->m_size;
+        const uint8_t *data = &memo_sync_table.m_data[it->m_data_offset];
+
+        if(!CreteGuestPageMemory) {
+            for(; addr != end; ++addr, ++data) {
+                crete_sync_memory_byte(state, addr, *data);
+            }
+
+            continue;
+        }
+
+        // Split the run at page boundaries
+        while(addr != end) {
+            uint64_t page_end = (addr / CRETE_GUEST_PAGE_SIZE + 1) * CRETE_GUEST_PAGE_SIZE;
+            uint64_t size = (end < page_end ? end : page_end) - addr;
+
+            crete_sync_memory_range(state, addr, data, size);
+
+            addr += size;
+            data += size;
+        }
+    }
+}
+
+/* Synchronize contiguous bytes within a guest page. Concrete bytes, the common
+ * case, are compared and written in bulk.
+ * */
+void Executor::crete_sync_memory_range(ExecutionState &state, uint64_t addr,
+        const uint8_t *data, uint64_t size)
+{
+    const ObjectState *os = NULL;
+    const MemoryObject *mo = crete_get_guest_page(state, addr, true, os);
+
+    if(!mo) {
+        for(uint64_t i = 0; i < size; ++i) {
+            crete_sync_memory_byte(state, addr + i, data[i]);
+        }
+
+        return;
+    }
+
+    uint64_t offset = addr - mo->address;
+    assert(offset + size <= mo->size);
+
+    if(os->isConcrete(offset, size)) {
+        if(os->equalsConcrete(offset, data, size))
+            return;
+
+        CRETE_DBG(
+        for(uint64_t i = 0; i < size; ++i) {
+            uint8_t current_byte_value = (uint8_t)cast<ConstantExpr>(
+                    os->read8(offset + i))->getZExtValue(8);
+            if(data[i] != current_byte_value) {
+                fprintf(stderr, "[CRETE Warning] memory side effect on 0x%p: %d => %d\n",
+                        (void *)(addr + i), (uint32_t)current_byte_value, (uint32_t)data[i]);
             }
-            uint8_t current_byte_value = (uint8_t)cast<ConstantExpr>(ref_current_value_byte)->getZExtValue(8);
+        }
+        );
 
-            // check-side effects
-            if(dumped_byte_value != current_byte_value) {
-                ObjectState* wos = state.addressSpace.getWriteable(mo, os);
-                wos->write8(addr - mo->address, dumped_byte_value);
+        state.addressSpace.getWriteable(mo, os)->writeConcrete(offset, data, size);
+        return;
+    }
+
+    ObjectState *wos = NULL;
+    for(uint64_t i = 0; i < size; ++i) {
+        // read the current value
+        ref<Expr>  ref_current_value_byte = os->read8(offset + i);
+        if(!isa<ConstantExpr>(ref_current_value_byte)) {
+            ref_current_value_byte = state.concolics.evaluate(
+                    state.constraints.simplifyExpr(ref_current_value_byte));
+        }
+        uint8_t current_byte_value = (uint8_t)cast<ConstantExpr>(ref_current_value_byte)->getZExtValue(8);
 
-                CRETE_DBG(
-                fprintf(stderr, "[CRETE Warning] memory side effect on 0x%p: %d => %d (potential concretization)\n",
-                        (void *)addr, (uint32_t)current_byte_value, (uint32_t)dumped_byte_value);
-                );
+        // check-side effects
+        if(data[i] != current_byte_value) {
+            if(!wos) {
+                wos = state.addressSpace.getWriteable(mo, os);
+                os = wos;
             }
-	    } else {
-	        MemoryObject *temp_mo = memory->allocateFixed(addr, 1, 0, true);
-	        if(temp_mo == NULL) {
-	            state.print_stack();
-	            assert(0);
-	        }
-	        ObjectState *temp_os = bindObjectInState(state, temp_mo, false);
-	        temp_os->write8(0, dumped_byte_value);
-	    }
-	}
+            wos->write8(offset + i, data[i]);
+
+            CRETE_DBG(
+            fprintf(stderr, "[CRETE Warning] memory side effect on 0x%p: %d => %d (potential concretization)\n",
+                    (void *)(addr + i), (uint32_t)current_byte_value, (uint32_t)data[i]);
+            );
+        }
+    }
+}
+
+void Executor::crete_sync_memory_byte(ExecutionState &state, uint64_t addr, uint8_t dumped_byte_value)
+{
+    ObjectPair res;
+    bool found = state.addressSpace.resolveOne(ConstantExpr::alloc(addr, Expr::Int64), res);
+    if(found) {
+        const MemoryObject *mo = res.first;
+        const ObjectState *os = res.second;
+        assert(mo && os);
+        assert(addr >= mo->address);
+
+        // read the current value
+        ref<Expr>  ref_current_value_byte = os->read8(addr - mo->address);
+        if(!isa<ConstantExpr>(ref_current_value_byte)) {
+            ref_current_value_byte = state.concolics.evaluate(
+                    state.constraints.simplifyExpr(ref_current_value_byte));
+        }
+        uint8_t current_byte_value = (uint8_t)cast<ConstantExpr>(ref_current_value_byte)->getZExtValue(8);
+
+        // check-side effects
+        if(dumped_byte_value != current_byte_value) {
+            ObjectState* wos = state.addressSpace.getWriteable(mo, os);
+            wos->write8(addr - mo->address, dumped_byte_value);
+
+            CRETE_DBG(
+            fprintf(stderr, "[CRETE Warning] memory side effect on 0x%p: %d => %d (potential concretization)\n",
+                    (void *)addr, (uint32_t)current_byte_value, (uint32_t)dumped_byte_value);
+            );
+        }
+    } else {
+        MemoryObject *temp_mo = memory->allocateFixed(addr, 1, 0, true);
+        if(temp_mo == NULL) {
+            state.print_stack();
+            assert(0);
+        }
+        ObjectState *temp_os = bindObjectInState(state, temp_mo, false);
+        temp_os->write8(0, dumped_byte_value);
+    }
 }
 
 void Executor::crete_sync_cpu(ExecutionState& state, uint64_t tb_index)
@@ -4130,6 +4476,10 @@ void Executor::crete_sync_cpu(ExecutionState& state, uint64_t tb_index)
 
     ObjectState* wos = state.addressSpace.getWriteable(mo, os);
 
+    // Concrete writes of the previous TB, which were sliced away from its bitcode
+    if(tb_index > 0)
+        g_qemu_rt_Info->sync_cpuState_post_tb(wos, tb_index - 1);
+
     CRETE_CK(g_qemu_rt_Info->cross_check_cpuState(state, wos, tb_index););
 
     g_qemu_rt_Info->sync_cpuState(wos, tb_index);
@@ -4357,6 +4707,8 @@ void Executor::handleCreteFinishReply(klee::Executor* executor,
     assert(os);
 
     ObjectState* wos = state->addressSpace.getWriteable(mo, os);
+    if(tb_index_value > 0)
+        g_qemu_rt_Info->sync_cpuState_post_tb(wos, tb_index_value - 1);
     g_qemu_rt_Info->cross_check_cpuState(*state, wos, tb_index_value);
     );
 
@@ -4379,6 +4731,21 @@ void Executor::handleCreteMakeSymbolic(klee::Executor* executor,
     vector<ref<Expr> > symb = executor->crete_create_concolic_array(state, name, size, concreteData);
 
     // 2. write symbolic values to existing mo
+    if(CreteGuestPageMemory) {
+        // The variable might span pages
+        for(uint64_t i = 0; i < symb.size(); ++i) {
+            ObjectPair res;
+            bool found = state->addressSpace.resolveOne(ConstantExpr::alloc(addr + i, Expr::Int64), res);
+            assert(found && "crete_make_symbolic is failed\n");
+
+            ObjectState* wos = state->addressSpace.getWriteable(res.first, res.second);
+            wos->write8(addr + i - res.first->address, symb[i]);
+        }
+
+        CRETE_DBG_TA(state->crete_tb_tainted = true;);
+        return;
+    }
+
     ObjectPair res;
 //    res = state->addressSpace.findObject(addr);
     bool found = state->addressSpace.resolveOne(ConstantExpr::alloc(addr, Expr::Int64), res);
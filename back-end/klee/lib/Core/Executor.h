@@ -28,6 +28,7 @@
 
 #if defined(CRETE_CONFIG)
 #include "crete-replayer/qemu_rt_info.h"
+#include "crete-replayer/negation_pool.h"
 #endif // CRETE_CONFIG
 
 struct KTest;
@@ -479,6 +480,8 @@ private:
   void crete_init_special_function_handler();
 
   StatePair crete_concolic_fork(ExecutionState &current, ref<Expr> condition);
+  bool crete_spawn_negation(ExecutionState &current, ref<Expr> condition,
+          bool concrete_direction);
 
   void crete_concolic_branch(ExecutionState &state,
           const std::vector< ref<Expr> > &conditions,
@@ -493,10 +496,24 @@ private:
 
 private:
   // crete internal functions
+  // Solves negated branches in worker processes, null if they are solved by fork()
+  NegationWorkerPool *crete_negation_pool;
+
+  void crete_preprocess_memory_range(ExecutionState &state,
+          bool isWrite, uint64_t address, uint64_t size);
   MemoryObject *crete_merge_overlapped_mos(ExecutionState &state,
   		  uint64_t mo_start_addr, uint64_t mo_size, bool isWrite = true);
 
+  const MemoryObject *crete_get_guest_page(ExecutionState &state,
+          uint64_t address, bool create, const ObjectState *&os);
+  void crete_execute_page_crossing_memory_operation(ExecutionState &state,
+          bool isWrite, uint64_t address, ref<Expr> value, Expr::Width type,
+          KInstruction *target);
+
   void crete_sync_memory(ExecutionState &state, uint64_t tb_index);
+  void crete_sync_memory_range(ExecutionState &state, uint64_t addr,
+                               const uint8_t *data, uint64_t size);
+  void crete_sync_memory_byte(ExecutionState &state, uint64_t addr, uint8_t value);
   void crete_sync_cpu(ExecutionState &state, uint64_t tb_index);
 
   MemoryObject *crete_get_global(string global_variable_name) const;
@@ -633,6 +633,30 @@ void ObjectState::write_n(unsigned offset, std::vector< ref<Expr> > value) {
     }
 }
 
+bool ObjectState::isConcrete(unsigned offset, unsigned len) const {
+    assert(offset + len <= size);
+    return !concreteMask || concreteMask->isAllSet(offset, offset + len);
+}
+
+bool ObjectState::equalsConcrete(unsigned offset, const uint8_t *data, unsigned len) const {
+    assert(isConcrete(offset, len));
+    return memcmp(concreteStore + offset, data, len) == 0;
+}
+
+void ObjectState::writeConcrete(unsigned offset, const uint8_t *data, unsigned len) {
+    assert(offset + len <= size);
+    memcpy(concreteStore + offset, data, len);
+
+    if (knownSymbolics) {
+        for (unsigned idx = offset; idx != offset + len; ++idx)
+            knownSymbolics[idx] = 0;
+    }
+    if (concreteMask)
+        concreteMask->setRange(offset, offset + len);
+    if (flushMask)
+        flushMask->setRange(offset, offset + len);
+}
+
 void ObjectState::print_refCount() const
 {
     std::cerr << std::hex << "addr = 0x" << object->address
@@ -251,6 +251,12 @@ private:
 public:
   void write_n(unsigned offset, std::vector<uint8_t> value);
   void write_n(unsigned offset, std::vector< ref<Expr> > value);
+  // Bulk concrete accesses of [offset, offset + len), equivalent to, but
+  // much cheaper than, per-byte read8()/write8()
+  bool isConcrete(unsigned offset, unsigned len) const;
+  // Requires isConcrete(offset, len)
+  bool equalsConcrete(unsigned offset, const uint8_t *data, unsigned len) const;
+  void writeConcrete(unsigned offset, const uint8_t *data, unsigned len);
   void print_refCount() const;
   unsigned get_refCount() const;
 #endif
@@ -110,6 +110,11 @@ void MemoryManager::deallocate(const MemoryObject *mo) {
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end())
   {
+#if defined(CRETE_CONFIG)
+    if (mo->address % CRETE_GUEST_PAGE_SIZE == 0 &&
+        findGuestPage(mo->address / CRETE_GUEST_PAGE_SIZE) == mo)
+      guest_pages.erase(mo->address / CRETE_GUEST_PAGE_SIZE);
+#endif
     if (!mo->isFixed)
       free((void *)mo->address);
     objects.erase(mo);
@@ -155,6 +160,38 @@ bool MemoryManager::isOverlappedMO(uint64_t address, uint64_t size) const {
     return false;
 }
 
+MemoryObject *MemoryManager::findGuestPage(uint64_t page_index) const {
+    llvm::DenseMap<uint64_t, MemoryObject *>::const_iterator it =
+            guest_pages.find(page_index);
+
+    return it == guest_pages.end() ? 0 : it->second;
+}
+
+MemoryObject *MemoryManager::allocateGuestPage(uint64_t page_index) {
+    assert(!findGuestPage(page_index));
+
+    if (unpageable_guest_pages.count(page_index))
+        return 0;
+
+    // Pages are not allocated within the range of klee's own objects, which might
+    // be allocated later on
+    uint64_t address = page_index * CRETE_GUEST_PAGE_SIZE;
+    if ((address + CRETE_GUEST_PAGE_SIZE > KLEE_ALLOC_RANGE_LOW &&
+         address <= KLEE_ALLOC_RANGE_HIGH) ||
+        isOverlappedMO(address, CRETE_GUEST_PAGE_SIZE)) {
+        unpageable_guest_pages.insert(page_index);
+        return 0;
+    }
+
+    ++stats::allocations;
+    MemoryObject *res = new MemoryObject(address, CRETE_GUEST_PAGE_SIZE, false, true, true,
+                                         0, this);
+    objects.insert(res);
+    guest_pages[page_index] = res;
+
+    return res;
+}
+
 uint64_t MemoryManager::get_next_address(uint64_t size) {
   if (next_alloc_address < KLEE_ALLOC_RANGE_LOW) {
     next_alloc_address = KLEE_ALLOC_RANGE_LOW;
@@ -11,8 +11,14 @@
 #define KLEE_MEMORYMANAGER_H
 
 #include <set>
+#include <vector>
 #include <stdint.h>
 
+#if defined(CRETE_CONFIG)
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#endif
+
 namespace llvm {
   class Value;
 }
@@ -44,9 +50,19 @@ namespace klee {
     std::vector<MemoryObject *> findOverlapObjects(uint64_t address, uint64_t size) const;
     bool isOverlappedMO(uint64_t address, uint64_t size) const;
 
+    // Guest memory modelled as pages of CRETE_GUEST_PAGE_SIZE bytes, allocated on
+    // first touch and indexed by address / CRETE_GUEST_PAGE_SIZE
+    MemoryObject *findGuestPage(uint64_t page_index) const;
+    // Return NULL if the page overlaps an object that is not a guest page
+    MemoryObject *allocateGuestPage(uint64_t page_index);
+
   private:
     uint64_t next_alloc_address;
 
+    llvm::DenseMap<uint64_t, MemoryObject *> guest_pages;
+    // Pages overlapping other objects, which are never freed
+    llvm::DenseSet<uint64_t> unpageable_guest_pages;
+
     uint64_t get_next_address(uint64_t size);
 #endif
   };
@@ -0,0 +1,546 @@
+//===-- PersistentCachingSolver.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ExprPPrinter.h"
+
+#include "SolverStats.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cassert>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace klee;
+
+/// Results cached in a file mapped by all the processes using it, e.g. the klee
+/// instances of one SVM node.
+///
+/// The file is a set-associative table: a query is keyed by a 128-bit hash of
+/// its canonical KQuery text and lives in one of the ways of the bucket picked
+/// by the key, where the least recently used way is evicted. Processes are
+/// synchronized by fcntl() locks of the file, which are released if a process
+/// dies, and are not shared with forked children (unlike flock()).
+///
+/// Results larger than a slot, e.g. the initial values of typical inputs, are
+/// spilled to a circular log following the table, and their slot points to
+/// their record. A record is lost once the log wraps over it.
+namespace {
+  const char CacheFileMagic[8] = {'K', 'L', 'E', 'E', 'Q', 'C', 'A', 'C'};
+  const uint32_t CacheFileVersion = 2;
+  const uint32_t CacheWays = 8;
+  const uint64_t CacheMinLogSize = 4096;
+
+  struct CacheFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t ways;
+    uint64_t bucketCount;
+    uint64_t clock; // stamps of the last uses of slots
+    uint64_t logSize;
+    uint64_t logHead; // position of the next record, counted across wraps
+    uint8_t padding[16];
+  };
+
+  enum CacheKind {
+    CacheEmpty = 0,
+    CacheValidity,
+    CacheTruth,
+    CacheValue,
+    CacheInitialValues
+  };
+
+  struct CacheSlot {
+    uint64_t key[2];
+    uint64_t lastUse;
+    uint32_t kind;
+    uint32_t size;
+    // Results larger than data are spilled to the log, and data holds the
+    // position of their record
+    unsigned char data[480];
+  };
+
+  // Record of a spilled result in the log, followed by the result
+  struct CacheLogRecord {
+    uint64_t key[2];
+    uint64_t size;
+  };
+
+  inline uint64_t tableSize(const CacheFileHeader &h) {
+    return h.bucketCount * CacheWays * sizeof(CacheSlot);
+  }
+
+  // Records are 8-byte aligned
+  inline uint64_t recordSize(uint64_t size) {
+    return (sizeof(CacheLogRecord) + size + 7) & ~(uint64_t)7;
+  }
+}
+
+class PersistentCachingSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+  std::string path;
+  int fd;
+  CacheFileHeader *header;
+  CacheSlot *slots;
+  unsigned char *log;
+  uint64_t mappedSize;
+
+  bool open(uint64_t size);
+  bool lock(short type);
+
+  const CacheLogRecord *findRecord(const CacheSlot &slot) const;
+  bool spill(CacheSlot &slot, const uint64_t key[2],
+             const std::vector<unsigned char> &data);
+
+  void computeKey(CacheKind kind, const Query &query,
+                  const std::vector<const Array*> *objects,
+                  uint64_t key[2]);
+  bool lookup(CacheKind kind, const uint64_t key[2],
+              std::vector<unsigned char> &data);
+  void insert(CacheKind kind, const uint64_t key[2],
+              const std::vector<unsigned char> &data);
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &_path, uint64_t size);
+  ~PersistentCachingSolver();
+
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+PersistentCachingSolver::PersistentCachingSolver(Solver *s,
+                                                 const std::string &_path,
+                                                 uint64_t size)
+  : solver(s), path(_path), fd(-1), header(0), slots(0), log(0), mappedSize(0) {
+  if (!open(size)) {
+    std::cerr << "KLEE: WARNING: unable to use solver cache file "
+              << path << " (errno = " << errno << "), caching is off\n";
+    if (header)
+      munmap(header, mappedSize);
+    if (fd >= 0)
+      ::close(fd);
+    header = 0;
+    slots = 0;
+    log = 0;
+    fd = -1;
+  }
+}
+
+PersistentCachingSolver::~PersistentCachingSolver() {
+  if (header)
+    munmap(header, mappedSize);
+  if (fd >= 0)
+    ::close(fd);
+  delete solver;
+}
+
+bool PersistentCachingSolver::lock(short type) {
+  struct flock fl;
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+
+  int ret;
+  do {
+    ret = fcntl(fd, type == F_UNLCK ? F_SETLK : F_SETLKW, &fl);
+  } while (ret < 0 && errno == EINTR);
+
+  return ret == 0;
+}
+
+/// Maps the file, which is initialized with size bytes if it is not a cache
+/// file yet, half of them for the log. An existing cache file keeps its own
+/// sizes.
+bool PersistentCachingSolver::open(uint64_t size) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0 || !lock(F_WRLCK))
+    return false;
+
+  bool success = false;
+  struct stat st;
+  CacheFileHeader h;
+
+  if (fstat(fd, &st) == 0) {
+    bool valid = (uint64_t)st.st_size >= sizeof(h) &&
+                 pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+                 memcmp(h.magic, CacheFileMagic, sizeof(h.magic)) == 0 &&
+                 h.version == CacheFileVersion &&
+                 h.ways == CacheWays &&
+                 h.bucketCount > 0 &&
+                 h.logSize >= CacheMinLogSize && h.logSize % 8 == 0 &&
+                 (uint64_t)st.st_size == sizeof(h) + tableSize(h) + h.logSize;
+
+    if (!valid) {
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, CacheFileMagic, sizeof(h.magic));
+      h.version = CacheFileVersion;
+      h.ways = CacheWays;
+      h.bucketCount = std::max<uint64_t>(1, size / 2 / (CacheWays * sizeof(CacheSlot)));
+      h.logSize = std::max(CacheMinLogSize, (size - std::min(size, tableSize(h))) & ~(uint64_t)7);
+
+      // Slots are zeroed (empty) by ftruncate()
+      valid = ftruncate(fd, 0) == 0 &&
+              ftruncate(fd, sizeof(h) + tableSize(h) + h.logSize) == 0 &&
+              pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    }
+
+    if (valid) {
+      mappedSize = sizeof(h) + tableSize(h) + h.logSize;
+      void *p = mmap(0, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+        header = static_cast<CacheFileHeader*>(p);
+        slots = reinterpret_cast<CacheSlot*>(header + 1);
+        log = reinterpret_cast<unsigned char*>(slots) + tableSize(h);
+        success = true;
+      }
+    }
+  }
+
+  lock(F_UNLCK);
+  return success;
+}
+
+static inline uint64_t mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/// Keys a query by its KQuery text, which names arrays instead of pointing to
+/// them, and is therefore the same in every process
+void PersistentCachingSolver::computeKey(CacheKind kind, const Query &query,
+                                         const std::vector<const Array*> *objects,
+                                         uint64_t key[2]) {
+  std::ostringstream os;
+  os << kind << '\n';
+
+  const Array * const *arraysBegin = 0;
+  const Array * const *arraysEnd = 0;
+  if (objects && !objects->empty()) {
+    arraysBegin = &(*objects)[0];
+    arraysEnd = arraysBegin + objects->size();
+  }
+  ExprPPrinter::printQuery(os, query.constraints, query.expr,
+                           0, 0, arraysBegin, arraysEnd);
+
+  const std::string text = os.str();
+
+  // Two independent 64-bit hashes: FNV-1a, and a multiplicative hash
+  uint64_t h0 = 0xcbf29ce484222325ULL;
+  uint64_t h1 = 0x9e3779b97f4a7c15ULL ^ text.size();
+  for (std::string::const_iterator it = text.begin(), ie = text.end();
+       it != ie; ++it) {
+    h0 = (h0 ^ (unsigned char)*it) * 0x100000001b3ULL;
+    h1 = (h1 + (unsigned char)*it) * 0x9e3779b97f4a7c15ULL;
+    h1 ^= h1 >> 29;
+  }
+
+  key[0] = mix64(h0);
+  key[1] = mix64(h1);
+}
+
+/// Returns the record of the result spilled by slot, or null if the log
+/// wrapped over it. Records don't wrap around the end of the log, and are
+/// written in order, so a record is intact until the head passes its position
+/// by more than the size of the log.
+const CacheLogRecord *
+PersistentCachingSolver::findRecord(const CacheSlot &slot) const {
+  uint64_t pos;
+  memcpy(&pos, slot.data, sizeof(pos));
+  uint64_t length = recordSize(slot.size);
+
+  if (pos % 8 != 0 || pos % header->logSize + length > header->logSize ||
+      pos + length > header->logHead || header->logHead - pos > header->logSize)
+    return 0;
+
+  const CacheLogRecord *record =
+    reinterpret_cast<const CacheLogRecord*>(log + pos % header->logSize);
+  if (record->key[0] != slot.key[0] || record->key[1] != slot.key[1] ||
+      record->size != slot.size)
+    return 0;
+
+  return record;
+}
+
+/// Appends the result to the log, and points slot to its record. Must be
+/// called with the write lock.
+bool PersistentCachingSolver::spill(CacheSlot &slot, const uint64_t key[2],
+                                    const std::vector<unsigned char> &data) {
+  uint64_t length = recordSize(data.size());
+  // A result would evict most of the log
+  if (length > header->logSize / 4)
+    return false;
+
+  uint64_t pos = header->logHead;
+  if (pos % header->logSize + length > header->logSize)
+    pos += header->logSize - pos % header->logSize;
+
+  CacheLogRecord *record =
+    reinterpret_cast<CacheLogRecord*>(log + pos % header->logSize);
+  record->key[0] = key[0];
+  record->key[1] = key[1];
+  record->size = data.size();
+  memcpy(record + 1, &data[0], data.size());
+  header->logHead = pos + length;
+
+  memcpy(slot.data, &pos, sizeof(pos));
+  return true;
+}
+
+bool PersistentCachingSolver::lookup(CacheKind kind, const uint64_t key[2],
+                                     std::vector<unsigned char> &data) {
+  if (!header || !lock(F_RDLCK))
+    return false;
+
+  bool found = false;
+  CacheSlot *bucket = slots + (key[0] % header->bucketCount) * CacheWays;
+  for (unsigned i = 0; i < CacheWays; ++i) {
+    CacheSlot &slot = bucket[i];
+    if (slot.kind == (uint32_t)kind &&
+        slot.key[0] == key[0] && slot.key[1] == key[1]) {
+      if (slot.size <= sizeof(slot.data)) {
+        data.assign(slot.data, slot.data + slot.size);
+      } else {
+        const CacheLogRecord *record = findRecord(slot);
+        if (!record)
+          break;
+        const unsigned char *begin =
+          reinterpret_cast<const unsigned char*>(record + 1);
+        data.assign(begin, begin + record->size);
+      }
+
+      // Readers share the lock, so the stamp is only raised, atomically, in
+      // case another reader is stamping the slot too. insert() takes the
+      // write lock, so it does not run concurrently with readers and sees
+      // the latest stamps.
+      uint64_t stamp = __sync_add_and_fetch(&header->clock, 1);
+      uint64_t last = slot.lastUse;
+      while (last < stamp) {
+        uint64_t prev = __sync_val_compare_and_swap(&slot.lastUse, last, stamp);
+        if (prev == last)
+          break;
+        last = prev;
+      }
+      found = true;
+      break;
+    }
+  }
+
+  lock(F_UNLCK);
+
+  if (found)
+    ++stats::queryPersistentCacheHits;
+  else
+    ++stats::queryPersistentCacheMisses;
+
+  return found;
+}
+
+void PersistentCachingSolver::insert(CacheKind kind, const uint64_t key[2],
+                                     const std::vector<unsigned char> &data) {
+  if (!header || !lock(F_WRLCK))
+    return;
+
+  CacheSlot *bucket = slots + (key[0] % header->bucketCount) * CacheWays;
+  CacheSlot *victim = &bucket[0];
+  for (unsigned i = 0; i < CacheWays; ++i) {
+    CacheSlot &slot = bucket[i];
+    if (slot.kind == (uint32_t)kind &&
+        slot.key[0] == key[0] && slot.key[1] == key[1]) {
+      victim = &slot;
+      break;
+    }
+    if (slot.kind == CacheEmpty) {
+      if (victim->kind != CacheEmpty)
+        victim = &slot;
+    } else if (victim->kind != CacheEmpty && slot.lastUse < victim->lastUse) {
+      victim = &slot;
+    }
+  }
+
+  if (data.size() <= sizeof(victim->data)) {
+    if (!data.empty())
+      memcpy(victim->data, &data[0], data.size());
+  } else if (!spill(*victim, key, data)) {
+    lock(F_UNLCK);
+    return;
+  }
+
+  victim->key[0] = key[0];
+  victim->key[1] = key[1];
+  victim->kind = kind;
+  victim->size = data.size();
+  victim->lastUse = __sync_add_and_fetch(&header->clock, 1);
+
+  lock(F_UNLCK);
+}
+
+bool PersistentCachingSolver::computeValidity(const Query& query,
+                                              Solver::Validity &result) {
+  uint64_t key[2] = {0, 0};
+  std::vector<unsigned char> data;
+  if (header) {
+    computeKey(CacheValidity, query, 0, key);
+    if (lookup(CacheValidity, key, data) && data.size() == 1) {
+      result = (Solver::Validity)(signed char)data[0];
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+
+  if (header)
+    insert(CacheValidity, key,
+           std::vector<unsigned char>(1, (unsigned char)(signed char)result));
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query& query,
+                                           bool &isValid) {
+  uint64_t key[2] = {0, 0};
+  std::vector<unsigned char> data;
+  if (header) {
+    computeKey(CacheTruth, query, 0, key);
+    if (lookup(CacheTruth, key, data) && data.size() == 1) {
+      isValid = data[0];
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+
+  if (header)
+    insert(CacheTruth, key, std::vector<unsigned char>(1, isValid));
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query& query,
+                                           ref<Expr> &result) {
+  uint64_t key[2] = {0, 0};
+  std::vector<unsigned char> data;
+  if (header) {
+    computeKey(CacheValue, query, 0, key);
+    if (lookup(CacheValue, key, data) &&
+        data.size() == sizeof(uint32_t) + sizeof(uint64_t)) {
+      uint32_t width;
+      uint64_t value;
+      memcpy(&width, &data[0], sizeof(width));
+      memcpy(&value, &data[sizeof(width)], sizeof(value));
+      result = ConstantExpr::create(value, width);
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+
+  // Values wider than 64 bits are not cached
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(result);
+  if (header && ce && ce->getWidth() <= Expr::Int64) {
+    uint32_t width = ce->getWidth();
+    uint64_t value = ce->getZExtValue();
+    data.resize(sizeof(width) + sizeof(value));
+    memcpy(&data[0], &width, sizeof(width));
+    memcpy(&data[sizeof(width)], &value, sizeof(value));
+    insert(CacheValue, key, data);
+  }
+  return true;
+}
+
+bool
+PersistentCachingSolver::computeInitialValues(const Query& query,
+                                              const std::vector<const Array*> &objects,
+                                              std::vector< std::vector<unsigned char> > &values,
+                                              bool &hasSolution) {
+  uint64_t key[2] = {0, 0};
+  std::vector<unsigned char> data;
+  if (header) {
+    computeKey(CacheInitialValues, query, &objects, key);
+    if (lookup(CacheInitialValues, key, data) && !data.empty()) {
+      // hasSolution, followed by the values of objects if it is set
+      uint64_t expected = 1;
+      if (data[0])
+        for (unsigned i = 0; i != objects.size(); ++i)
+          expected += objects[i]->size;
+
+      if (data.size() == expected) {
+        hasSolution = data[0];
+        values.clear();
+        if (hasSolution) {
+          std::vector<unsigned char>::const_iterator pos = data.begin() + 1;
+          for (unsigned i = 0; i != objects.size(); ++i) {
+            values.push_back(std::vector<unsigned char>(pos, pos + objects[i]->size));
+            pos += objects[i]->size;
+          }
+        }
+        return true;
+      }
+    }
+  }
+
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  if (header) {
+    data.assign(1, hasSolution);
+    if (hasSolution) {
+      assert(values.size() == objects.size());
+      for (unsigned i = 0; i != values.size(); ++i)
+        data.insert(data.end(), values[i].begin(), values[i].end());
+    }
+    insert(CacheInitialValues, key, data);
+  }
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *_solver,
+                                            const std::string &path,
+                                            uint64_t size) {
+  return new Solver(new PersistentCachingSolver(_solver, path, size));
+}
@@ -501,6 +501,14 @@ private:
   bool useForkedSTP;
   SolverRunStatus runStatusCode;
 
+  /// Constraints kept asserted by the incremental mode, over push levels of vc.
+  /// assertedLevels holds the number of constraints asserted below each level.
+  std::vector< ref<Expr> > assertedConstraints;
+  std::vector<size_t> assertedLevels;
+
+  void assertIncrementally(const ConstraintManager &constraints);
+  void retractAsserted(size_t count);
+
 public:
   STPSolverImpl(STPSolver *_solver, bool _useForkedSTP, bool _optimizeDivides = true);
   ~STPSolverImpl();
@@ -531,7 +539,8 @@ STPSolverImpl::STPSolverImpl(STPSolver *_solver, bool _useForkedSTP, bool _optim
     vc(vc_createValidityChecker()),
     builder(new STPBuilder(vc, _optimizeDivides)),
     timeout(0.0),
-    useForkedSTP(_useForkedSTP),
+    // A forked process would drop what STP learns from the constraints kept asserted
+    useForkedSTP(_useForkedSTP && !IncrementalCoreSolver),
     runStatusCode(SOLVER_RUN_STATUS_FAILURE)
 {
   assert(vc && "unable to create validity checker");
@@ -557,6 +566,7 @@ STPSolverImpl::STPSolverImpl(STPSolver *_solver, bool _useForkedSTP, bool _optim
 }
 
 STPSolverImpl::~STPSolverImpl() {
+  retractAsserted(0);
   delete builder;
 
   vc_Destroy(vc);
@@ -579,7 +589,50 @@ void STPSolver::setCoreSolverTimeout(double timeout) {
 
 /***/
 
+/// Maximum number of push levels of the incremental mode, past which the
+/// asserted constraints are collapsed into one level
+static const size_t MaxAssertedLevels = 256;
+
+/// Pops the levels of vc until at most count constraints stay asserted
+void STPSolverImpl::retractAsserted(size_t count) {
+  while (assertedConstraints.size() > count) {
+    assert(!assertedLevels.empty());
+    vc_pop(vc);
+    assertedConstraints.resize(assertedLevels.back());
+    assertedLevels.pop_back();
+  }
+}
+
+/// Asserts constraints at the base of vc, keeping the ones already asserted by
+/// the previous queries up to the first difference
+void STPSolverImpl::assertIncrementally(const ConstraintManager &constraints) {
+  size_t common = 0;
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+         ie = constraints.end();
+       it != ie && common < assertedConstraints.size() &&
+         *it == assertedConstraints[common]; ++it)
+    ++common;
+
+  retractAsserted(common);
+  if (assertedConstraints.size() == constraints.size())
+    return;
+
+  if (assertedLevels.size() >= MaxAssertedLevels)
+    retractAsserted(0);
+
+  assertedLevels.push_back(assertedConstraints.size());
+  vc_push(vc);
+  for (ConstraintManager::const_iterator it = constraints.begin() +
+         assertedConstraints.size(), ie = constraints.end(); it != ie; ++it) {
+    vc_assertFormula(vc, builder->construct(*it));
+    assertedConstraints.push_back(*it);
+  }
+}
+
 char *STPSolverImpl::getConstraintLog(const Query &query) {
+  // Otherwise constraints of the incremental mode would be logged
+  retractAsserted(0);
+
   vc_push(vc);
   for (std::vector< ref<Expr> >::const_iterator it = query.constraints.begin(), 
          ie = query.constraints.end(); it != ie; ++it)
@@ -785,11 +838,16 @@ STPSolverImpl::computeInitialValues(const Query &query,
     
   TimerStatIncrementer t(stats::queryTime);
 
+  if (IncrementalCoreSolver)
+    assertIncrementally(query.constraints);
+
   vc_push(vc);
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    vc_assertFormula(vc, builder->construct(*it));
+  if (!IncrementalCoreSolver) {
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+           ie = query.constraints.end(); it != ie; ++it)
+      vc_assertFormula(vc, builder->construct(*it));
+  }
   
   ++stats::queries;
   ++stats::queryCounterexamples;
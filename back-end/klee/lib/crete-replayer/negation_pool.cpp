@@ -0,0 +1,212 @@
+#include "crete-replayer/negation_pool.h"
+#include "klee/Interpreter.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <assert.h>
+#include <errno.h>
+
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace std;
+
+NegationWorkerPool::NegationWorkerPool(klee::InterpreterHandler *handler, unsigned max_workers)
+: m_handler(handler),
+  m_max_workers(max_workers),
+  m_is_worker(false),
+  m_spawned(0),
+  m_solved(0)
+{
+    assert(m_handler);
+    assert(m_max_workers > 0);
+}
+
+NegationWorkerPool::~NegationWorkerPool()
+{
+    if(!m_is_worker)
+        wait_all();
+}
+
+string NegationWorkerPool::get_solution_file(uint64_t job) const
+{
+    stringstream ss;
+    ss << "negation-" << job << ".sol";
+
+    return m_handler->getOutputFilename(ss.str());
+}
+
+pid_t NegationWorkerPool::spawn()
+{
+    assert(!m_is_worker && "[CRETE ERROR] Workers of negation pool can't spawn workers.\n");
+
+    collect();
+    while(m_workers.size() >= m_max_workers)
+    {
+        reap(m_workers.front(), true);
+        m_workers.pop_front();
+    }
+
+    Worker w;
+    w.m_solution_file = get_solution_file(m_spawned);
+
+    // Otherwise buffered outputs would be written twice
+    cout.flush();
+    cerr.flush();
+    fflush(NULL);
+
+    pid_t parent = getpid();
+
+    w.m_pid = fork();
+    if(w.m_pid < 0)
+    {
+        cerr << "[CRETE Warning] failed to fork a negation worker: errno = "
+             << errno << endl;
+        return w.m_pid;
+    }
+
+    ++m_spawned;
+
+    if(w.m_pid == 0)
+    {
+        // Workers go with klee when it's killed (e.g. on a timeout of the SVM node), rather than
+        // keep solving into the directory of the next trace
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if(getppid() != parent)
+            _exit(1);
+
+        m_is_worker = true;
+        m_worker_solution_file = w.m_solution_file;
+        m_workers.clear();
+        return 0;
+    }
+
+    m_workers.push_back(w);
+    return w.m_pid;
+}
+
+static void write_string(ofstream &ofs, const vector<unsigned char> &data)
+{
+    uint32_t size = data.size();
+    ofs.write((const char *)&size, sizeof(size));
+    ofs.write((const char *)data.data(), size);
+}
+
+static bool read_string(ifstream &ifs, vector<unsigned char> &data)
+{
+    uint32_t size = 0;
+    if(!ifs.read((char *)&size, sizeof(size)))
+        return false;
+
+    data.resize(size);
+    return size == 0 || ifs.read((char *)data.data(), size);
+}
+
+void NegationWorkerPool::finish_worker(bool solved,
+                                       const negation_solution_ty &solution,
+                                       const vector<uint64_t> &addresses)
+{
+    assert(m_is_worker);
+    assert(solution.size() == addresses.size());
+
+    if(solved)
+    {
+        ofstream ofs(m_worker_solution_file.c_str(), ios_base::out | ios_base::binary);
+
+        uint32_t count = solution.size();
+        ofs.write((const char *)&count, sizeof(count));
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            write_string(ofs, vector<unsigned char>(solution[i].first.begin(),
+                                                    solution[i].first.end()));
+            write_string(ofs, solution[i].second);
+            ofs.write((const char *)&addresses[i], sizeof(uint64_t));
+        }
+
+        ofs.close();
+        solved = ofs.good();
+    }
+
+    // Skip the exit handlers and destructors of klee, which belong to the main process
+    _exit(solved ? 0 : 1);
+}
+
+bool NegationWorkerPool::reap(const Worker &w, bool wait)
+{
+    int status = 0;
+    pid_t ret;
+    do {
+        ret = waitpid(w.m_pid, &status, wait ? 0 : WNOHANG);
+    } while(ret < 0 && errno == EINTR);
+
+    if(ret == 0)
+        return false;
+
+    if(ret < 0)
+    {
+        cerr << "[CRETE Warning] failed to wait for negation worker "
+             << w.m_pid << ": errno = " << errno << endl;
+        return true;
+    }
+
+    // A worker exiting with failure found the negated branch infeasible, or the
+    // solver failed/timed out on it
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        negation_solution_ty solution;
+        vector<uint64_t> addresses;
+
+        ifstream ifs(w.m_solution_file.c_str(), ios_base::in | ios_base::binary);
+        uint32_t count = 0;
+        bool good = !ifs.read((char *)&count, sizeof(count)).fail();
+        for(uint32_t i = 0; good && i < count; ++i)
+        {
+            vector<unsigned char> name;
+            vector<unsigned char> data;
+            uint64_t address = 0;
+
+            good = read_string(ifs, name) && read_string(ifs, data) &&
+                    ifs.read((char *)&address, sizeof(address));
+
+            solution.push_back(make_pair(string(name.begin(), name.end()), data));
+            addresses.push_back(address);
+        }
+
+        if(good)
+        {
+            m_handler->processTestCaseSolution(solution, addresses);
+            ++m_solved;
+        } else {
+            cerr << "[CRETE Warning] invalid solution of negation worker: "
+                 << w.m_solution_file << endl;
+        }
+    }
+
+    unlink(w.m_solution_file.c_str());
+
+    return true;
+}
+
+void NegationWorkerPool::collect()
+{
+    for(deque<Worker>::iterator it = m_workers.begin(); it != m_workers.end();)
+    {
+        if(reap(*it, false))
+            it = m_workers.erase(it);
+        else
+            ++it;
+    }
+}
+
+void NegationWorkerPool::wait_all()
+{
+    while(!m_workers.empty())
+    {
+        reap(m_workers.front(), true);
+        m_workers.pop_front();
+    }
+}
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <assert.h>
 #include <iomanip>
+#include <algorithm>
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <sstream>
@@ -19,14 +20,17 @@ QemuRuntimeInfo::QemuRuntimeInfo()
     m_streamed_tb_count = 0;
     m_streamed_index = 0;
 
-    // to-be-streamed
-    init_memoSyncTables();
-    init_interruptStates();
+    // Tables of TBs are decoded on demand
+    m_trace.open("dump_trace.bin");
+    m_memoSyncTable_index = (uint64_t)-1;
+    m_has_tbPostSyncTables =
+            m_trace.get_tb_count(crete::trace::chunk_tb_post_sync_tables) != 0;
+    verify_init();
 
-    // not-streamed
 	init_initial_cpuState();
 	init_concolics();
 
+	CRETE_DBG(print_memoSyncTables(););
 	CRETE_CK(read_debug_cpuState_offsets(););
 }
 
@@ -42,36 +46,46 @@ vector<uint8_t> QemuRuntimeInfo::get_initial_cpuState()
 }
 
 void QemuRuntimeInfo::sync_cpuState(klee::ObjectState *wos, uint64_t tb_index) {
-    if(tb_index >= m_streamed_tb_count) {
-        read_streamed_trace();
-        assert((m_streamed_tb_count - tb_index) == m_cpuStateSyncTables.size());
-    }
+    apply_cpuSyncRecords(wos, crete::trace::chunk_cpu_sync_tables, tb_index);
+}
+
+void QemuRuntimeInfo::sync_cpuState_post_tb(klee::ObjectState *wos, uint64_t tb_index) {
+    if(!m_has_tbPostSyncTables) return;
+
+    apply_cpuSyncRecords(wos, crete::trace::chunk_tb_post_sync_tables, tb_index);
+}
 
-    uint64_t adjusted_tb_index = tb_index - (m_streamed_tb_count - m_cpuStateSyncTables.size());
+// Each record is a contiguous run of CPUState, which is applied in place from
+// the mmap'ed trace with one bulk write
+void QemuRuntimeInfo::apply_cpuSyncRecords(klee::ObjectState *wos,
+        crete::trace::ChunkType type, uint64_t tb_index) {
+    pair<const uint8_t *, uint64_t> records = m_trace.get_tb_records(type, tb_index);
+    assert(records.second >= sizeof(crete::trace::CPUSyncTableHeader));
 
-    cpuStateSyncTable_ty cpuStateSyncTable = m_cpuStateSyncTables[adjusted_tb_index];
+    const crete::trace::CPUSyncTableHeader *header =
+            (const crete::trace::CPUSyncTableHeader *)records.first;
+    const crete::trace::CPUSyncRecord *it =
+            (const crete::trace::CPUSyncRecord *)(header + 1);
+    const crete::trace::CPUSyncRecord *end = it + header->element_count;
+    const uint8_t *data = (const uint8_t *)end;
 
     CRETE_DBG(
     cerr << "-------------------------------------------------------\n";
-    cerr << "tb-" << dec << tb_index << ": sync_cpuState()\n";
+    cerr << "tb-" << dec << tb_index << ": sync_cpuState(), chunk type " << type << "\n";
     );
 
-    if(!cpuStateSyncTable.first) return;
+    if(!header->valid) return;
 
-    assert(!cpuStateSyncTable.second.empty());
+    assert(header->element_count != 0);
 
     CRETE_DBG(cerr << " concretized elements: \n";);
-    for(vector<CPUStateElement>::const_iterator it = cpuStateSyncTable.second.begin();
-            it != cpuStateSyncTable.second.end(); ++it) {
-        if(it->m_name.find("debug") != string::npos) {
-            continue;
-        }
+    for(; it != end; ++it) {
+        assert((data + it->data_offset + it->size) <= (records.first + records.second));
 
-        assert(it->m_data.size() == it->m_size);
-        wos->write_n(it->m_offset,it->m_data);
-        CRETE_DBG(fprintf(stderr, "(%s:%lu): [", it->m_name.c_str(), it->m_size);
-        for(uint64_t i = 0; i < it->m_size; ++i) {
-            cerr << hex << " 0x" << (uint32_t)it->m_data[i];
+        wos->writeConcrete(it->offset, data + it->data_offset, it->size);
+        CRETE_DBG(fprintf(stderr, "(field-%u:%u): [", it->field_id, it->size);
+        for(uint64_t i = 0; i < it->size; ++i) {
+            cerr << hex << " 0x" << (uint32_t)data[it->data_offset + i];
         }
         cerr << "]\n";
         );
@@ -80,31 +94,39 @@ void QemuRuntimeInfo::sync_cpuState(klee::ObjectState *wos, uint64_t tb_index) {
 
 const memoSyncTable_ty& QemuRuntimeInfo::get_memoSyncTable(uint64_t tb_index)
 {
-//    if(tb_index >= (m_streamed_tb_count + m_memoSyncTables.size()))
-//        read_streamed_trace();
+    if(tb_index != m_memoSyncTable_index) {
+        read_memoSyncTable(tb_index, m_memoSyncTable);
+        m_memoSyncTable_index = tb_index;
+    }
 
-    assert(tb_index < m_memoSyncTables.size());
-	return m_memoSyncTables[tb_index];
+	return m_memoSyncTable;
 }
 
 void QemuRuntimeInfo::printMemoSyncTable(uint64_t tb_index)
 {
-	memoSyncTable_ty temp_mst = m_memoSyncTables[tb_index];
+	const memoSyncTable_ty &temp_mst = get_memoSyncTable(tb_index);
 
 	cerr << "memoSyncTable content of index " << dec << tb_index << ": ";
 
-	if(temp_mst.empty()){
+	if(temp_mst.m_runs.empty()){
 		cerr << " NULL\n";
 	} else {
-		cerr << "size = " << temp_mst.size() << ":\n";
-		for(memoSyncTable_ty::iterator m_it = temp_mst.begin();
-				m_it != temp_mst.end(); ++m_it){
+		cerr << "size = " << temp_mst.m_data.size() << ":\n";
+		print_memoSyncRuns(temp_mst);
+	}
+}
 
-			cerr << hex << "0x" << m_it->first << ": (0x " << m_it->second << "); ";
+void QemuRuntimeInfo::print_memoSyncRuns(const memoSyncTable_ty &table) const
+{
+	for(vector<MemoSyncRun>::const_iterator r_it = table.m_runs.begin();
+			r_it != table.m_runs.end(); ++r_it){
+		for(uint32_t i = 0; i < r_it->m_size; ++i) {
+			cerr << hex << "0x" << r_it->m_addr + i << ": (0x "
+					<< (uint64_t)table.m_data[r_it->m_data_offset + i] << "); ";
 		}
-
-		cerr << dec << endl;
 	}
+
+	cerr << dec << endl;
 }
 
 concolics_ty QemuRuntimeInfo::get_concolics() const
@@ -212,34 +234,72 @@ void QemuRuntimeInfo::cleanup_concolics()
 	}
 }
 
-void QemuRuntimeInfo::init_memoSyncTables()
+static bool memoSyncByteAddrLess(const pair<uint64_t, uint8_t> &lhs,
+        const pair<uint64_t, uint8_t> &rhs)
 {
-    ifstream i_sm("dump_new_sync_memos.bin", ios_base::binary);
-    assert(i_sm && "open file failed: dump_new_sync_memos.bin\n");
+    return lhs.first < rhs.first;
+}
 
-    boost::archive::binary_iarchive ia(i_sm);
-    ia >> m_memoSyncTables;
+static bool memoSyncByteAddrEqual(const pair<uint64_t, uint8_t> &lhs,
+        const pair<uint64_t, uint8_t> &rhs)
+{
+    return lhs.first == rhs.first;
+}
+
+void QemuRuntimeInfo::read_memoSyncTable(uint64_t tb_index, memoSyncTable_ty &memoSyncTable)
+{
+    pair<const uint8_t *, uint64_t> records =
+            m_trace.get_tb_records(crete::trace::chunk_memo_sync_tables, tb_index);
+    const crete::trace::MemoLoadRecord *it =
+            (const crete::trace::MemoLoadRecord *)records.first;
+    const crete::trace::MemoLoadRecord *end =
+            it + records.second/sizeof(crete::trace::MemoLoadRecord);
+
+    // Expand loads into bytes, in the order of loads
+    vector< pair<uint64_t, uint8_t> > &bytes = m_memoSyncBytes;
+    bytes.clear();
+    for(; it != end; ++it) {
+        assert(it->size <= sizeof(it->value));
+        for(uint32_t i = 0; i < it->size; ++i) {
+            bytes.push_back(make_pair(it->addr + i, (uint8_t)(it->value >> (8*i))));
+        }
+    }
 
-    CRETE_DBG(print_memoSyncTables(););
+    // Keep the earliest value of each byte
+    stable_sort(bytes.begin(), bytes.end(), memoSyncByteAddrLess);
+    bytes.erase(unique(bytes.begin(), bytes.end(), memoSyncByteAddrEqual),
+            bytes.end());
+
+    // Group contiguous bytes into runs, so that they are synced in bulk
+    memoSyncTable.m_runs.clear();
+    memoSyncTable.m_data.clear();
+    for(vector< pair<uint64_t, uint8_t> >::const_iterator b_it = bytes.begin();
+            b_it != bytes.end(); ++b_it) {
+        if(memoSyncTable.m_runs.empty() ||
+                memoSyncTable.m_runs.back().m_addr + memoSyncTable.m_runs.back().m_size != b_it->first) {
+            memoSyncTable.m_runs.push_back(MemoSyncRun(b_it->first, 0, memoSyncTable.m_data.size()));
+        }
+
+        ++memoSyncTable.m_runs.back().m_size;
+        memoSyncTable.m_data.push_back(b_it->second);
+    }
 }
 
 void QemuRuntimeInfo::print_memoSyncTables()
 {
-	uint64_t temp_tb_count = 0;
+	uint64_t tb_count = m_trace.get_tb_count(crete::trace::chunk_memo_sync_tables);
+	memoSyncTable_ty table;
+
 	cerr << "[Memo Sync Table]\n";
-	for(memoSyncTables_ty::const_iterator it = m_memoSyncTables.begin();
-			it != m_memoSyncTables.end(); ++it){
-		if(it->empty()){
-			cerr << "tb_count: " << dec << temp_tb_count++ << ": NULL\n";
+	for(uint64_t temp_tb_count = 0; temp_tb_count < tb_count; ++temp_tb_count){
+		read_memoSyncTable(temp_tb_count, table);
+
+		if(table.m_runs.empty()){
+			cerr << "tb_count: " << dec << temp_tb_count << ": NULL\n";
 		} else {
-			cerr << "tb_count: " << dec << temp_tb_count++
-					<< ", size = " << it->size() << ": ";
-			for(memoSyncTable_ty::const_iterator m_it = it->begin();
-					m_it != it->end(); ++m_it){
-				cerr << hex << "0x" << m_it->first << ": (0x " << (uint64_t)m_it->second  << "); ";
-			}
-
-			cerr << dec << endl;
+			cerr << "tb_count: " << dec << temp_tb_count
+					<< ", size = " << table.m_data.size() << ": ";
+			print_memoSyncRuns(table);
 		}
 	}
 }
@@ -262,59 +322,63 @@ void QemuRuntimeInfo::init_initial_cpuState()
 
 void QemuRuntimeInfo::print_cpuSyncTable(uint64_t tb_index) const
 {
-    if(!m_cpuStateSyncTables[tb_index].first) {
+    cpuStateSyncTable_ty cpuStateSyncTable;
+    read_cpuSyncTable(tb_index, cpuStateSyncTable);
+
+    if(!cpuStateSyncTable.m_valid) {
         cerr << "tb-" << dec << tb_index << ": cpuSyncTable is empty\n";
     }
 
     cerr << "tb-" << dec << tb_index << ": cpuSyncTable size = "
-            << m_cpuStateSyncTables[tb_index].second.size() << endl;
+            << cpuStateSyncTable.m_elements.size() << endl;
 
-    for(vector<CPUStateElement>::const_iterator it = m_cpuStateSyncTables[tb_index].second.begin();
-            it != m_cpuStateSyncTables[tb_index].second.end(); ++it) {
-        cerr << it->m_name << ": " << it->m_size << " bytes"
+    for(vector<CPUStateSideEffect>::const_iterator it = cpuStateSyncTable.m_elements.begin();
+            it != cpuStateSyncTable.m_elements.end(); ++it) {
+        cerr << "field-" << dec << it->m_field_id << ": " << it->m_size << " bytes"
                 << " [";
         for(uint64_t i = 0; i < it->m_size; ++i) {
-            cerr << " 0x"<< hex << (uint32_t)it->m_data[i];
+            cerr << " 0x"<< hex << (uint32_t)cpuStateSyncTable.m_data[it->m_data_offset + i];
         }
         cerr << "]\n";
     }
 }
 
-void QemuRuntimeInfo::init_interruptStates()
-{
-    ifstream i_sm("dump_qemu_interrupt_info.bin", ios_base::binary);
-    assert(i_sm && "open file failed: dump_qemu_interrupt_info.bin\n");
-
-    boost::archive::binary_iarchive ia(i_sm);
-    ia >> m_interruptStates;
-}
-
+// Only debug cpuState sync tables are streamed in separate files
 void QemuRuntimeInfo::read_streamed_trace()
 {
-    uint32_t read_amt_cst = read_cpuSyncTables();
     uint32_t read_amt_dbg_cst = read_debug_cpuSyncTables();
 
-    assert(read_amt_cst == read_amt_dbg_cst);
-
-    m_streamed_tb_count += read_amt_cst;
+    m_streamed_tb_count += read_amt_dbg_cst;
     ++m_streamed_index;
 }
 
-uint32_t QemuRuntimeInfo::read_cpuSyncTables()
+void QemuRuntimeInfo::read_cpuSyncTable(uint64_t tb_index,
+        cpuStateSyncTable_ty &cpuStateSyncTable) const
 {
-    stringstream ss;
-    ss << "dump_sync_cpu_states." << m_streamed_index << ".bin";
-    ifstream i_sm(ss.str().c_str(), ios_base::binary);
-    if(!i_sm.good()) {
-        cerr << "[Crete Error] can't find file " << ss.str() << endl;
-        assert(0);
+    pair<const uint8_t *, uint64_t> records =
+            m_trace.get_tb_records(crete::trace::chunk_cpu_sync_tables, tb_index);
+    assert(records.second >= sizeof(crete::trace::CPUSyncTableHeader));
+
+    const crete::trace::CPUSyncTableHeader *header =
+            (const crete::trace::CPUSyncTableHeader *)records.first;
+    const crete::trace::CPUSyncRecord *it =
+            (const crete::trace::CPUSyncRecord *)(header + 1);
+    const crete::trace::CPUSyncRecord *end = it + header->element_count;
+    const uint8_t *data = (const uint8_t *)end;
+
+    cpuStateSyncTable.m_valid = header->valid;
+    cpuStateSyncTable.m_elements.clear();
+    cpuStateSyncTable.m_data.clear();
+
+    uint64_t data_size = 0;
+    for(; it != end; ++it) {
+        cpuStateSyncTable.m_elements.push_back(CPUStateSideEffect(it->field_id, it->offset,
+                it->size, it->data_offset));
+        data_size = max(data_size, (uint64_t)(it->data_offset + it->size));
     }
 
-    boost::archive::binary_iarchive ia(i_sm);
-    m_cpuStateSyncTables.clear();
-    ia >> m_cpuStateSyncTables;
-
-    return m_cpuStateSyncTables.size();
+    assert((data + data_size) <= (records.first + records.second));
+    cpuStateSyncTable.m_data.assign(data, data + data_size);
 }
 
 uint32_t QemuRuntimeInfo::read_debug_cpuSyncTables()
@@ -355,7 +419,17 @@ void QemuRuntimeInfo::read_debug_cpuState_offsets()
 
 QemuInterruptInfo QemuRuntimeInfo::get_qemuInterruptInfo(uint64_t tb_index)
 {
-	return m_interruptStates[tb_index].first;
+    pair<const uint8_t *, uint64_t> records =
+            m_trace.get_tb_records(crete::trace::chunk_interrupt_states, tb_index);
+
+    if(records.second == 0) {
+        return QemuInterruptInfo(0, 0, 0, 0);
+    }
+
+    const crete::trace::InterruptRecord *record =
+            (const crete::trace::InterruptRecord *)records.first;
+    return QemuInterruptInfo(record->intno, record->is_int,
+            record->error_code, record->next_eip_addend);
 }
 
 void QemuRuntimeInfo::update_qemu_CPUState(klee::ObjectState *wos, uint64_t tb_index)
@@ -365,9 +439,13 @@ void QemuRuntimeInfo::update_qemu_CPUState(klee::ObjectState *wos, uint64_t tb_i
 
 void QemuRuntimeInfo::verify_init() const
 {
-    assert(m_cpuStateSyncTables.size() == m_memoSyncTables.size());
-
-    CRETE_CK(assert(m_cpuStateSyncTables.size() == m_debug_cpuStateSyncTables.size()););
+    assert(m_trace.get_tb_count(crete::trace::chunk_cpu_sync_tables) ==
+            m_trace.get_tb_count(crete::trace::chunk_memo_sync_tables));
+    assert(m_trace.get_tb_count(crete::trace::chunk_interrupt_states) ==
+            m_trace.get_tb_count(crete::trace::chunk_memo_sync_tables));
+    assert(!m_has_tbPostSyncTables ||
+            m_trace.get_tb_count(crete::trace::chunk_tb_post_sync_tables) ==
+            m_trace.get_tb_count(crete::trace::chunk_memo_sync_tables));
 }
 
 static void concretize_incorrect_cpu_element(klee::ObjectState *cpu_os,
@@ -247,6 +247,11 @@ public:
   void processTestCase(const ExecutionState  &state,
                        const char *errorMessage,
                        const char *errorSuffix);
+#if defined(CRETE_CONFIG)
+  void processTestCaseSolution(const std::vector< std::pair<std::string,
+                               std::vector<unsigned char> > > &solution,
+                               const std::vector<uint64_t> &addresses);
+#endif // CRETE_CONFIG
 
   std::string getOutputFilename(const std::string &filename);
   std::ostream *openOutputFile(const std::string &filename);
@@ -265,6 +270,18 @@ public:
 			  std::vector<std::string> &results);
 
   static llvm::sys::Path getRunTimeLibraryPath(const char* argv0, void *MainExecAddr);
+
+private:
+#if defined(CRETE_CONFIG)
+  void writeKTest(unsigned id,
+                  const std::vector< std::pair<std::string,
+                  std::vector<unsigned char> > > &out,
+                  const std::vector<uint64_t> &addresses);
+#else
+  void writeKTest(unsigned id,
+                  const std::vector< std::pair<std::string,
+                  std::vector<unsigned char> > > &out);
+#endif // CRETE_CONFIG
 };
 
 KleeHandler::KleeHandler(int argc, char **argv)
@@ -417,6 +434,63 @@ std::ostream *KleeHandler::openTestFile(const std::string &suffix, unsigned id)
 }
 
 
+/* Writes the .ktest file of a test case */
+#if defined(CRETE_CONFIG)
+void KleeHandler::writeKTest(unsigned id,
+                             const std::vector< std::pair<std::string,
+                             std::vector<unsigned char> > > &out,
+                             const std::vector<uint64_t> &addresses) {
+#else
+void KleeHandler::writeKTest(unsigned id,
+                             const std::vector< std::pair<std::string,
+                             std::vector<unsigned char> > > &out) {
+#endif // CRETE_CONFIG
+  KTest b;
+  b.numArgs = m_argc;
+  b.args = m_argv;
+  b.symArgvs = 0;
+  b.symArgvLen = 0;
+  b.numObjects = out.size();
+  b.objects = new KTestObject[b.numObjects];
+  assert(b.objects);
+  for (unsigned i=0; i<b.numObjects; i++) {
+    KTestObject *o = &b.objects[i];
+    o->name = const_cast<char*>(out[i].first.c_str());
+    o->numBytes = out[i].second.size();
+    o->bytes = new unsigned char[o->numBytes];
+    assert(o->bytes);
+    std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
+#if defined(CRETE_CONFIG)
+    o->address = addresses[i];
+#endif //CRETE_CONFIG
+  }
+
+  if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+    klee_warning("unable to write output test case, losing it");
+  }
+
+  for (unsigned i=0; i<b.numObjects; i++)
+    delete[] b.objects[i].bytes;
+  delete[] b.objects;
+}
+
+#if defined(CRETE_CONFIG)
+/* Outputs the .ktest file of a solution computed out of any state, e.g. by a
+ * negation worker. Files describing the state (.pc, .cov etc.) are not available */
+void KleeHandler::processTestCaseSolution(const std::vector< std::pair<std::string,
+                                          std::vector<unsigned char> > > &solution,
+                                          const std::vector<uint64_t> &addresses) {
+  if (NoOutput)
+    return;
+
+  unsigned id = ++m_testIndex;
+  writeKTest(id, solution, addresses);
+
+  if (m_testIndex == StopAfterNTests)
+    m_interpreter->setHaltExecution(true);
+}
+#endif // CRETE_CONFIG
+
 /* Outputs all files (.ktest, .pc, .cov etc.) describing a test case */
 void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorMessage,
@@ -451,33 +525,11 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     unsigned id = ++m_testIndex;
 
     if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
 #if defined(CRETE_CONFIG)
-        o->address = addresses[i];
-#endif //CRETE_CONFIG
-      }
-
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
-      }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
+      writeKTest(id, out, addresses);
+#else
+      writeKTest(id, out);
+#endif // CRETE_CONFIG
     }
 
     if (errorMessage) {
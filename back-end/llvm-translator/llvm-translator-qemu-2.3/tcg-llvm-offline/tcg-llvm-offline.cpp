@@ -6,6 +6,7 @@
 #include <boost/archive/text_oarchive.hpp>
 
 #include <string>
+#include <algorithm>
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
@@ -37,14 +38,35 @@ void TCGLLVMOfflineContext::dump_tlo_tb_pc(const uint64_t pc)
     m_tlo_tb_pc.push_back(pc);
 }
 
-void TCGLLVMOfflineContext::dump_tcg_ctx(const TCGContext& tcg_ctx)
+void TCGLLVMOfflineContext::dump_tcg_tb_ir(const TCGContext& tcg_ctx)
 {
-    m_tcg_ctx.push_back(tcg_ctx);
+    m_tcg_tb_irs.push_back(TCGLLVMOfflineTBIR());
+    TCGLLVMOfflineTBIR& tb_ir = m_tcg_tb_irs.back();
+
+    tb_ir.m_nb_globals = tcg_ctx.nb_globals;
+    tb_ir.m_nb_temps = tcg_ctx.nb_temps;
+    tb_ir.m_nb_labels = tcg_ctx.nb_labels;
+
+    for(int oi = tcg_ctx.gen_first_op_idx; oi >= 0; oi = tcg_ctx.gen_op_buf[oi].next) {
+        const TCGOp &op = tcg_ctx.gen_op_buf[oi];
+
+        TCGLLVMOfflineOp offline_op;
+        offline_op.m_opc = op.opc;
+        offline_op.m_callo = op.callo;
+        offline_op.m_calli = op.calli;
+        offline_op.m_args = op.args;
+
+        tb_ir.m_ops.push_back(offline_op);
+    }
+
+    tb_ir.m_params.assign(tcg_ctx.gen_opparam_buf,
+            tcg_ctx.gen_opparam_buf + tcg_ctx.gen_next_parm_idx);
+    tb_ir.m_temps.assign(tcg_ctx.temps, tcg_ctx.temps + tcg_ctx.nb_temps);
 }
 
-void TCGLLVMOfflineContext::dump_tcg_temp(const vector<TCGTemp>& tcg_temp)
+void TCGLLVMOfflineContext::dump_tcg_tb_ir(const TCGLLVMOfflineTBIR& tb_ir)
 {
-    m_tcg_temps.push_back(tcg_temp);
+    m_tcg_tb_irs.push_back(tb_ir);
 }
 
 void TCGLLVMOfflineContext::dump_tcg_helper_name(const TCGContext &tcg_ctx)
@@ -74,21 +96,21 @@ void TCGLLVMOfflineContext::dump_cpuState_size(uint64_t cpuState_size)
 {
     m_cpuState_size = cpuState_size;
 }
-#endif // #if !defined(TCG_LLVM_OFFLINE)
 
-uint64_t TCGLLVMOfflineContext::get_tlo_tb_pc(const uint64_t tb_index) const
+void TCGLLVMOfflineContext::dump_tb_kept_globals(const vector<vector<uint64_t> >& tb_kept_globals)
 {
-    return m_tlo_tb_pc[tb_index];
+    m_tb_kept_globals = tb_kept_globals;
 }
+#endif // #if !defined(TCG_LLVM_OFFLINE)
 
-const TCGContext& TCGLLVMOfflineContext::get_tcg_ctx(const uint64_t tb_index) const
+uint64_t TCGLLVMOfflineContext::get_tlo_tb_pc(const uint64_t tb_index) const
 {
-    return m_tcg_ctx[tb_index];
+    return m_tlo_tb_pc[tb_index];
 }
 
-const vector<TCGTemp>& TCGLLVMOfflineContext::get_tcg_temp(const uint64_t tb_index) const
+const TCGLLVMOfflineTBIR& TCGLLVMOfflineContext::get_tcg_tb_ir(const uint64_t tb_index) const
 {
-    return m_tcg_temps[tb_index];
+    return m_tcg_tb_irs[tb_index];
 }
 
 const map<uint64_t, string> TCGLLVMOfflineContext::get_helper_names() const
@@ -111,6 +133,22 @@ uint64_t TCGLLVMOfflineContext::get_cpuState_size() const
     return m_cpuState_size;
 }
 
+const vector<vector<uint64_t> >& TCGLLVMOfflineContext::get_tb_kept_globals() const
+{
+    return m_tb_kept_globals;
+}
+
+void TCGLLVMOfflineContext::swap(TCGLLVMOfflineContext& other)
+{
+    m_tlo_tb_pc.swap(other.m_tlo_tb_pc);
+    m_tcg_tb_irs.swap(other.m_tcg_tb_irs);
+    m_helper_names.swap(other.m_helper_names);
+    m_tlo_tb_inst_count.swap(other.m_tlo_tb_inst_count);
+    m_tbExecSequ.swap(other.m_tbExecSequ);
+    std::swap(m_cpuState_size, other.m_cpuState_size);
+    m_tb_kept_globals.swap(other.m_tb_kept_globals);
+}
+
 void TCGLLVMOfflineContext::print_info()
 {
     cout  << dec << "m_tlo_tb_pc.size() = " << m_tlo_tb_pc.size() << endl
@@ -118,8 +156,7 @@ void TCGLLVMOfflineContext::print_info()
             << endl;
 
     cout  << dec << "sizeof (m_tlo_tb_pc) = " << sizeof(m_tlo_tb_pc)<< endl
-            << "sizeof(m_helper_names) = " <<  sizeof(m_tcg_ctx)
-            << "sizeof(m_tcg_temps) = " << sizeof(m_tcg_temps)
+            << "sizeof(m_tcg_tb_irs) = " <<  sizeof(m_tcg_tb_irs)
             << "sizeof(m_helper_names) = " << sizeof(m_helper_names) << endl
             << endl;
 
@@ -136,15 +173,28 @@ void TCGLLVMOfflineContext::print_info()
 
 void TCGLLVMOfflineContext::dump_verify()
 {
-    assert(m_tlo_tb_pc.size() == m_tcg_ctx.size());
-    assert(m_tlo_tb_pc.size() == m_tcg_temps.size());
+    assert(m_tlo_tb_pc.size() == m_tcg_tb_irs.size());
 }
 
-uint64_t TCGLLVMOfflineContext::get_size()
+uint64_t TCGLLVMOfflineContext::get_size() const
 {
     return (uint64_t)m_tlo_tb_pc.size();
 }
 
+uint64_t TCGLLVMOfflineContext::get_tcg_tb_irs_bytes() const
+{
+    uint64_t bytes = 0;
+    for(vector<TCGLLVMOfflineTBIR>::const_iterator it = m_tcg_tb_irs.begin();
+            it != m_tcg_tb_irs.end(); ++it) {
+        bytes += sizeof(TCGLLVMOfflineTBIR) +
+                it->m_ops.size() * sizeof(TCGLLVMOfflineOp) +
+                it->m_params.size() * sizeof(uint64_t) +
+                it->m_temps.size() * sizeof(TCGTemp);
+    }
+
+    return bytes;
+}
+
 #if defined(TCG_LLVM_OFFLINE)
 
 extern "C" {
@@ -153,9 +203,21 @@ extern "C" {
 }
 
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <crete/trace_file.h>
 #include <sstream>
+#include <deque>
+#include <stdexcept>
 
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <fcntl.h>
+#include <signal.h>
 
 #define CRETE_DEBUG
 
@@ -252,118 +314,174 @@ const char * get_helper_name(uint64_t func_addr)
     return ret;
 }
 
-void x86_llvm_translator()
+// Rebuild the op list, params and temps of tcg_ctx from the compact IR of a TB.
+// Only the entries used by the TB are touched.
+static void load_tcg_tb_ir(TCGContext *s, const TCGLLVMOfflineTBIR &tb_ir)
 {
-    namespace fs = boost::filesystem;
+    const uint64_t nb_ops = tb_ir.m_ops.size();
+    const uint64_t nb_params = tb_ir.m_params.size();
+
+    assert(nb_ops < OPC_BUF_SIZE);
+    assert(nb_params <= OPPARAM_BUF_SIZE);
+    assert(tb_ir.m_temps.size() == (uint64_t)tb_ir.m_nb_temps);
+    assert(tb_ir.m_nb_temps <= TCG_MAX_TEMPS);
+
+    s->nb_globals = tb_ir.m_nb_globals;
+    s->nb_temps = tb_ir.m_nb_temps;
+    s->nb_labels = tb_ir.m_nb_labels;
+
+    for(uint64_t i = 0; i < nb_ops; ++i) {
+        const TCGLLVMOfflineOp &offline_op = tb_ir.m_ops[i];
+        TCGOp *op = &s->gen_op_buf[i];
+
+        op->opc = (TCGOpcode)offline_op.m_opc;
+        op->callo = offline_op.m_callo;
+        op->calli = offline_op.m_calli;
+        op->args = offline_op.m_args;
+        op->prev = (int)i - 1;
+        op->next = (i + 1 < nb_ops) ? (int)i + 1 : -1;
+
+        gen_opc_buf[i] = offline_op.m_opc;
+    }
 
-#if defined(CRETE_DEBUG)
-    cerr<< "this is the new main function from tcg-llvm-offline.\n" << endl;
+    s->gen_first_op_idx = nb_ops ? 0 : -1;
+    s->gen_last_op_idx = (int)nb_ops - 1;
+    s->gen_next_op_idx = nb_ops;
+    s->gen_next_parm_idx = nb_params;
 
-    cerr<< "sizeof(TCGContext_temp) = 0x" << hex << sizeof(TCGContext_temp)
-                << "sizeof(TCGArg) = 0x" << sizeof(TCGArg) << endl
-                << ", OPPARAM_BUF_SIZE = 0x" << OPPARAM_BUF_SIZE
-                << ", OPC_BUF_SIZE = 0x" << OPC_BUF_SIZE
-                << ", MAX_OPC_PARAM = 0x" << MAX_OPC_PARAM << endl;
+    std::copy(tb_ir.m_params.begin(), tb_ir.m_params.end(), s->gen_opparam_buf);
+    std::copy(tb_ir.m_params.begin(), tb_ir.m_params.end(), gen_opparam_buf);
 
-    dump_tcg_op_defs();
-#endif
+    for(int i = 0; i < tb_ir.m_nb_temps; ++i)
+        s->temps[i].assign(tb_ir.m_temps[i]);
 
-    //1. initialize llvm dependencies
-    tcg_llvm_ctx = tcg_llvm_initialize();
-    assert(tcg_llvm_ctx);
+    // Temps beyond nb_temps are scanned for temp_local by the llvm generator
+    memset((void *)&s->temps[tb_ir.m_nb_temps], 0,
+            (TCG_MAX_TEMPS - tb_ir.m_nb_temps) * sizeof(TCGTemp));
+}
+
+// Options of the translator
+struct CreteTranslatorOptions
+{
+    uint64_t jobs;  // Number of processes translating TBs in parallel
+    bool dump_tbir; // Write the TCG IR of TBs to offline-tbir.txt
+    bool worker;    // Serve trace directories from stdin, see run_worker()
+};
+
+// Minimal number of TBs worth a translation process of its own
+static const uint64_t CRETE_MIN_TBS_PER_JOB = 64;
 
+static void crete_link_helpers(TCGLLVMContext *ctx)
+{
 #if defined(TARGET_X86_64)
-    tcg_linkWithLibrary(tcg_llvm_ctx,
+    tcg_linkWithLibrary(ctx,
             crete_find_file(CRETE_FILE_TYPE_LLVM_LIB, "crete-qemu-2.3-op-helper-x86_64.bc").c_str());
 #elif defined(TARGET_I386)
-    tcg_linkWithLibrary(tcg_llvm_ctx,
+    tcg_linkWithLibrary(ctx,
             crete_find_file(CRETE_FILE_TYPE_LLVM_LIB, "crete-qemu-2.3-op-helper-i386.bc").c_str());
 #else
     #error CRETE: Only I386 and x64 supported!
 #endif // defined(TARGET_X86_64) || defined(TARGET_I386)
+}
 
+// The IR of each tracing window is an entry of chunk_tb_irs in dump_trace.bin.
+// Elements of a deque are not moved by push_back(), which would copy all the IRs
+static void load_offline_contexts(deque<TCGLLVMOfflineContext> &contexts)
+{
+    crete::trace::TraceReader trace;
+    trace.open("dump_trace.bin");
 
+    uint64_t window_count = trace.get_tb_count(crete::trace::chunk_tb_irs);
+    cerr << window_count << " windows of TB IR found\n";
 
-    stringstream ss;
-    uint64_t streamed_count = 0;
-    for(;;) {
-        ss.str(string());
-        ss << "dump_tcg_llvm_offline." << streamed_count++ << ".bin";
-        if(!fs::exists(ss.str())){
-            cerr << ss.str() << " not found\n";
-            break;
-        }
-
-        cerr << ss.str() << " being found\n";
-
-        //2. initialize tcg_llvm_ctx_offline
-        TCGLLVMOfflineContext temp_tcg_llvm_offline_ctx;
+    for(uint64_t i = 0; i < window_count; ++i) {
+        pair<const uint8_t*, uint64_t> entry =
+                trace.get_tb_records(crete::trace::chunk_tb_irs, i);
 
-        ifstream ifs(ss.str().c_str());
-        boost::archive::binary_iarchive ia(ifs);
-        ia >> temp_tcg_llvm_offline_ctx;
-        temp_tcg_llvm_offline_ctx.dump_verify();
+        crete::trace::TBIRHeader header;
+        if(entry.second < sizeof(header))
+            throw runtime_error("invalid TB IR entry in dump_trace.bin");
 
-#if defined(CRETE_DEBUG)
-        temp_tcg_llvm_offline_ctx.print_info();
-#endif
+        memcpy(&header, entry.first, sizeof(header));
+        if(header.size > entry.second - sizeof(header))
+            throw runtime_error("invalid TB IR entry in dump_trace.bin");
 
-        if(streamed_count == 1){
-            tcg_llvm_ctx->crete_init_helper_names(temp_tcg_llvm_offline_ctx.get_helper_names());
-            tcg_llvm_ctx->crete_set_cpuState_size(temp_tcg_llvm_offline_ctx.get_cpuState_size());
-        }
+        boost::iostreams::stream<boost::iostreams::array_source> is(
+                reinterpret_cast<const char*>(entry.first + sizeof(header)), header.size);
 
-        tcg_llvm_ctx->crete_add_tbExecSequ(temp_tcg_llvm_offline_ctx.get_tbExecSequ());
+        contexts.push_back(TCGLLVMOfflineContext());
 
-        //3. Translate
-        TranslationBlock temp_tb = {};
-        TCGContext *s = &tcg_ctx;
+        boost::archive::binary_iarchive ia(is);
+        ia >> contexts.back();
+        contexts.back().dump_verify();
 
-        for(uint64_t i = 0; i < temp_tcg_llvm_offline_ctx.get_size(); ++i) {
-            //3.1 update temp_tb
-            temp_tb.pc = (target_long)temp_tcg_llvm_offline_ctx.get_tlo_tb_pc(i);
+#if defined(CRETE_DEBUG)
+        contexts.back().print_info();
+#endif
+    }
+}
 
-            //3.2 update tcg_ctx
-            const TCGContext temp_tcg_ctx = temp_tcg_llvm_offline_ctx.get_tcg_ctx(i);
-            memcpy((void *)s, (void *)&temp_tcg_ctx, sizeof(TCGContext));
+static void dump_offline_tbir(const deque<TCGLLVMOfflineContext> &contexts)
+{
+    FILE *f = fopen("offline-tbir.txt", "a");
+    assert(f);
 
-            //3.3 update gen_opc_buf and gen_opparam_buf
+    static char buffer[1 << 20];
+    setvbuf(f, buffer, _IOFBF, sizeof(buffer));
 
-            for(uint64_t j = 0; j < OPC_BUF_SIZE; ++j) {
-                gen_opc_buf[j] = (uint16_t)temp_tcg_ctx.gen_op_buf[j].opc;
-            }
+    TCGContext *s = &tcg_ctx;
+    uint64_t tbir_count = 0;
+    for(deque<TCGLLVMOfflineContext>::const_iterator it = contexts.begin();
+            it != contexts.end(); ++it) {
+        for(uint64_t i = 0; i < it->get_size(); ++i) {
+            load_tcg_tb_ir(s, it->get_tcg_tb_ir(i));
 
-            for(uint64_t j = 0; j < OPPARAM_BUF_SIZE; ++j) {
-                gen_opparam_buf[j] = (TCGArg)temp_tcg_ctx.gen_opparam_buf[j];
-            }
+            fprintf(f, "qemu-ir-tb-%llu-%llu: tb_inst_count = %llu\n",
+                    (unsigned long long)tbir_count++,
+                    (unsigned long long)it->get_tlo_tb_pc(i),
+                    (unsigned long long)it->get_tlo_tb_inst_count(i));
+            tcg_dump_ops_file(s, f);
+            fprintf(f, "\n");
+        }
+    }
 
-            // 3.4 update tcg-temp
-            const vector<TCGTemp> temp_tcg_temp = temp_tcg_llvm_offline_ctx.get_tcg_temp(i);
-            assert( temp_tcg_temp.size() == s->nb_temps);
-            for(uint64_t j = 0; j < s->nb_temps; ++j)
-                s->temps[j].assign(temp_tcg_temp[j]);
+    fclose(f);
+}
 
-            // generate offline-tbir.txt
-            uint64_t tb_inst_count = temp_tcg_llvm_offline_ctx.get_tlo_tb_inst_count(i);
+// Translate the TBs whose global index is shard modulo jobs into tcg_llvm_ctx,
+// where the index names the function of a TB
+static void translate_tbs(const deque<TCGLLVMOfflineContext> &contexts,
+        uint64_t shard, uint64_t jobs)
+{
+    TranslationBlock temp_tb = {};
+    TCGContext *s = &tcg_ctx;
 
-            static unsigned long long  tbir_count = 0;
-            char file_name[] = "offline-tbir.txt";
-            FILE *f = fopen(file_name, "a");
-            assert(f);
+    // Captured with TB slicing, see TCGLLVMOfflineContext::m_tb_kept_globals
+    static const vector<vector<uint64_t> > no_kept_globals;
+    const vector<vector<uint64_t> > &tb_kept_globals = contexts.empty() ?
+            no_kept_globals : contexts.back().get_tb_kept_globals();
 
-            fprintf(f, "qemu-ir-tb-%llu-%llu: tb_inst_count = %llu\n",
-                    tbir_count++, temp_tb.pc, tb_inst_count);
-            tcg_dump_ops_file(s, f);
-            fprintf(f, "\n");
+    uint64_t tb_index = 0;
+    for(deque<TCGLLVMOfflineContext>::const_iterator it = contexts.begin();
+            it != contexts.end(); ++it) {
+        for(uint64_t i = 0; i < it->get_size(); ++i, ++tb_index) {
+            if(tb_index % jobs != shard)
+                continue;
 
-            fclose(f);
+            //3.1 update temp_tb
+            temp_tb.pc = (target_long)it->get_tlo_tb_pc(i);
 
-            //3.5 generate llvm bitcode
+            //3.2 update tcg_ctx, gen_opc_buf and gen_opparam_buf
+            load_tcg_tb_ir(s, it->get_tcg_tb_ir(i));
 
+            //3.3 generate llvm bitcode
             cerr << "tcg_llvm_ctx->generateCode(s, &temp_tb) will be invoked." << endl;
             temp_tb.tcg_llvm_context = NULL;
             temp_tb.llvm_function = NULL;
 
+            tcg_llvm_ctx->setTbCount(tb_index);
+            tcg_llvm_ctx->setKeptGlobals(tb_index < tb_kept_globals.size() ?
+                    &tb_kept_globals[tb_index] : NULL);
             tcg_llvm_ctx->generateCode(s, &temp_tb);
 
             cerr<< "tcg_llvm_ctx->generateCode(s, &temp_tb) is done." << endl;
@@ -372,23 +490,265 @@ void x86_llvm_translator()
             assert(temp_tb.llvm_function != NULL);
         }
     }
+}
+
+static string shard_bitcode_path(uint64_t shard)
+{
+    stringstream ss;
+    ss << "dump_llvm_offline.shard-" << shard << ".bc";
+    return ss.str();
+}
+
+// Create tcg_llvm_ctx and link the helper library into it, which is inherited by
+// the processes forked afterwards
+static void prepare_tcg_llvm_ctx()
+{
+    tcg_llvm_ctx = tcg_llvm_initialize();
+    assert(tcg_llvm_ctx);
+    crete_link_helpers(tcg_llvm_ctx);
+}
+
+static bool wait_for_exit_success(pid_t pid)
+{
+    int status = 0;
+    return waitpid(pid, &status, 0) == pid &&
+            WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Each shard is translated by a forked process, as tcg_ctx and the llvm
+// context of the translator are process-wide. Shards only hold TB functions
+// and are linked into the prepared tcg_llvm_ctx at last.
+static void translate_tbs_in_parallel(const deque<TCGLLVMOfflineContext> &contexts,
+        uint64_t jobs)
+{
+    namespace fs = boost::filesystem;
+
+    cout.flush();
+    cerr.flush();
+
+    vector<pid_t> workers;
+    for(uint64_t shard = 0; shard < jobs; ++shard) {
+        pid_t pid = fork();
+        if(pid < 0) {
+            throw std::runtime_error("failed to fork a translation process");
+        }
+
+        if(pid == 0) {
+            int ret = 0;
+            try {
+                tcg_llvm_ctx->crete_init_helper_names(contexts.front().get_helper_names());
+
+                translate_tbs(contexts, shard, jobs);
+
+                tcg_llvm_ctx->stripToTbFunctions();
+                tcg_llvm_ctx->writeBitCodeToFile(shard_bitcode_path(shard));
+            } catch(std::exception &e) {
+                cerr << "[CRETE ERROR] translation of shard " << shard
+                        << " failed: " << e.what() << endl;
+                ret = 1;
+            }
+
+            cerr.flush();
+            _exit(ret);
+        }
+
+        workers.push_back(pid);
+    }
+
+    bool failed = false;
+    for(vector<pid_t>::const_iterator it = workers.begin(); it != workers.end(); ++it) {
+        if(!wait_for_exit_success(*it)) {
+            failed = true;
+        }
+    }
+
+    if(failed) {
+        throw std::runtime_error("translation process failed");
+    }
+
+    for(uint64_t shard = 0; shard < jobs; ++shard) {
+        tcg_llvm_ctx->linkWithLibrary(shard_bitcode_path(shard));
+        fs::remove(shard_bitcode_path(shard));
+    }
+}
+
+// Translate the TBs captured in the current directory with the prepared tcg_llvm_ctx
+void x86_llvm_translator(const CreteTranslatorOptions &options)
+{
+#if defined(CRETE_DEBUG)
+    cerr<< "this is the new main function from tcg-llvm-offline.\n" << endl;
+
+    cerr<< "sizeof(TCGContext_temp) = 0x" << hex << sizeof(TCGContext_temp)
+                << "sizeof(TCGArg) = 0x" << sizeof(TCGArg) << endl
+                << ", OPPARAM_BUF_SIZE = 0x" << OPPARAM_BUF_SIZE
+                << ", OPC_BUF_SIZE = 0x" << OPC_BUF_SIZE
+                << ", MAX_OPC_PARAM = 0x" << MAX_OPC_PARAM << endl;
+
+    dump_tcg_op_defs();
+#endif
+
+    //1. Load the captured TBs
+    deque<TCGLLVMOfflineContext> contexts;
+    load_offline_contexts(contexts);
+
+    uint64_t tb_count = 0;
+    for(deque<TCGLLVMOfflineContext>::iterator it = contexts.begin();
+            it != contexts.end(); ++it) {
+        tb_count += it->get_size();
+    }
+
+    if(options.dump_tbir) {
+        dump_offline_tbir(contexts);
+    }
+
+    //2. Translate
+    uint64_t jobs = std::min(options.jobs, tb_count / CRETE_MIN_TBS_PER_JOB);
+    if(jobs > 1) {
+        cerr << "translating " << dec << tb_count << " TBs by "
+                << jobs << " processes\n";
+        translate_tbs_in_parallel(contexts, jobs);
+    } else {
+        if(!contexts.empty()) {
+            tcg_llvm_ctx->crete_init_helper_names(contexts.front().get_helper_names());
+        }
+
+        translate_tbs(contexts, 0, 1);
+    }
+
+    if(!contexts.empty()) {
+        tcg_llvm_ctx->crete_set_cpuState_size(contexts.front().get_cpuState_size());
+    }
+
+    for(deque<TCGLLVMOfflineContext>::iterator it = contexts.begin();
+            it != contexts.end(); ++it) {
+        tcg_llvm_ctx->crete_add_tbExecSequ(it->get_tbExecSequ());
+    }
 
-    //4. generate main function
+    //3. generate main function
     tcg_llvm_ctx->generate_crete_main();
 
-    //5. Write out the translated llvm bitcode to file in the current folder
+    //4. Write out the translated llvm bitcode to file in the current folder
     llvm::sys::Path bitcode_path = llvm::sys::Path::GetCurrentDirectory();
     bitcode_path.appendComponent("dump_llvm_offline.bc");
     tcg_llvm_ctx->writeBitCodeToFile(bitcode_path.str());
 
     cerr << "offline translator is done.\n" << endl;
-    //6. cleanup
-    //    delete tcg_llvm_offline_ctx;
+}
+
+// Serve trace directories read from stdin, one per line, until EOF. The helper
+// library is linked once, and each trace is translated by a forked process
+// inheriting it, whose output goes to translator.log of the trace. For each
+// trace, "done <dir>" or "failed <dir>" is replied on stdout.
+static void run_worker(const CreteTranslatorOptions &options)
+{
+    // Keep stdout for replies only
+    cout.flush();
+    fflush(stdout);
+    int reply_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    FILE *replies = fdopen(reply_fd, "w");
+    assert(replies);
+
+    prepare_tcg_llvm_ctx();
+    fprintf(replies, "ready\n");
+    fflush(replies);
+
+    string trace_dir;
+    while(getline(cin, trace_dir)) {
+        if(trace_dir.empty())
+            continue;
+
+        cout.flush();
+        cerr.flush();
+
+        pid_t pid = fork();
+        if(pid < 0) {
+            throw std::runtime_error("failed to fork a translation process");
+        }
+
+        if(pid == 0) {
+            int ret = 0;
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            close(reply_fd);
+
+            try {
+                if(chdir(trace_dir.c_str()) != 0) {
+                    throw std::runtime_error("failed to enter " + trace_dir);
+                }
+
+                int log_fd = open("translator.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if(log_fd >= 0) {
+                    dup2(log_fd, STDOUT_FILENO);
+                    dup2(log_fd, STDERR_FILENO);
+                    close(log_fd);
+                }
+
+                x86_llvm_translator(options);
+            } catch(std::exception &e) {
+                cerr << "[CRETE ERROR] translation of " << trace_dir
+                        << " failed: " << e.what() << endl;
+                ret = 1;
+            }
+
+            cout.flush();
+            cerr.flush();
+            _exit(ret);
+        }
+
+        bool succeeded = wait_for_exit_success(pid);
+        fprintf(replies, "%s %s\n", succeeded ? "done" : "failed", trace_dir.c_str());
+        fflush(replies);
+    }
+
+    fclose(replies);
+}
+
+static void print_usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [-j <jobs>] [--dump-tbir] [--worker]\n"
+            << "  -j, --jobs <n>  translate TBs by up to n processes (default: number of cpus)\n"
+            << "  --dump-tbir     write the TCG IR of TBs to offline-tbir.txt\n"
+            << "  --worker        translate the trace directories read from stdin, one per line\n";
+}
+
+static CreteTranslatorOptions parse_options(int argc, char **argv)
+{
+    CreteTranslatorOptions options;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    options.jobs = cpus > 0 ? cpus : 1;
+    options.dump_tbir = false;
+    options.worker = false;
+
+    for(int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        if((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            options.jobs = strtoull(argv[++i], NULL, 10);
+            if(options.jobs == 0) {
+                options.jobs = 1;
+            }
+        } else if(arg == "--dump-tbir") {
+            options.dump_tbir = true;
+        } else if(arg == "--worker") {
+            options.worker = true;
+        } else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    return options;
 }
 
 int main(int argc, char **argv) {
     crete_set_data_dir(argv[0]);
-    x86_llvm_translator();
+    CreteTranslatorOptions options = parse_options(argc, argv);
+
+    if(options.worker) {
+        run_worker(options);
+    } else {
+        prepare_tcg_llvm_ctx();
+        x86_llvm_translator(options);
+    }
 
     return 0;
 }
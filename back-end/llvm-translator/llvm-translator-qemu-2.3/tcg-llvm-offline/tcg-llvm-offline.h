@@ -31,14 +31,58 @@ using namespace std;
 
 struct TCGContext;
 struct TCGTemp;
+
+// An op on the op list of a captured TB. Ops are stored in list order, so
+// prev/next are implied by the position.
+struct TCGLLVMOfflineOp
+{
+    uint8_t m_opc;
+    uint8_t m_callo;
+    uint8_t m_calli;
+    int32_t m_args; // index of the first param, or -1 for zero-operand ops
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_opc;
+        ar & m_callo;
+        ar & m_calli;
+        ar & m_args;
+    }
+};
+
+// Compact IR of a captured TB: what the translator needs from TCGContext,
+// sized by the TB rather than by OPC_BUF_SIZE/OPPARAM_BUF_SIZE/TCG_MAX_TEMPS
+struct TCGLLVMOfflineTBIR
+{
+    int32_t m_nb_globals;
+    int32_t m_nb_temps;
+    int32_t m_nb_labels;
+
+    vector<TCGLLVMOfflineOp> m_ops;
+    vector<uint64_t> m_params; // gen_opparam_buf[0, gen_next_parm_idx)
+    vector<TCGTemp> m_temps;   // temps[0, nb_temps)
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_nb_globals;
+        ar & m_nb_temps;
+        ar & m_nb_labels;
+
+        ar & m_ops;
+        ar & m_params;
+        ar & m_temps;
+    }
+};
+
 class TCGLLVMOfflineContext
 {
 private:
     // Required information from QEMU for the offline translation
     vector<uint64_t> m_tlo_tb_pc;
 
-    vector<TCGContext> m_tcg_ctx;
-    vector<vector<TCGTemp> > m_tcg_temps;
+    vector<TCGLLVMOfflineTBIR> m_tcg_tb_irs;
     map<uint64_t, string> m_helper_names;
 
     vector<uint64_t> m_tlo_tb_inst_count;
@@ -47,6 +91,12 @@ private:
     vector<pair<uint64_t, uint64_t> > m_tbExecSequ;
     uint64_t m_cpuState_size;
 
+    // Bitmap over the globals of each captured TB of the whole trace: globals whose
+    // writes have to be computed by the bitcode of the TB. Writes of the other globals
+    // are applied concretely after the TB. Only held by the context of the last window,
+    // and empty for a trace captured without TB slicing.
+    vector<vector<uint64_t> > m_tb_kept_globals;
+
 public:
     TCGLLVMOfflineContext() {};
     ~TCGLLVMOfflineContext() {};
@@ -56,43 +106,49 @@ public:
     {
         ar & m_tlo_tb_pc;
 
-        ar & m_tcg_ctx;
-        ar & m_tcg_temps;
+        ar & m_tcg_tb_irs;
         ar & m_helper_names;
 
         ar & m_tlo_tb_inst_count;
 
         ar & m_tbExecSequ;
         ar & m_cpuState_size;
+
+        ar & m_tb_kept_globals;
     }
 
 #if !defined(TCG_LLVM_OFFLINE)
     void dump_tlo_tb_pc(const uint64_t pc);
 
-    void dump_tcg_ctx(const TCGContext& tcg_ctx);
-    void dump_tcg_temp(const vector<TCGTemp>& tcg_temp);
+    void dump_tcg_tb_ir(const TCGContext& tcg_ctx);
+    void dump_tcg_tb_ir(const TCGLLVMOfflineTBIR& tb_ir);
     void dump_tcg_helper_name(const TCGContext &tcg_ctx);
 
     void dump_tlo_tb_inst_count(const uint64_t inst_count);
 
     void dump_tbExecSequ(uint64_t pc, uint64_t unique_tb_num);
     void dump_cpuState_size(uint64_t cpuState_size);
+    void dump_tb_kept_globals(const vector<vector<uint64_t> >& tb_kept_globals);
 #endif
 
     uint64_t get_tlo_tb_pc(const uint64_t tb_index) const;
 
-    const TCGContext& get_tcg_ctx(const uint64_t tb_index) const;
-    const vector<TCGTemp>& get_tcg_temp(const uint64_t tb_index) const;
+    const TCGLLVMOfflineTBIR& get_tcg_tb_ir(const uint64_t tb_index) const;
     const map<uint64_t, string> get_helper_names() const;
 
     uint64_t get_tlo_tb_inst_count(const uint64_t tb_index) const;
 
     vector<pair<uint64_t, uint64_t> > get_tbExecSequ() const;
     uint64_t get_cpuState_size() const;
+    const vector<vector<uint64_t> >& get_tb_kept_globals() const;
+
+    void swap(TCGLLVMOfflineContext& other);
 
     void print_info();
     void dump_verify();
-    uint64_t get_size();
+    uint64_t get_size() const;
+    // Approximate memory used by the IR of all the TBs
+    uint64_t get_tcg_tb_irs_bytes() const;
 };
 
 #endif // #ifdef __cplusplus
@@ -35,6 +35,7 @@
 
 #include <boost/serialization/split_member.hpp>
 #include <string>
+#include <algorithm>
 #include <stdlib.h>
 
 extern "C" {
@@ -75,6 +76,9 @@ int execute_llvm = 0;
 }
 
 #include <llvm/DerivedTypes.h>
+#include <llvm/Constants.h>
+#include <llvm/GlobalVariable.h>
+#include <llvm/GlobalAlias.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #include <llvm/ExecutionEngine/JIT.h>
@@ -167,6 +171,13 @@ struct TCGLLVMContextPrivate {
 
     BasicBlock* m_labels[TCG_MAX_LABELS];
 
+    /* Globals whose writes are computed by the next translation block, as a
+     * bitmap over global indexes, or NULL to translate all of its ops */
+    const std::vector<uint64_t> *m_keptGlobals;
+
+    /* Ops of the current translation block being translated */
+    std::vector<bool> m_opsInSlice;
+
 public:
     TCGLLVMContextPrivate();
     ~TCGLLVMContextPrivate();
@@ -268,6 +279,10 @@ public:
 
     void generateCode(TCGContext *s, TranslationBlock *tb);
 
+    bool isKeptGlobal(int idx) const;
+    void computeSlice(TCGContext *s);
+    void setKeptGlobals(const std::vector<uint64_t> *keptGlobals);
+
     Value* new_generateQemuMemOp(bool ld, Value *value,
             Value *addr, TCGArg memop, int mem_index, int bits);
     Value* getLdMOValue(Value *value, TCGArg memop, int bits);
@@ -279,6 +294,7 @@ public:
     void crete_add_tbExecSequ(vector<pair<uint64_t, uint64_t> > seq);
 
     void generate_crete_main();
+    void generate_crete_tb_loop(Value *cpu_state_addr, Function *crete_qemu_tb_prologue);
 
 private:
     map<uint64_t, string> m_crete_helper_names;
@@ -377,7 +393,7 @@ public:
 
 TCGLLVMContextPrivate::TCGLLVMContextPrivate()
     : m_context(getGlobalContext()), m_builder(m_context), m_tbCount(0),
-      m_tcgContext(NULL), m_tbFunction(NULL)
+      m_tcgContext(NULL), m_tbFunction(NULL), m_keptGlobals(NULL)
 {
     std::memset(m_values, 0, sizeof(m_values));
     std::memset(m_memValuesPtr, 0, sizeof(m_memValuesPtr));
@@ -1579,6 +1595,8 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
     /* Prepare globals and temps information */
     initGlobalsAndLocalTemps();
 
+    computeSlice(s);
+
     cerr<< "initGlobalsAndLocalTemps() finished." << endl;
     uint64_t inst_count = 0;
 
@@ -1609,6 +1627,12 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
         if(opc == INDEX_op_end)
             break;
 
+        if(!m_opsInSlice[opc_index]) {
+            args_increase_ret = opc == INDEX_op_call ?
+                    op->callo + op->calli + 2 : tcg_op_defs[opc].nb_args;
+            continue;
+        }
+
         if(opc == INDEX_op_debug_insn_start) {
         }
 
@@ -1672,6 +1696,123 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
     }
 }
 
+inline bool TCGLLVMContextPrivate::isKeptGlobal(int idx) const
+{
+    assert(m_keptGlobals);
+
+    uint64_t word = idx / 64;
+    return word >= m_keptGlobals->size() || ((*m_keptGlobals)[word] >> (idx % 64)) & 1;
+}
+
+/* Select the ops of the current TB to be translated. Without m_keptGlobals, all
+ * the ops are selected. Otherwise, writes of the globals not being kept are left out
+ * together with the ops computing nothing but their values (including dead ops),
+ * as those globals are concrete after the TB and are written by the replayer from
+ * the captured CPUState. Ops with side effects, control flow and calls are always
+ * selected, along with every op defining a temp being used by a selected op. */
+void TCGLLVMContextPrivate::computeSlice(TCGContext *s)
+{
+    const int nb_ops = s->gen_next_op_idx;
+    m_opsInSlice.assign(nb_ops, true);
+
+    if(!m_keptGlobals)
+        return;
+
+    std::vector<bool> used(s->nb_temps, false);
+    std::vector<int> nb_oargs(nb_ops), nb_iargs(nb_ops);
+
+    for(int i = 0; i < nb_ops; ++i) {
+        const TCGOp &op = s->gen_op_buf[i];
+        const TCGOpDef &def = tcg_op_defs[op.opc];
+        const TCGArg *args = &gen_opparam_buf[op.args];
+
+        if(op.opc == INDEX_op_call) {
+            nb_oargs[i] = op.callo;
+            nb_iargs[i] = op.calli;
+        } else {
+            nb_oargs[i] = def.nb_oargs;
+            nb_iargs[i] = def.nb_iargs;
+        }
+
+        bool removable = nb_oargs[i] > 0 &&
+                op.opc != INDEX_op_call &&
+                op.opc != INDEX_op_discard &&
+                !(def.flags & (TCG_OPF_BB_END | TCG_OPF_CALL_CLOBBER | TCG_OPF_SIDE_EFFECTS));
+
+        for(int j = 0; removable && j < nb_oargs[i]; ++j) {
+            if(args[j] < (TCGArg)s->nb_globals && isKeptGlobal(args[j]))
+                removable = false;
+        }
+
+        m_opsInSlice[i] = !removable;
+    }
+
+    // Ops are visited backwards until no more op is selected, as branches to
+    // labels within the TB can make a temp being used before its definition
+    bool changed = true;
+    while(changed) {
+        changed = false;
+
+        for(int i = nb_ops - 1; i >= 0; --i) {
+            const TCGOp &op = s->gen_op_buf[i];
+            const TCGArg *args = &gen_opparam_buf[op.args];
+
+            if(!m_opsInSlice[i]) {
+                bool is_used = false;
+                for(int j = 0; j < nb_oargs[i]; ++j)
+                    is_used = is_used || used[args[j]];
+
+                if(!is_used)
+                    continue;
+
+                m_opsInSlice[i] = true;
+                changed = true;
+            }
+
+            for(int j = 0; j < nb_iargs[i]; ++j) {
+                TCGArg arg = args[nb_oargs[i] + j];
+                if(arg != TCG_CALL_DUMMY_ARG)
+                    used[arg] = true;
+            }
+
+            // Helpers access globals through env
+            if(op.opc == INDEX_op_call) {
+                for(int j = 0; j < s->nb_globals; ++j)
+                    used[j] = true;
+            }
+
+            // Loads from env may alias memory-based globals
+            const TCGOpDef &def = tcg_op_defs[op.opc];
+            if(nb_oargs[i] == 1 && nb_iargs[i] == 1 && def.nb_cargs == 1 &&
+                    !(def.flags & (TCG_OPF_CALL_CLOBBER | TCG_OPF_SIDE_EFFECTS)) &&
+                    args[1] < (TCGArg)s->nb_globals && s->temps[args[1]].fixed_reg) {
+                const TCGArg offset = args[2];
+                for(int j = 0; j < s->nb_globals; ++j) {
+                    const TCGTemp &ts = s->temps[j];
+                    if(ts.fixed_reg || ts.mem_reg != s->temps[args[1]].reg)
+                        continue;
+
+                    // Loads are at most 8 bytes
+                    if((TCGArg)ts.mem_offset < offset + 8 &&
+                            offset < (TCGArg)ts.mem_offset + 8)
+                        used[j] = true;
+                }
+            }
+        }
+    }
+
+#if defined(CRETE_DEBUG)
+    std::cerr << "computeSlice(): "
+              << std::count(m_opsInSlice.begin(), m_opsInSlice.end(), false)
+              << " of " << nb_ops << " ops are left out\n";
+#endif
+}
+
+void TCGLLVMContextPrivate::setKeptGlobals(const std::vector<uint64_t> *keptGlobals)
+{
+    m_keptGlobals = keptGlobals;
+}
+
 void TCGLLVMContextPrivate::crete_init_helper_names(const map<uint64_t, string>& helper_names)
 {
     m_crete_helper_names = helper_names;
@@ -1697,6 +1838,96 @@ void TCGLLVMContextPrivate::crete_add_tbExecSequ(vector<pair<uint64_t, uint64_t>
 }
 
 #define CRETE_CROSS_CHECK
+#define CRETE_TABLE_DRIVEN_MAIN // Replay TBs by a loop over a table, instead of one call per executed TB
+
+#if defined(CRETE_TABLE_DRIVEN_MAIN)
+/* Emits the execution sequence as a constant array of indices into a table of
+ * TB functions, so that the size of main() does not grow with the trace:
+ *
+ *   for(i = 0; i < tb_count; ++i) {
+ *       crete_qemu_tb_prologue(i);
+ *       crete_tb_functions[crete_tb_exec_sequ[i]](&cpu_state_addr);
+ *   }
+ */
+void TCGLLVMContextPrivate::generate_crete_tb_loop(Value *cpu_state_addr,
+        Function *crete_qemu_tb_prologue)
+{
+    vector<Constant *> tb_functions;
+    vector<uint32_t> tb_exec_sequ;
+    map<Function *, uint32_t> tb_function_indices;
+    tb_exec_sequ.reserve(m_tbExecSequ.size());
+
+    for(vector<pair<uint64_t, uint64_t> >::const_iterator it = m_tbExecSequ.begin();
+            it != m_tbExecSequ.end(); ++it) {
+        std::ostringstream fName;
+        fName << "tcg-llvm-tb-" << std::dec << it->second << "-" << std::hex << it->first;
+        Function *tcg_llvm_tb = m_module->getFunction(fName.str());
+
+        assert(tcg_llvm_tb);
+        assert(tb_functions.empty() || tcg_llvm_tb->getType() == tb_functions.front()->getType());
+
+        pair<map<Function *, uint32_t>::iterator, bool> inserted =
+                tb_function_indices.insert(make_pair(tcg_llvm_tb, (uint32_t)tb_functions.size()));
+        if(inserted.second)
+            tb_functions.push_back(tcg_llvm_tb);
+
+        tb_exec_sequ.push_back(inserted.first->second);
+    }
+
+    uint64_t tb_count = tb_exec_sequ.size();
+    if(tb_count == 0)
+        return;
+
+    // @crete_tb_functions = private constant [n x i64 (i64*)*] [...]
+    ArrayType *tb_functions_type = ArrayType::get(tb_functions.front()->getType(),
+            tb_functions.size());
+    GlobalVariable *tb_functions_table = new GlobalVariable(*m_module, tb_functions_type, true,
+            GlobalValue::PrivateLinkage, ConstantArray::get(tb_functions_type, tb_functions),
+            "crete_tb_functions");
+
+    // @crete_tb_exec_sequ = private constant [tb_count x i32] [...]
+    Constant *tb_exec_sequ_init = ConstantDataArray::get(m_context,
+            ArrayRef<uint32_t>(tb_exec_sequ));
+    GlobalVariable *tb_exec_sequ_table = new GlobalVariable(*m_module,
+            tb_exec_sequ_init->getType(), true,
+            GlobalValue::PrivateLinkage, tb_exec_sequ_init, "crete_tb_exec_sequ");
+
+    Function *crete_main_func = m_builder.GetInsertBlock()->getParent();
+    BasicBlock *entry = m_builder.GetInsertBlock();
+    BasicBlock *loop_body = BasicBlock::Create(m_context, "tb_loop", crete_main_func);
+    BasicBlock *loop_exit = BasicBlock::Create(m_context, "tb_loop_exit", crete_main_func);
+
+    m_builder.CreateBr(loop_body);
+    m_builder.SetInsertPoint(loop_body);
+
+    // %tb_index = phi i64 [ 0, %entry ], [ %tb_index_next, %tb_loop ]
+    PHINode *tb_index = m_builder.CreatePHI(intType(64), 2, "tb_index");
+    tb_index->addIncoming(ConstantInt::get(intType(64), 0), entry);
+
+    m_builder.CreateCall(crete_qemu_tb_prologue, std::vector<llvm::Value*>(1, tb_index));
+
+    Value *zero = ConstantInt::get(intType(64), 0);
+    Value *sequ_indices[] = {zero, tb_index};
+    Value *function_index = m_builder.CreateLoad(
+            m_builder.CreateInBoundsGEP(tb_exec_sequ_table, sequ_indices), "tb_function_index");
+
+    Value *function_indices[] = {zero, m_builder.CreateZExt(function_index, intType(64))};
+    Value *tcg_llvm_tb = m_builder.CreateLoad(
+            m_builder.CreateInBoundsGEP(tb_functions_table, function_indices), "tb_function");
+
+    m_builder.CreateCall(tcg_llvm_tb, std::vector<llvm::Value*>(1, cpu_state_addr));
+
+    Value *tb_index_next = m_builder.CreateAdd(tb_index,
+            ConstantInt::get(intType(64), 1), "tb_index_next");
+    tb_index->addIncoming(tb_index_next, loop_body);
+
+    m_builder.CreateCondBr(
+            m_builder.CreateICmpULT(tb_index_next, ConstantInt::get(intType(64), tb_count)),
+            loop_body, loop_exit);
+
+    m_builder.SetInsertPoint(loop_exit);
+}
+#endif // defined(CRETE_TABLE_DRIVEN_MAIN)
 
 void TCGLLVMContextPrivate::generate_crete_main()
 {
@@ -1753,6 +1984,10 @@ void TCGLLVMContextPrivate::generate_crete_main()
                     Function::ExternalLinkage, "crete_qemu_tb_prologue", m_module);
 
     uint64_t tb_count = 0;
+#if defined(CRETE_TABLE_DRIVEN_MAIN)
+    generate_crete_tb_loop(cpu_state_addr, crete_qemu_tb_prologue);
+    tb_count = m_tbExecSequ.size();
+#else
     for(vector<pair<uint64_t, uint64_t> >::const_iterator it = m_tbExecSequ.begin();
             it != m_tbExecSequ.end(); ++it) {
         // 5.   call void @crete_qemu_tb_prologue(i64 0)
@@ -1769,6 +2004,7 @@ void TCGLLVMContextPrivate::generate_crete_main()
         m_builder.CreateCall(tcg_llvm_tb,
                 std::vector<llvm::Value*>(1, cpu_state_addr));
     }
+#endif // defined(CRETE_TABLE_DRIVEN_MAIN)
 
     Function *crete_finish_replay = Function::Create(
             FunctionType::get(Type::getVoidTy(m_context),
@@ -1839,6 +2075,15 @@ int TCGLLVMContext::getTbCount(){
 	return m_private->m_tbCount;
 }
 
+void TCGLLVMContext::setTbCount(int tbCount){
+	m_private->m_tbCount = tbCount;
+}
+
+void TCGLLVMContext::setKeptGlobals(const std::vector<uint64_t> *keptGlobals)
+{
+    m_private->setKeptGlobals(keptGlobals);
+}
+
 void TCGLLVMContext::writeBitCodeToFile(const std::string &fileName) {
 	assert(fileName.c_str());
 	m_private->writeBitCodeToFile(fileName);
@@ -1857,6 +2102,73 @@ void TCGLLVMContext::linkWithLibrary(const std::string& libraryName)
 	 linker.releaseModule();
 }
 
+static bool isTbFunction(const GlobalValue *gv)
+{
+    return gv->getName().startswith("tcg-llvm-tb-");
+}
+
+void TCGLLVMContext::stripToTbFunctions()
+{
+    Module *module = getModule();
+
+    // Aliases of the helper library can not point to declarations, so their
+    // uses are replaced by declarations of the same name
+    for(Module::alias_iterator it = module->alias_begin(); it != module->alias_end(); ) {
+        GlobalAlias *alias = it++;
+        std::string name = alias->getName();
+        alias->setName("");
+
+        GlobalValue *decl;
+        PointerType *type = alias->getType();
+        if(FunctionType *fType = dyn_cast<FunctionType>(type->getElementType())) {
+            decl = Function::Create(fType, GlobalValue::ExternalLinkage, name, module);
+        } else {
+            decl = new GlobalVariable(*module, type->getElementType(), false,
+                    GlobalValue::ExternalLinkage, NULL, name);
+        }
+
+        alias->replaceAllUsesWith(decl);
+        alias->eraseFromParent();
+    }
+
+    for(Module::iterator it = module->begin(); it != module->end(); ++it) {
+        if(!it->isDeclaration() && !isTbFunction(it)) {
+            it->deleteBody();
+            it->setLinkage(GlobalValue::ExternalLinkage);
+        }
+    }
+
+    for(Module::global_iterator it = module->global_begin(); it != module->global_end(); ) {
+        GlobalVariable *gv = it++;
+
+        // llvm.used, llvm.global_ctors, etc. come with the helper library
+        if(gv->getName().startswith("llvm.")) {
+            gv->eraseFromParent();
+            continue;
+        }
+
+        if(!gv->isDeclaration()) {
+            gv->setInitializer(NULL);
+            gv->setLinkage(GlobalValue::ExternalLinkage);
+        }
+    }
+
+    // Drop the declarations not referenced by TBs
+    for(Module::iterator it = module->begin(); it != module->end(); ) {
+        Function *f = it++;
+        f->removeDeadConstantUsers();
+        if(f->isDeclaration() && f->use_empty())
+            f->eraseFromParent();
+    }
+
+    for(Module::global_iterator it = module->global_begin(); it != module->global_end(); ) {
+        GlobalVariable *gv = it++;
+        gv->removeDeadConstantUsers();
+        if(gv->use_empty())
+            gv->eraseFromParent();
+    }
+}
+
 void TCGLLVMContext::crete_init_helper_names(const map<uint64_t, string>& helper_names)
 {
     m_private->crete_init_helper_names(helper_names);
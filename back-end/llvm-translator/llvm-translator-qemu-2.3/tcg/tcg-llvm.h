@@ -123,8 +123,15 @@ public:
 
 #ifdef TCG_LLVM_OFFLINE
     int getTbCount();
+    void setTbCount(int tbCount);
+    // Globals whose writes are computed by the TBs generated next, as a bitmap over
+    // global indexes (see TCGLLVMOfflineContext), or NULL to translate all the ops
+    void setKeptGlobals(const std::vector<uint64_t> *keptGlobals);
     void writeBitCodeToFile(const std::string &fileName);
     void linkWithLibrary(const std::string& libraryName);
+    // Keep only the definitions of TBs, so that the module can be linked into
+    // another one that already has the helper library
+    void stripToTbFunctions();
 
     void crete_init_helper_names(const map<uint64_t, string>& helper_names);
     const string get_crete_helper_name(const uint64_t func_addr) const;
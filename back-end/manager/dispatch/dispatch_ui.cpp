@@ -1,5 +1,6 @@
 #include "dispatch_ui.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -10,6 +11,7 @@
 #include <boost/property_tree/xml_parser.hpp>
 
 #include <crete/exception.h>
+#include <crete/reactor.h>
 #include <crete/cluster/node_driver.h>
 
 namespace fs = boost::filesystem;
@@ -37,11 +39,32 @@ auto DispatchUI::run() -> void
     dispatch_ = boost::movelib::make_unique<Dispatch>(master_port_,
                                                       options_);
 
+    // Every round polls the nodes for their status, so an idle dispatch would spin
+    // through status requests. Back off instead, until a round has work or something
+    // (a finished transfer, a node registering) wakes the reactor.
+    Reactor reactor;
+    auto idle_wait = dispatch_idle_wait_min;
     bool running = true;
 
     while(running)
     {
         running = dispatch_->run();
+
+        if(running && dispatch_->is_idle())
+        {
+            if(reactor.wait(idle_wait))
+            {
+                idle_wait = dispatch_idle_wait_min;
+            }
+            else
+            {
+                idle_wait = std::min(idle_wait * 2, dispatch_idle_wait_max);
+            }
+        }
+        else
+        {
+            idle_wait = dispatch_idle_wait_min;
+        }
     }
 }
 
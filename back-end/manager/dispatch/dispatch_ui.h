@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <chrono>
 
 #include <boost/program_options/variables_map.hpp>
 #include <boost/program_options/options_description.hpp>
@@ -21,6 +22,9 @@ namespace cluster
 {
 
 const auto default_master_port = crete::Port{10012};
+// Bounds of the back-off between the dispatch rounds that move no traces, tests or errors.
+const auto dispatch_idle_wait_min = std::chrono::milliseconds{1};
+const auto dispatch_idle_wait_max = std::chrono::milliseconds{50};
 
 class DispatchUI
 {
@@ -32,6 +32,7 @@
 #include "runtime-dump/runtime-dump.h"
 #include "runtime-dump/tci_analyzer.h"
 #include "runtime-dump/crete-debug.h"
+#include "runtime-dump/crete-profile.h"
 #endif //#if defined(CRETE_CONFIG)
 
 /* -icount align implementation. */
@@ -225,7 +226,34 @@ static inline tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr)
 //    if(crete_flags_is_true(g_crete_flags))
     if(is_begin_capture && is_target_pid && is_user_code)
     {
-        next_tb = crete_tcg_qemu_tb_exec(env, tb_ptr);
+        // Fast path: a TB whose inputs are free of taint can't read or propagate
+        // taint, so it runs on the plain TCI (see crete_tci_is_tb_taint_free())
+        bool taint_free = crete_tci_is_tb_taint_free(&rt_dump_tb->taint_inputs);
+#if !defined(CRETE_DBG_TA_FAST_PATH)
+        if(taint_free)
+        {
+            CRETE_PROFILE_BEGIN(tci_begin);
+            next_tb = tcg_qemu_tb_exec(env, tb_ptr);
+            CRETE_PROFILE_END(CRETE_PROF_TCI_PLAIN, tci_begin);
+        }
+        else
+#endif
+        {
+            CRETE_PROFILE_BEGIN(tci_begin);
+            next_tb = crete_tcg_qemu_tb_exec(env, tb_ptr);
+            CRETE_PROFILE_TB_END(rt_dump_tb->pc, tci_begin);
+            CRETE_PROFILE_END(CRETE_PROF_TCI_TAINT, tci_begin);
+#if defined(CRETE_DBG_TA_FAST_PATH)
+            if(taint_free && crete_tci_is_current_block_symbolic())
+            {
+                fprintf(stderr, "[CRETE ERROR] taint-free fast path: tb-pc = %p "
+                        "became symbolic while its inputs were free of taint\n",
+                        (void *)(uint64_t)rt_dump_tb->pc);
+                assert(0);
+            }
+#endif
+        }
+        crete_tci_count_tb_exec(taint_free);
 
 #if defined(CRETE_DEBUG)
         fprintf(stderr, "+++\n");
@@ -235,7 +263,9 @@ static inline tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr)
     }
     else
     {
+        CRETE_PROFILE_BEGIN(tci_begin);
         next_tb = tcg_qemu_tb_exec(env, tb_ptr);
+        CRETE_PROFILE_END(CRETE_PROF_TCI_UNTRACED, tci_begin);
     }
 #else // !defined(CRETE_DEP_ANALYSIS)
     next_tb = tcg_qemu_tb_exec(env, tb_ptr);
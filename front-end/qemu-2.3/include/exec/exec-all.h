@@ -149,6 +149,27 @@ static inline void tlb_flush(CPUState *cpu, int flush_global)
 #define USE_DIRECT_JUMP
 #endif
 
+#if defined(CRETE_CONFIG) || 1
+#define CRETE_TB_ENV_RANGES 8
+
+/* Accesses of the TCI code of a tb to the state tracked by taint analysis, which
+ * decide whether the tb can be interpreted without taint analysis, see
+ * crete_tci_summarize_tb() */
+typedef struct CreteTBTaintInputs {
+    /* Sorted [begin, end) ranges of CPUArchState being loaded or stored. Ranges are
+     * merged to fit, which only over-approximates the bytes being accessed */
+    uint32_t env_begin[CRETE_TB_ENV_RANGES];
+    uint32_t env_end[CRETE_TB_ENV_RANGES];
+    uint8_t nb_env_ranges;
+    /* The tb loads or stores guest memory */
+    uint8_t guest_mem;
+    /* The tb accesses host memory the summary can't tell about */
+    uint8_t unknown_mem;
+    /* The tb has crete custom instructions, which may introduce taint */
+    uint8_t custom_instr;
+} CreteTBTaintInputs;
+#endif //#if defined(CRETE_CONFIG) || 1
+
 struct TranslationBlock {
     target_ulong pc;   /* simulated PC corresponding to this block (EIP + CS base) */
     target_ulong cs_base; /* CS base for this block */
@@ -207,6 +228,15 @@ struct TranslationBlock {
      *  0x0000, tb finished without assigning last_opc
      * */
     int last_opc;
+
+    /* Cached verdict of pc include/exclude filters for this tb, valid only
+     * when pc_filter_gen matches the current filter generation:
+     * bit 0: tb->pc is within exclude filters
+     * bit 1: tb->pc is within include filters */
+    uint32_t pc_filter_gen;
+    uint32_t pc_filter_verdict;
+
+    CreteTBTaintInputs taint_inputs;
 #endif //#if defined(CRETE_CONFIG) || 1
 };
 
@@ -12,9 +12,13 @@ extern "C" {
 #define CRETE_CROSS_CHECK // Enable cross check
 //#define CRETE_DBG_CK    // Debug cross-check
 //#define CRETE_DBG_TA    // Debug taint-analysis
+//#define CRETE_DBG_TA_FAST_PATH // Always use instrumented TCI and verify the taint-free fast path
 //#define CRETE_DBG_MEM   // Debug memory usage
 //#define CRETE_DBG_MEM_MONI // Debug Memory monitoring
 #define CRETE_DBG_TODO    // Debug TODO work
+#define CRETE_PROFILE_CAPTURE // Profile capture phases, reported as capture_profile.json
+//#define CRETE_PROFILE_HISTOGRAMS // Also profile each helper and TB (costly), needs CRETE_PROFILE_CAPTURE
+//#define CRETE_TB_SLICING // Capture concrete writes of globals by TBs, so that the translator slices them away
 
 #define CRETE_DBG_REG fpregs[7]
 #define CRETE_GET_STRING(x) "fpregs[7]"
@@ -0,0 +1,212 @@
+#include "crete-profile.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+
+#include <boost/unordered_map.hpp>
+
+using namespace std;
+
+// The phase counters are plain arrays, cheap enough to be always on with
+// CRETE_PROFILE_CAPTURE. The stream writer thread only updates the shared phases,
+// atomically, and they are read once the writer thread is joined.
+struct CreteProfileCounter crete_profile_counters[CRETE_PROF_PHASE_COUNT];
+
+static uint64_t g_reset_cycles = 0;
+static struct timeval g_reset_time;
+
+#if defined(CRETE_PROFILE_HISTOGRAMS)
+typedef boost::unordered_map<uint64_t, CreteProfileCounter> CreteProfileCounterMap;
+
+// Hashed for each helper call and interested TB, so they are opt-in
+static CreteProfileCounterMap g_helper_counters;
+static CreteProfileCounterMap g_tb_counters;
+
+// Elements of unordered_map are not moved on rehash, so the counter of the last
+// key can be cached
+static uint64_t g_last_helper_addr = 0;
+static CreteProfileCounter *g_last_helper_counter = NULL;
+
+// Number of the most expensive TBs to report
+static const uint64_t CRETE_PROFILE_TOP_TB_COUNT = 32;
+#endif // defined(CRETE_PROFILE_HISTOGRAMS)
+
+static const char *const crete_profile_phase_names[CRETE_PROF_PHASE_COUNT] = {
+    "tci_untraced",
+    "tci_plain",
+    "tci_taint",
+    "taint_check",
+    "pre_tb",
+    "post_tb",
+    "tb_ir",
+    "helper_names",
+    "cpu_state",
+    "memo_sync",
+    "stream_push",
+    "stream_write",
+    "final_write"
+};
+
+void crete_profile_reset(void)
+{
+    memset(crete_profile_counters, 0, sizeof(crete_profile_counters));
+
+#if defined(CRETE_PROFILE_HISTOGRAMS)
+    g_helper_counters.clear();
+    g_tb_counters.clear();
+    g_last_helper_addr = 0;
+    g_last_helper_counter = NULL;
+#endif // defined(CRETE_PROFILE_HISTOGRAMS)
+
+    gettimeofday(&g_reset_time, NULL);
+    g_reset_cycles = crete_profile_rdtsc();
+}
+
+#if defined(CRETE_PROFILE_HISTOGRAMS)
+static inline void crete_profile_accumulate(CreteProfileCounter& counter, uint64_t begin)
+{
+    counter.count += 1;
+    counter.cycles += crete_profile_rdtsc() - begin;
+}
+
+void crete_profile_helper_call(uint64_t func_addr, uint64_t begin)
+{
+    if(func_addr != g_last_helper_addr || !g_last_helper_counter) {
+        CreteProfileCounter zero = {0, 0};
+        g_last_helper_counter =
+                &g_helper_counters.insert(make_pair(func_addr, zero)).first->second;
+        g_last_helper_addr = func_addr;
+    }
+
+    crete_profile_accumulate(*g_last_helper_counter, begin);
+}
+
+void crete_profile_tb(uint64_t pc, uint64_t begin)
+{
+    CreteProfileCounter zero = {0, 0};
+    crete_profile_accumulate(g_tb_counters.insert(make_pair(pc, zero)).first->second, begin);
+}
+
+static bool crete_profile_more_cycles(const pair<uint64_t, CreteProfileCounter>& lhs,
+        const pair<uint64_t, CreteProfileCounter>& rhs)
+{
+    return lhs.second.cycles > rhs.second.cycles;
+}
+#endif // defined(CRETE_PROFILE_HISTOGRAMS)
+
+static string crete_profile_json_string(const string& s)
+{
+    stringstream ss;
+    ss << '"';
+    for(string::const_iterator it = s.begin(); it != s.end(); ++it) {
+        if(*it == '"' || *it == '\\')
+            ss << '\\' << *it;
+        else if((unsigned char)*it < 0x20)
+            ss << ' ';
+        else
+            ss << *it;
+    }
+    ss << '"';
+
+    return ss.str();
+}
+
+static void crete_profile_write_counter(ostream& os, const CreteProfileCounter& counter)
+{
+    os << "\"count\": " << counter.count << ", \"cycles\": " << counter.cycles;
+}
+
+// Sorted by cycles in descending order, at most max_count entries
+#if defined(CRETE_PROFILE_HISTOGRAMS)
+static vector<pair<uint64_t, CreteProfileCounter> > crete_profile_sorted(
+        const CreteProfileCounterMap& counters, uint64_t max_count)
+{
+    vector<pair<uint64_t, CreteProfileCounter> > sorted(counters.begin(), counters.end());
+    sort(sorted.begin(), sorted.end(), crete_profile_more_cycles);
+
+    if(sorted.size() > max_count)
+        sorted.resize(max_count);
+
+    return sorted;
+}
+#endif // defined(CRETE_PROFILE_HISTOGRAMS)
+
+void crete_profile_write(const string& path,
+        const map<uint64_t, string>& helper_names,
+        const vector<pair<string, uint64_t> >& stats)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t cycles = crete_profile_rdtsc() - g_reset_cycles;
+    double seconds = (now.tv_sec - g_reset_time.tv_sec) +
+            (now.tv_usec - g_reset_time.tv_usec) / 1e6;
+
+    ofstream ofs(path.c_str());
+    if(!ofs.good()) {
+        cerr << "[CRETE Warning] failed to open capture profile: " << path << endl;
+        return;
+    }
+
+    ofs << "{\n";
+    ofs << "  \"version\": 1,\n";
+    ofs << "  \"wall_seconds\": " << seconds << ",\n";
+    ofs << "  \"cycles\": " << cycles << ",\n";
+    ofs << "  \"tsc_hz\": " << (uint64_t)(seconds > 0 ? cycles / seconds : 0) << ",\n";
+
+    ofs << "  \"stats\": {";
+    for(uint64_t i = 0; i < stats.size(); ++i) {
+        ofs << (i == 0 ? "\n" : ",\n")
+            << "    " << crete_profile_json_string(stats[i].first) << ": " << stats[i].second;
+    }
+    ofs << "\n  },\n";
+
+    ofs << "  \"phases\": {";
+    for(uint64_t i = 0; i < CRETE_PROF_PHASE_COUNT; ++i) {
+        ofs << (i == 0 ? "\n" : ",\n")
+            << "    \"" << crete_profile_phase_names[i] << "\": {";
+        crete_profile_write_counter(ofs, crete_profile_counters[i]);
+        ofs << "}";
+    }
+#if defined(CRETE_PROFILE_HISTOGRAMS)
+    ofs << "\n  },\n";
+
+    vector<pair<uint64_t, CreteProfileCounter> > helpers =
+            crete_profile_sorted(g_helper_counters, g_helper_counters.size());
+    ofs << "  \"helpers\": [";
+    for(uint64_t i = 0; i < helpers.size(); ++i) {
+        map<uint64_t, string>::const_iterator name = helper_names.find(helpers[i].first);
+
+        ofs << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": "
+            << crete_profile_json_string(name == helper_names.end() ? "" : name->second)
+            << ", \"addr\": \"0x" << hex << helpers[i].first << dec << "\", ";
+        crete_profile_write_counter(ofs, helpers[i].second);
+        ofs << "}";
+    }
+    ofs << "\n  ],\n";
+
+    vector<pair<uint64_t, CreteProfileCounter> > tbs =
+            crete_profile_sorted(g_tb_counters, CRETE_PROFILE_TOP_TB_COUNT);
+    ofs << "  \"top_tbs\": [";
+    for(uint64_t i = 0; i < tbs.size(); ++i) {
+        ofs << (i == 0 ? "\n" : ",\n")
+            << "    {\"pc\": \"0x" << hex << tbs[i].first << dec << "\", ";
+        crete_profile_write_counter(ofs, tbs[i].second);
+        ofs << "}";
+    }
+    ofs << "\n  ]\n";
+#else
+    (void)helper_names;
+    ofs << "\n  }\n";
+#endif // defined(CRETE_PROFILE_HISTOGRAMS)
+    ofs << "}\n";
+
+    if(!ofs.good()) {
+        cerr << "[CRETE Warning] failed to write capture profile: " << path << endl;
+    }
+}
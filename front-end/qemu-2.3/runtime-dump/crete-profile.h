@@ -0,0 +1,136 @@
+/* Low-overhead profiling counters of the capture phase */
+
+#ifndef CRETE_PROFILE_H
+#define CRETE_PROFILE_H
+
+#include "stdint.h"
+#include "crete-debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Phases of capture. Phases of the hooks around TB execution are inclusive of
+// the phases they call into (e.g. post_tb includes tb_ir and cpu_state)
+enum CreteProfilePhase {
+    CRETE_PROF_TCI_UNTRACED = 0, // TCI out of the target process/user code
+    CRETE_PROF_TCI_PLAIN,        // TCI of the taint-free fast path
+    CRETE_PROF_TCI_TAINT,        // instrumented TCI
+    CRETE_PROF_TAINT_CHECK,      // taint checks/updates of guest memory accesses
+    CRETE_PROF_PRE_TB,           // crete_pre_cpu_tb_exec()
+    CRETE_PROF_POST_TB,          // crete_post_cpu_tb_exec()
+    CRETE_PROF_TB_IR,            // capturing the IR of a TB
+    CRETE_PROF_HELPER_NAMES,     // dumping the names of helpers
+    CRETE_PROF_CPU_STATE,        // copies and diffs of CPUState
+    CRETE_PROF_MEMO_SYNC,        // memo-sync inserts of loads
+    CRETE_PROF_STREAM_PUSH,      // handing a window to the stream writer, including waits
+    CRETE_PROF_STREAM_WRITE,     // writing a streamed window (stream writer thread, shared)
+    CRETE_PROF_FINAL_WRITE,      // writing the last window and the rest of a trace
+    CRETE_PROF_PHASE_COUNT
+};
+
+struct CreteProfileCounter {
+    uint64_t count;
+    uint64_t cycles;
+};
+
+extern struct CreteProfileCounter crete_profile_counters[CRETE_PROF_PHASE_COUNT];
+
+static inline uint64_t crete_profile_rdtsc(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+static inline void crete_profile_add(enum CreteProfilePhase phase, uint64_t begin)
+{
+    crete_profile_counters[phase].count += 1;
+    crete_profile_counters[phase].cycles += crete_profile_rdtsc() - begin;
+}
+
+// For the shared phases, which are accumulated by more than one thread
+static inline void crete_profile_add_shared(enum CreteProfilePhase phase, uint64_t begin)
+{
+    __sync_fetch_and_add(&crete_profile_counters[phase].count, 1);
+    __sync_fetch_and_add(&crete_profile_counters[phase].cycles, crete_profile_rdtsc() - begin);
+}
+
+// Reset all the counters, at the beginning of an iteration
+void crete_profile_reset(void);
+// Histograms (CRETE_PROFILE_HISTOGRAMS), of the vCPU thread only:
+// Accumulate a call to the helper at func_addr
+void crete_profile_helper_call(uint64_t func_addr, uint64_t begin);
+// Accumulate an execution of the interested TB at pc
+void crete_profile_tb(uint64_t pc, uint64_t begin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(CRETE_PROFILE_CAPTURE)
+#define CRETE_PROFILE_BEGIN(begin) uint64_t begin = crete_profile_rdtsc()
+#define CRETE_PROFILE_END(phase, begin) crete_profile_add(phase, begin)
+#else
+#define CRETE_PROFILE_BEGIN(begin)
+#define CRETE_PROFILE_END(phase, begin)
+#endif // defined(CRETE_PROFILE_CAPTURE)
+
+#if defined(CRETE_PROFILE_CAPTURE) && defined(CRETE_PROFILE_HISTOGRAMS)
+#define CRETE_PROFILE_HISTOGRAM_BEGIN(begin) uint64_t begin = crete_profile_rdtsc()
+#define CRETE_PROFILE_HELPER_END(func_addr, begin) crete_profile_helper_call(func_addr, begin)
+#define CRETE_PROFILE_TB_END(pc, begin) crete_profile_tb(pc, begin)
+#else
+#define CRETE_PROFILE_HISTOGRAM_BEGIN(begin)
+#define CRETE_PROFILE_HELPER_END(func_addr, begin)
+#define CRETE_PROFILE_TB_END(pc, begin)
+#endif // defined(CRETE_PROFILE_CAPTURE) && defined(CRETE_PROFILE_HISTOGRAMS)
+
+#ifdef __cplusplus
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Accumulates the elapsed cycles of a scope to a phase
+class CreteProfileScope
+{
+public:
+    explicit CreteProfileScope(CreteProfilePhase phase, bool shared = false)
+    : m_phase(phase), m_shared(shared), m_begin(crete_profile_rdtsc()) {}
+    ~CreteProfileScope()
+    {
+        if(m_shared)
+            crete_profile_add_shared(m_phase, m_begin);
+        else
+            crete_profile_add(m_phase, m_begin);
+    }
+
+private:
+    CreteProfilePhase m_phase;
+    bool m_shared;
+    uint64_t m_begin;
+};
+
+#if defined(CRETE_PROFILE_CAPTURE)
+#define CRETE_PROFILE_SCOPE(phase) CreteProfileScope crete_profile_scope(phase)
+#define CRETE_PROFILE_SHARED_SCOPE(phase) CreteProfileScope crete_profile_scope(phase, true)
+#else
+#define CRETE_PROFILE_SCOPE(phase)
+#define CRETE_PROFILE_SHARED_SCOPE(phase)
+#endif // defined(CRETE_PROFILE_CAPTURE)
+
+// Write the counters of the current iteration as json, where helpers are named
+// by helper_names and stats are extra <name, value> counts of the iteration
+void crete_profile_write(const std::string& path,
+        const std::map<uint64_t, std::string>& helper_names,
+        const std::vector<std::pair<std::string, uint64_t> >& stats);
+
+#endif // __cplusplus
+
+#endif // CRETE_PROFILE_H
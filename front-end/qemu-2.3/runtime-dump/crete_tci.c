@@ -33,6 +33,7 @@
 #include "runtime-dump/runtime-dump.h"
 #include "runtime-dump/tci_analyzer.h"
 #include "runtime-dump/crete-debug.h"
+#include "runtime-dump/crete-profile.h"
 #endif //#if defined(CRETE_CONFIG)
 
 /* Marker for missing code. */
@@ -599,8 +600,10 @@ uintptr_t crete_tcg_qemu_tb_exec(CPUArchState *env, uint8_t *tb_ptr)
             tcg_target_ulong arg8 =  tci_read_reg(TCG_REG_R8);
             tcg_target_ulong arg9 =  tci_read_reg(TCG_REG_R9);
             tcg_target_ulong arg10 = tci_read_reg(TCG_REG_R10);
+            CRETE_PROFILE_HISTOGRAM_BEGIN(helper_begin);
             tmp64 = ((helper_function)t0)(arg0, arg1, arg2, arg3, arg5,
                                           arg6, arg7, arg8, arg9,arg10);
+            CRETE_PROFILE_HELPER_END((uint64_t)t0, helper_begin);
             tci_write_reg(TCG_REG_R0, tmp64);
             tci_write_reg(TCG_REG_R1, tmp64 >> 32);
 #else
@@ -630,7 +633,9 @@ uintptr_t crete_tcg_qemu_tb_exec(CPUArchState *env, uint8_t *tb_ptr)
                 }
             }
 #endif
+            CRETE_PROFILE_HISTOGRAM_BEGIN(helper_begin);
             tmp64 = ((helper_function)t0)(arg0, arg1, arg2, arg3, arg5);
+            CRETE_PROFILE_HELPER_END((uint64_t)t0, helper_begin);
 
 #if defined(CRETE_DBG_CK)
             if(is_in_list_crete_dbg_tb_pc(rt_dump_tb->pc)) {
@@ -1738,3 +1743,138 @@ uintptr_t crete_tcg_qemu_tb_exec(CPUArchState *env, uint8_t *tb_ptr)
 exit:
     return next_tb;
 }
+
+/* Add [begin, end) to the env ranges of inputs, keeping them sorted and disjoint.
+ * When there are too many ranges, the two closest ones are merged. */
+static void crete_tci_add_env_range(CreteTBTaintInputs *inputs,
+        uint32_t begin, uint32_t end)
+{
+    uint32_t begins[CRETE_TB_ENV_RANGES + 1];
+    uint32_t ends[CRETE_TB_ENV_RANGES + 1];
+    int n = 0;
+    int i, j;
+
+    /* Merge the ranges overlapping or adjacent to [begin, end) into it */
+    for (i = 0; i < inputs->nb_env_ranges; ++i) {
+        if (inputs->env_begin[i] <= end && begin <= inputs->env_end[i]) {
+            begin = MIN(begin, inputs->env_begin[i]);
+            end = MAX(end, inputs->env_end[i]);
+        } else {
+            begins[n] = inputs->env_begin[i];
+            ends[n] = inputs->env_end[i];
+            ++n;
+        }
+    }
+
+    for (i = n; i > 0 && begins[i - 1] > begin; --i) {
+        begins[i] = begins[i - 1];
+        ends[i] = ends[i - 1];
+    }
+    begins[i] = begin;
+    ends[i] = end;
+    ++n;
+
+    if (n > CRETE_TB_ENV_RANGES) {
+        j = 0;
+        for (i = 1; i < n - 1; ++i) {
+            if (begins[i + 1] - ends[i] < begins[j + 1] - ends[j]) {
+                j = i;
+            }
+        }
+
+        ends[j] = ends[j + 1];
+        for (i = j + 1; i < n - 1; ++i) {
+            begins[i] = begins[i + 1];
+            ends[i] = ends[i + 1];
+        }
+        --n;
+    }
+
+    memcpy(inputs->env_begin, begins, n * sizeof(*begins));
+    memcpy(inputs->env_end, ends, n * sizeof(*ends));
+    inputs->nb_env_ranges = n;
+}
+
+/* Summarize the accesses of the TCI code of tb to the state tracked by taint
+ * analysis. Host memory is only accessed by ld/st, either within env, or within
+ * the call stack, which holds the spilled temps of the tb being executed only. */
+void crete_tci_summarize_tb(TranslationBlock *tb, const uint8_t *code, int size)
+{
+    CreteTBTaintInputs *inputs = &tb->taint_inputs;
+    const uint8_t *ptr = code;
+    const uint8_t *end = code + size;
+
+    while (ptr < end) {
+        TCGOpcode opc = ptr[0];
+        uint8_t op_size = ptr[1];
+        uint32_t access_size = 0;
+        uint8_t base;
+        int32_t offset;
+
+        switch (opc) {
+        case INDEX_op_ld8u_i32:
+        case INDEX_op_ld8s_i32:
+        case INDEX_op_st8_i32:
+#if TCG_TARGET_REG_BITS == 64
+        case INDEX_op_ld8u_i64:
+        case INDEX_op_ld8s_i64:
+        case INDEX_op_st8_i64:
+#endif
+            access_size = 1;
+            break;
+        case INDEX_op_ld16u_i32:
+        case INDEX_op_ld16s_i32:
+        case INDEX_op_st16_i32:
+#if TCG_TARGET_REG_BITS == 64
+        case INDEX_op_ld16u_i64:
+        case INDEX_op_ld16s_i64:
+        case INDEX_op_st16_i64:
+#endif
+            access_size = 2;
+            break;
+        case INDEX_op_ld_i32:
+        case INDEX_op_st_i32:
+#if TCG_TARGET_REG_BITS == 64
+        case INDEX_op_ld32u_i64:
+        case INDEX_op_ld32s_i64:
+        case INDEX_op_st32_i64:
+#endif
+            access_size = 4;
+            break;
+#if TCG_TARGET_REG_BITS == 64
+        case INDEX_op_ld_i64:
+        case INDEX_op_st_i64:
+            access_size = 8;
+            break;
+#endif
+        case INDEX_op_qemu_ld_i32:
+        case INDEX_op_qemu_ld_i64:
+        case INDEX_op_qemu_st_i32:
+        case INDEX_op_qemu_st_i64:
+            inputs->guest_mem = 1;
+            break;
+        default:
+            break;
+        }
+
+        if (access_size != 0) {
+            /* opc, size, register, base register, offset */
+            base = ptr[3];
+            memcpy(&offset, ptr + 4, sizeof(offset));
+
+            if (base == TCG_AREG0 && offset >= 0) {
+                crete_tci_add_env_range(inputs, offset, offset + access_size);
+            } else if (base == TCG_AREG0 && offset == -4) {
+                /* Special case of the analyzer, always concrete */
+            } else if (base != TCG_REG_CALL_STACK) {
+                inputs->unknown_mem = 1;
+            }
+        }
+
+        if (op_size == 0) {
+            inputs->unknown_mem = 1;
+            break;
+        }
+        ptr += op_size;
+    }
+}
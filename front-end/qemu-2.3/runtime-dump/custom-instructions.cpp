@@ -5,7 +5,6 @@
 
 #include <boost/serialization/split_member.hpp>
 #include <boost/filesystem/fstream.hpp>
-#include <boost/unordered_set.hpp>
 #include <boost/filesystem/operations.hpp>
 
 #include <crete/custom_opcode.h>
@@ -20,6 +19,8 @@ void qemu_system_shutdown_request(void);
 
 #include "tcg.h"
 
+#include <map>
+
 using namespace std;
 
 // TODO: xxx We may need this to capture the initial test case, when
@@ -28,8 +29,73 @@ using namespace std;
 // static bool crete_flag_write_initial_input = false;
 static const string crete_trace_ready_file_name = "trace_ready";
 
-static boost::unordered_set<uint64_t> g_pc_exclude_filters;
-static boost::unordered_set<uint64_t> g_pc_include_filters;
+// Sorted, non-overlapping and non-adjacent ranges of pc: <begin, end>, where end is exclusive
+class PCFilterRanges
+{
+public:
+    void add(uint64_t begin, uint64_t end);
+    bool contains(uint64_t pc) const;
+    void clear() { m_ranges.clear(); }
+
+private:
+    typedef std::map<uint64_t, uint64_t> ranges_ty;
+    ranges_ty m_ranges;
+};
+
+void PCFilterRanges::add(uint64_t begin, uint64_t end)
+{
+    if(begin >= end)
+        return;
+
+    // Merge with the preceding range if it overlaps or touches [begin, end)
+    ranges_ty::iterator it = m_ranges.upper_bound(begin);
+    if(it != m_ranges.begin())
+    {
+        ranges_ty::iterator prev = it;
+        --prev;
+        if(prev->second >= begin)
+        {
+            if(prev->second >= end)
+                return;
+
+            begin = prev->first;
+            it = prev;
+        }
+    }
+
+    // Absorb all the following ranges starting within [begin, end]
+    while(it != m_ranges.end() && it->first <= end)
+    {
+        if(it->second > end)
+            end = it->second;
+
+        m_ranges.erase(it++);
+    }
+
+    m_ranges[begin] = end;
+}
+
+bool PCFilterRanges::contains(uint64_t pc) const
+{
+    ranges_ty::const_iterator it = m_ranges.upper_bound(pc);
+    if(it == m_ranges.begin())
+        return false;
+
+    --it;
+    return pc < it->second;
+}
+
+static PCFilterRanges g_pc_exclude_filters;
+static PCFilterRanges g_pc_include_filters;
+
+// Bumped whenever filters change, to invalidate verdicts cached in TranslationBlock
+static uint32_t g_pc_filter_gen = 1;
+
+enum CretePCFilterVerdict
+{
+    CRETE_PC_FILTER_EXCLUDE = 1 << 0,
+    CRETE_PC_FILTER_INCLUDE = 1 << 1,
+};
 
 // CRETE_INSTR_CAPTURE_BEGIN_VALUE
 static inline void crete_custom_instr_capture_begin()
@@ -102,6 +168,7 @@ static inline void crete_custom_instr_prime()
 {
     g_pc_include_filters.clear();
     g_pc_exclude_filters.clear();
+    ++g_pc_filter_gen;
 
 #if defined(CRETE_DBG_MEM)
     fprintf(stderr, "[CRETE_DBG_MEM] memory usage(crete_custom_instr_prime()) = %.3fMB\n",
@@ -122,7 +189,14 @@ static inline void crete_tracing_finish()
         ; // Wait for it to not exist. FIXME: not efficient and can hang qume.
 
     // Writing trace to file
-    runtime_env->writeRtEnvToFile();
+    try {
+        runtime_env->writeRtEnvToFile();
+    }
+    catch(std::exception& e) {
+        // Not marking the trace as ready: the vm-node sees qemu exit instead
+        cerr << "[CRETE ERROR] failed to write the trace, aborting: " << e.what() << endl;
+        abort();
+    }
     runtime_env->printInfo();
 
     fs::ofstream ofs(fs::path("hostfile") / crete_trace_ready_file_name);
@@ -159,9 +233,8 @@ static inline void crete_custom_instr_exclude_filter()
     target_ulong addr_begin = g_cpuState_bct->regs[R_EAX];
     target_ulong addr_end = g_cpuState_bct->regs[R_ECX];
 
-    for(uint64_t i = addr_begin; i < addr_end; ++i) {
-        g_pc_exclude_filters.insert(i);
-    }
+    g_pc_exclude_filters.add(addr_begin, addr_end);
+    ++g_pc_filter_gen;
 }
 
 // CRETE_INSTR_INCLUDE_FILTER_VALUE
@@ -171,9 +244,8 @@ static inline void crete_custom_instr_inlude_filter()
     target_ulong addr_begin = g_cpuState_bct->regs[R_EAX];
     target_ulong addr_end = g_cpuState_bct->regs[R_ECX];
 
-    for(uint64_t i = addr_begin; i < addr_end; ++i) {
-        g_pc_include_filters.insert(i);
-    }
+    g_pc_include_filters.add(addr_begin, addr_end);
+    ++g_pc_filter_gen;
 }
 
 
@@ -278,22 +350,38 @@ void crete_custom_instruction_handler(uint64_t arg) {
 
 int crete_is_pc_in_exclude_filter_range(uint64_t pc)
 {
-    boost::unordered_set<uint64_t>::const_iterator it = g_pc_exclude_filters.find(pc);
-    if(it != g_pc_exclude_filters.end()){
-        return 1;
-    } else {
-        return 0;
-    }
+    return g_pc_exclude_filters.contains(pc) ? 1 : 0;
 }
 
 int crete_is_pc_in_include_filter_range(uint64_t pc)
 {
-    boost::unordered_set<uint64_t>::const_iterator it = g_pc_include_filters.find(pc);
-    if(it != g_pc_include_filters.end()){
-        return 1;
-    } else {
-        return 0;
+    return g_pc_include_filters.contains(pc) ? 1 : 0;
+}
+
+static inline uint32_t crete_get_tb_pc_filter_verdict(TranslationBlock *tb)
+{
+    if(tb->pc_filter_gen != g_pc_filter_gen)
+    {
+        tb->pc_filter_verdict = 0;
+        if(g_pc_exclude_filters.contains(tb->pc))
+            tb->pc_filter_verdict |= CRETE_PC_FILTER_EXCLUDE;
+        if(g_pc_include_filters.contains(tb->pc))
+            tb->pc_filter_verdict |= CRETE_PC_FILTER_INCLUDE;
+
+        tb->pc_filter_gen = g_pc_filter_gen;
     }
+
+    return tb->pc_filter_verdict;
+}
+
+int crete_is_tb_in_exclude_filter_range(TranslationBlock *tb)
+{
+    return (crete_get_tb_pc_filter_verdict(tb) & CRETE_PC_FILTER_EXCLUDE) ? 1 : 0;
+}
+
+int crete_is_tb_in_include_filter_range(TranslationBlock *tb)
+{
+    return (crete_get_tb_pc_filter_verdict(tb) & CRETE_PC_FILTER_INCLUDE) ? 1 : 0;
 }
 
 struct PIDWriter
@@ -23,6 +23,10 @@ enum CreteFileType {
 
 int crete_is_pc_in_exclude_filter_range(uint64_t pc);
 int crete_is_pc_in_include_filter_range(uint64_t pc);
+struct TranslationBlock;
+// Same as above, with the verdict cached in tb
+int crete_is_tb_in_exclude_filter_range(struct TranslationBlock *tb);
+int crete_is_tb_in_include_filter_range(struct TranslationBlock *tb);
 #endif
 
 #endif
@@ -1,6 +1,7 @@
 #include "runtime-dump.h"
 #include "tci_analyzer.h"
 #include "crete-debug.h"
+#include "crete-profile.h"
 
 extern "C" {
 #include "config.h"
@@ -14,6 +15,8 @@ extern "C" {
 #include <crete/stacktrace.h>
 
 #include <stdexcept>
+#include <cerrno>
+#include <algorithm>
 #include <boost/filesystem/operations.hpp>
 
 #include "custom-instructions.h"
@@ -58,11 +61,64 @@ CPUArchState *g_cpuState_bct = 0;
 #define CPU_OFFSET(field) offsetof(CPUArchState, field)
 
 static const uint32_t CRETE_TRACING_WINDOW_SIZE = 10000;
+// Memory of the windows queued for the stream writer thread, beyond which tracing
+// waits for the writer, unless set in MB by the environment variable
+// CRETE_STREAM_WRITER_BUDGET
+static const uint64_t CRETE_STREAM_WRITER_DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+// Captured TB IR reused across traces, dropped as a whole once it reaches
+// CRETE_TB_IR_STORE_MAX_SIZE entries
+static const uint32_t CRETE_TB_IR_STORE_MAX_SIZE = 8192;
+static TBIRStore g_tb_ir_store;
+static uint64_t g_tb_ir_generation = 0;
 
 /***********************************/
 /* External interface for C++ code */
+static uint64_t x86_cpuState_traced_size();
+
+static uint64_t crete_stream_writer_budget()
+{
+    const char *value = getenv("CRETE_STREAM_WRITER_BUDGET");
+    if(!value)
+        return CRETE_STREAM_WRITER_DEFAULT_BUDGET;
+
+    char *end;
+    errno = 0;
+    unsigned long long mb = strtoull(value, &end, 10);
+    if(errno != 0 || end == value || *end != '\0' || mb == 0 || mb > (~(uint64_t)0 >> 20)) {
+        cerr << "[CRETE Warning] invalid CRETE_STREAM_WRITER_BUDGET: " << value
+             << ", using the default\n";
+        return CRETE_STREAM_WRITER_DEFAULT_BUDGET;
+    }
+
+    return (uint64_t)mb << 20;
+}
+
+// Write object as a boost archive to the file at path, throwing on failure
+template <typename T>
+static void crete_write_archive(const string& path, const T& object)
+{
+    ofstream ofs(path.c_str(), ios_base::binary);
+    if(!ofs.good())
+        throw runtime_error("can't open file: " + path);
+
+    {
+        boost::archive::binary_oarchive oa(ofs);
+        oa << object;
+    }
+
+    ofs.flush();
+    if(!ofs.good())
+        throw runtime_error("failed to write file: " + path);
+}
+
 RuntimeEnv::RuntimeEnv()
-: m_streamed_tb_count(0), m_streamed_index(0)
+: m_cpuState_traced_size(x86_cpuState_traced_size()),
+  m_tb_ir_generation(++g_tb_ir_generation),
+  m_streamed_tb_count(0), m_streamed_index(0),
+  m_stream_writer_started(false), m_stream_writer_stop(false),
+  m_stream_queued_size(0),
+  m_stream_writer_budget(crete_stream_writer_budget())
 {
     m_cpuState_post_insterest.first = false;
     m_cpuState_post_insterest.second = new uint8_t [sizeof(CPUArchState)];
@@ -76,6 +132,13 @@ RuntimeEnv::RuntimeEnv()
 
 RuntimeEnv::~RuntimeEnv()
 {
+    try {
+        stopStreamWriter();
+    }
+    catch(std::exception& e) {
+        std::cerr << "[CRETE Exception] " << e.what() << std::endl;
+    }
+
     assert(m_cpuState_post_insterest.second);
     delete [] (uint8_t *)m_cpuState_post_insterest.second;
 
@@ -83,12 +146,45 @@ RuntimeEnv::~RuntimeEnv()
     delete [] (uint8_t *)m_cpuState_pre_interest.second;
 }
 
+// FNV-1a
+static uint64_t crete_hash_code(const vector<uint8_t>& code)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(vector<uint8_t>::const_iterator it = code.begin(); it != code.end(); ++it) {
+        hash ^= *it;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+// Return false if the guest code of tb is not accessible
+static bool crete_get_tb_ir_key(void *cpuState, const TranslationBlock *tb,
+        uint64_t crete_interrupted_pc, TBIRKey& key, vector<uint8_t>& code)
+{
+    code.resize(tb->size);
+    if(code.empty() ||
+       RuntimeEnv::access_guest_memory(cpuState, tb->pc, &code[0], code.size(), 0) != 0)
+        return false;
+
+    key.m_pc = tb->pc;
+    key.m_cs_base = tb->cs_base;
+    key.m_flags = tb->flags;
+    key.m_cflags = tb->cflags;
+    key.m_end_pc = crete_interrupted_pc;
+    key.m_code_hash = crete_hash_code(code);
+
+    return true;
+}
+
 // Dump the context for offline translation from qemu-ir to llvm bitcode
-// TODO: xxx Optimize the way how we trace the tcg_ctx:
-//      1. Translate from a copy of current TB,
-//      2. Only update the relevant flag of current TB if necessary for caching purpose
+// The IR of a tb is generated once per guest code: a tb whose code was captured
+// earlier in this trace refers to the captured one, and the IR captured in previous
+// traces is copied instead of being generated again.
 void RuntimeEnv::dump_tloCtx(void *cpuState, TranslationBlock *tb, uint64_t crete_interrupted_pc)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TB_IR);
+
     if(crete_interrupted_pc == 0) {
         assert(tb->tcg_ctx_captured == 0);
         assert(tb->index_captured_llvm_tb == -1);
@@ -105,30 +201,65 @@ void RuntimeEnv::dump_tloCtx(void *cpuState, TranslationBlock *tb, uint64_t cret
     if(nb_captured_llvm_tb == 0)
         dump_tloHelpers(*s);
 
-    tcg_func_start(s);
-	gen_intermediate_code_crete(env, tb, crete_interrupted_pc);
-//	gen_intermediate_code_pc(env,tb);
+    TBIRKey key;
+    vector<uint8_t> code;
+    TBIRStoreEntry *entry = NULL;
+    bool keyed = crete_get_tb_ir_key(cpuState, tb, crete_interrupted_pc, key, code);
+
+    if(keyed) {
+        TBIRStore::iterator it = g_tb_ir_store.find(key);
+        if(it != g_tb_ir_store.end()) {
+            if(it->second.m_code == code) {
+                entry = &it->second;
+            } else {
+                g_tb_ir_store.erase(it);
+            }
+        }
+
+        if(entry && entry->m_generation == m_tb_ir_generation) {
+            tb->index_captured_llvm_tb = entry->m_index;
+            return;
+        }
+    }
+
+    if(entry) {
+        dump_tloTbInstCount(entry->m_inst_count);
+        dump_tloTbPc((uint64_t)tb->pc);
+        m_tcg_llvm_offline_ctx.dump_tcg_tb_ir(entry->m_tb_ir);
+    } else {
+        tcg_func_start(s);
+        gen_intermediate_code_crete(env, tb, crete_interrupted_pc);
+//      gen_intermediate_code_pc(env,tb);
 
-    // the number of instructions within this tb
-    uint64_t tb_inst_count = tcg_tb_inst_count(s);
-	dump_tloTbInstCount(tb_inst_count);
+        // the number of instructions within this tb
+        uint64_t tb_inst_count = tcg_tb_inst_count(s);
+        dump_tloTbInstCount(tb_inst_count);
 
-//	cerr << "tb_inst_count = " << dec << tb_inst_count << endl;
+        // tb->pc
+        dump_tloTbPc((uint64_t)tb->pc);
 
-    // tb->pc
-    dump_tloTbPc((uint64_t)tb->pc);
+        // ops, params and temps of tcg_ctx used by this tb
+        dump_tloTcgCtx(*s);
 
-    // tcg_ctx
-    dump_tloTcgCtx(*s);
+        if(keyed) {
+            if(g_tb_ir_store.size() >= CRETE_TB_IR_STORE_MAX_SIZE)
+                g_tb_ir_store.clear();
 
-    //tcg_temp
-    vector<TCGTemp> temp_tcg_temp;
-    for(uint32_t i = 0; i < (uint32_t)s->nb_temps; ++i)
-    	temp_tcg_temp.push_back(s->temps[i]);
-    dump_tcg_temp(temp_tcg_temp);
+            entry = &g_tb_ir_store[key];
+            entry->m_code.swap(code);
+            entry->m_inst_count = tb_inst_count;
+            entry->m_tb_ir = m_tcg_llvm_offline_ctx.get_tcg_tb_ir(
+                    m_tcg_llvm_offline_ctx.get_size() - 1);
+        }
+    }
 
     tb->index_captured_llvm_tb = nb_captured_llvm_tb++;
 
+    if(entry) {
+        entry->m_generation = m_tb_ir_generation;
+        entry->m_index = tb->index_captured_llvm_tb;
+    }
+
     //for debug purpsoe, qemu ir
 //    dump_IR(s, tb->pc);
 }
@@ -142,19 +273,22 @@ void RuntimeEnv::addInitialCpuState()
     memcpy(m_initial_CpuState.data(), m_cpuState_pre_interest.second, sizeof(CPUArchState));
 }
 
-static vector<CPUStateElement> x86_cpuState_compuate_side_effect(const CPUArchState *reference,
-        const CPUArchState *target);
+static void x86_cpuState_compuate_side_effect(const uint8_t *reference,
+        const uint8_t *target, CPUStateSyncTable &sync_table);
 
 void RuntimeEnv::addcpuStateSyncTable()
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_CPU_STATE);
+
     assert(m_cpuState_post_insterest.first == true);
     assert(m_cpuState_pre_interest.first == true);
 
-    const CPUArchState *post_interest = (const CPUArchState *) m_cpuState_post_insterest.second;
-    const CPUArchState *pre_insterest = (const CPUArchState *) m_cpuState_pre_interest.second;
+    const uint8_t *post_interest = (const uint8_t *) m_cpuState_post_insterest.second;
+    const uint8_t *pre_insterest = (const uint8_t *) m_cpuState_pre_interest.second;
 
-    m_cpuStateSyncTables.push_back(make_pair(true,
-            x86_cpuState_compuate_side_effect(post_interest, pre_insterest)));
+    m_cpuStateSyncTables.push_back(CPUStateSyncTable());
+    x86_cpuState_compuate_side_effect(post_interest, pre_insterest,
+            m_cpuStateSyncTables.back());
 
     // Invalid m_cpuState_post_insterest, after CPUState side-effect is computed
     m_cpuState_post_insterest.first = false;
@@ -162,13 +296,109 @@ void RuntimeEnv::addcpuStateSyncTable()
 
 void RuntimeEnv::addEmptyCPUStateSyncTable()
 {
-    m_cpuStateSyncTables.push_back(make_pair(false, vector<CPUStateElement>()));
+    m_cpuStateSyncTables.push_back(CPUStateSyncTable());
+}
+
+static inline void crete_set_bit(vector<uint64_t>& bitmap, uint64_t index)
+{
+    bitmap[index / 64] |= 1ULL << (index % 64);
+}
+
+static inline bool crete_test_bit(const vector<uint64_t>& bitmap, uint64_t index)
+{
+    return (bitmap[index / 64] >> (index % 64)) & 1;
+}
+
+// Globals of tcg_ctx in the traced prefix of CPUState, as only that part of
+// CPUState is kept before each TB
+void RuntimeEnv::initSliceGlobals()
+{
+    if(!m_tb_entry_tainted_globals.empty())
+        return;
+
+    const TCGContext *s = &tcg_ctx;
+    for(int i = 0; i < s->nb_globals; ++i) {
+        const TCGTemp &ts = s->temps[i];
+        if(ts.fixed_reg || ts.mem_reg != TCG_AREG0)
+            continue;
+
+        uint64_t size = (ts.type == TCG_TYPE_I64) ? 8 : 4;
+        if(ts.mem_offset < 0 || ts.mem_offset + size > m_cpuState_traced_size)
+            continue;
+
+        m_slice_globals.push_back(TBSliceGlobal(i, ts.mem_offset, size));
+    }
+
+    m_tb_entry_tainted_globals.resize((s->nb_globals + 63) / 64, 0);
+}
+
+void RuntimeEnv::setTBEntryTaint()
+{
+    initSliceGlobals();
+
+    fill(m_tb_entry_tainted_globals.begin(), m_tb_entry_tainted_globals.end(), 0);
+    for(vector<TBSliceGlobal>::const_iterator it = m_slice_globals.begin();
+            it != m_slice_globals.end(); ++it) {
+        if(crete_tci_is_vcpu_tainted(it->m_offset, it->m_size))
+            crete_set_bit(m_tb_entry_tainted_globals, it->m_index);
+    }
+}
+
+// Record the globals being concrete after an interested TB and possibly written by it,
+// which are either unchanged or tainted before the TB. Globals tainted after the TB are
+// marked as kept for the IR of the TB, as the TB has to compute them symbolically.
+// Writes of the other globals can be sliced away from the TB by the translator, as they
+// are applied by the replayer from this table.
+void RuntimeEnv::addTBPostSyncTable(const void *qemuCpuState, uint64_t index_captured_llvm_tb)
+{
+    CRETE_PROFILE_SCOPE(CRETE_PROF_CPU_STATE);
+
+    assert(m_cpuState_pre_interest.first);
+    assert(!m_tb_entry_tainted_globals.empty());
+
+    const uint8_t *pre_tb = (const uint8_t *) m_cpuState_pre_interest.second;
+    const uint8_t *post_tb = (const uint8_t *) qemuCpuState;
+
+    if(index_captured_llvm_tb >= m_tb_kept_globals.size())
+        m_tb_kept_globals.resize(index_captured_llvm_tb + 1);
+
+    vector<uint64_t>& kept_globals = m_tb_kept_globals[index_captured_llvm_tb];
+    if(kept_globals.empty()) {
+        kept_globals.assign(m_tb_entry_tainted_globals.size(), ~0ULL);
+        for(vector<TBSliceGlobal>::const_iterator it = m_slice_globals.begin();
+                it != m_slice_globals.end(); ++it) {
+            kept_globals[it->m_index / 64] &= ~(1ULL << (it->m_index % 64));
+        }
+    }
+
+    m_tbPostSyncTables.push_back(CPUStateSyncTable());
+    CPUStateSyncTable& sync_table = m_tbPostSyncTables.back();
+    sync_table.m_valid = true;
+
+    for(vector<TBSliceGlobal>::const_iterator it = m_slice_globals.begin();
+            it != m_slice_globals.end(); ++it) {
+        if(crete_tci_is_vcpu_tainted(it->m_offset, it->m_size)) {
+            crete_set_bit(kept_globals, it->m_index);
+            continue;
+        }
+
+        if(!crete_test_bit(m_tb_entry_tainted_globals, it->m_index) &&
+                memcmp(pre_tb + it->m_offset, post_tb + it->m_offset, it->m_size) == 0)
+            continue;
+
+        sync_table.m_elements.push_back(CPUStateSideEffect(it->m_index, it->m_offset,
+                it->m_size, sync_table.m_data.size()));
+        sync_table.m_data.insert(sync_table.m_data.end(),
+                post_tb + it->m_offset, post_tb + it->m_offset + it->m_size);
+    }
 }
 
 vector<CPUStateElement> x86_cpuState_dump(const CPUArchState *target);
 
 void RuntimeEnv::addDebugCpuStateSyncTable(void *qemuCpuState)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_CPU_STATE);
+
     assert(qemuCpuState);
 
 #if defined(CRETE_CROSS_CHECK)
@@ -201,35 +431,139 @@ void RuntimeEnv::printDebugCpuStateSyncTable(const string name) const
     cerr << "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\n";
 }
 
-void RuntimeEnv::addCurrentMemoSyncTableEntry(uint64_t addr, uint32_t size, uint64_t value)
+const uint64_t MemoSyncArena::dedup_slot_count;
+
+MemoSyncArena::MemoSyncArena()
+: m_merge_point(0), m_current_begin(0),
+  m_dedup_slots(dedup_slot_count, 0), m_dedup_seq_begin(1), m_dedup_seq_next(1)
+{
+}
+
+// Return true if the load is recorded in the current TB, otherwise add it to the
+// dedup set, which takes the record to be appended
+inline bool MemoSyncArena::is_recorded(uint64_t addr, uint32_t size)
+{
+    // Leave dedup to klee once the set is 3/4 full
+    if(m_dedup_seq_next - m_dedup_seq_begin >= dedup_slot_count / 4 * 3)
+        return false;
+
+    uint64_t slot = (((addr ^ ((uint64_t)size << 59)) * 0x9e3779b97f4a7c15ULL) >> 32) &
+            (dedup_slot_count - 1);
+    for(;; slot = (slot + 1) & (dedup_slot_count - 1)) {
+        uint64_t seq = m_dedup_slots[slot];
+        // Slots of previous TBs, or of dropped records, are free
+        if(seq < m_dedup_seq_begin) {
+            m_dedup_slots[slot] = m_dedup_seq_next++;
+            return false;
+        }
+
+        const crete::trace::MemoLoadRecord& record =
+                m_records[m_current_begin + (seq - m_dedup_seq_begin)];
+        if(record.addr == addr && record.size == size)
+            return true;
+    }
+}
+
+void MemoSyncArena::add_load(uint64_t addr, uint32_t size, uint64_t value)
 {
     assert(size <= 8);
-    uint8_t byte_value;
-    for(uint64_t i = 0; i < size ; ++i){
-        byte_value = (value >> i*8) & 0xff;
-        m_currentMemoSyncTable.insert(make_pair(addr + i, byte_value));
+
+    if(is_recorded(addr, size))
+        return;
+
+    crete::trace::MemoLoadRecord record;
+    record.addr = addr;
+    record.value = value;
+    record.size = size;
+    record.padding = 0;
+    m_records.push_back(record);
+}
+
+void MemoSyncArena::add_current_table()
+{
+    m_merge_point = m_table_sizes.size();
+    m_table_sizes.push_back(m_records.size() - m_current_begin);
+
+    m_current_begin = m_records.size();
+    reset_dedup();
+}
+
+// Records of the TBs after the merge point are contiguous with its records
+void MemoSyncArena::merge_current_table()
+{
+    assert(m_merge_point < m_table_sizes.size());
+
+    m_table_sizes[m_merge_point] += m_records.size() - m_current_begin;
+    m_table_sizes.push_back(0);
+
+    m_current_begin = m_records.size();
+    reset_dedup();
+}
+
+void MemoSyncArena::clear_current_table()
+{
+    m_records.resize(m_current_begin);
+    reset_dedup();
+}
+
+pair<const crete::trace::MemoLoadRecord *, const crete::trace::MemoLoadRecord *>
+MemoSyncArena::get_table(uint64_t tb_index) const
+{
+    assert(tb_index < m_table_sizes.size());
+
+    uint64_t begin = 0;
+    for(uint64_t i = 0; i < tb_index; ++i)
+        begin += m_table_sizes[i];
+
+    const crete::trace::MemoLoadRecord *first = m_records.data() + begin;
+    return make_pair(first, first + m_table_sizes[tb_index]);
+}
+
+void MemoSyncArena::write(crete::trace::TraceWriter& writer) const
+{
+    vector<uint64_t> boundaries;
+    boundaries.reserve(m_table_sizes.size());
+
+    uint64_t offset = 0;
+    for(vector<uint64_t>::const_iterator it = m_table_sizes.begin();
+            it != m_table_sizes.end(); ++it) {
+        boundaries.push_back(offset);
+        offset += *it * sizeof(crete::trace::MemoLoadRecord);
     }
+
+    assert(offset == m_current_begin * sizeof(crete::trace::MemoLoadRecord));
+    writer.write_chunk(crete::trace::chunk_memo_sync_tables, 0, boundaries,
+            m_records.data(), offset);
 }
 
-// Add m_currentMemoSyncTable to m_memoSyncTables
+void MemoSyncArena::clear()
+{
+    m_records.clear();
+    m_table_sizes.clear();
+    m_merge_point = 0;
+    m_current_begin = 0;
+    reset_dedup();
+}
+
+void RuntimeEnv::addCurrentMemoSyncTableEntry(uint64_t addr, uint32_t size, uint64_t value)
+{
+    m_memoSyncTables.add_load(addr, size, value);
+}
+
+// Add the loads of the current TB as a new memo sync table
 void RuntimeEnv::addCurrentMemoSyncTable()
 {
-    m_memoSyncTables.push_back(m_currentMemoSyncTable);
-    m_mergePoint_memoSyncTables = m_memoSyncTables.size() - 1;
+    m_memoSyncTables.add_current_table();
 }
 
 void RuntimeEnv::mergeCurrentMemoSyncTable()
 {
-    assert(m_mergePoint_memoSyncTables < m_memoSyncTables.size());
-
-    m_memoSyncTables.push_back(memoSyncTable_ty());
-    m_memoSyncTables[m_mergePoint_memoSyncTables].insert(m_currentMemoSyncTable.begin(),
-            m_currentMemoSyncTable.end());
+    m_memoSyncTables.merge_current_table();
 }
 
 void RuntimeEnv::clearCurrentMemoSyncTable()
 {
-    m_currentMemoSyncTable.clear();
+    m_memoSyncTables.clear_current_table();
 }
 
 #if defined(CRETE_DBG_MEM_MONI)
@@ -396,18 +730,28 @@ void RuntimeEnv::writeRtEnvToFile()
             return;
         }
 
+        CRETE_PROFILE_BEGIN(final_write_begin);
+
         verifyDumpData();
 
         if(rt_dump_tb_count < CRETE_TRACING_WINDOW_SIZE){
             initOutputDirectory("");
+            m_trace_writer.open(getOutputFilename("dump_trace.bin"));
             writeInitialCpuState();
             writeDebugCpuStateOffsets();
         }
 
-        // streamed
-        writeTcgLlvmCtx();
-        writeCPUStateSyncTables();
-        writeDebugCPUStateSyncTables();
+        // streamed: the last window is written after all the queued ones
+        stopStreamWriter();
+
+#if defined(CRETE_TB_SLICING)
+        // Kept globals of TBs are only final once the trace is complete
+        m_tcg_llvm_offline_ctx.dump_tb_kept_globals(m_tb_kept_globals);
+#endif
+
+        StreamedWindow window;
+        takeStreamedWindow(window);
+        writeStreamedWindow(window);
 
         // to-be-streamed
         writeInterruptStates();
@@ -421,11 +765,21 @@ void RuntimeEnv::writeRtEnvToFile()
         // need-not-streamed
         writeConcolics();
         writeTBGraphExecSequ();
+
+        m_trace_writer.close();
+
+        CRETE_PROFILE_END(CRETE_PROF_FINAL_WRITE, final_write_begin);
+#if defined(CRETE_PROFILE_CAPTURE)
+        writeCaptureProfile();
+#endif
     }
     catch(std::exception& e)
     {
         std::cerr << "[CRETE Exception] " << e.what() << std::endl;
         print_stacktrace();
+
+        // An incomplete trace must not be picked up as a complete one
+        throw;
     }
 }
 
@@ -435,21 +789,197 @@ void RuntimeEnv::stream_writeRtEnvToFile(uint64_t tb_count){
 
     assert((tb_count - m_streamed_tb_count) == CRETE_TRACING_WINDOW_SIZE);
 
+    CRETE_PROFILE_SCOPE(CRETE_PROF_STREAM_PUSH);
+
     if(tb_count/CRETE_TRACING_WINDOW_SIZE == 1){
-        initOutputDirectory("");
-        writeInitialCpuState();
-        writeDebugCpuStateOffsets();
+        try {
+            initOutputDirectory("");
+            m_trace_writer.open(getOutputFilename("dump_trace.bin"));
+            writeInitialCpuState();
+            writeDebugCpuStateOffsets();
+        }
+        catch(std::exception& e) {
+            // Called from the vCPU loop, which can't unwind: the trace is never marked
+            // ready, as in crete_tracing_finish()
+            cerr << "[CRETE ERROR] failed to start the trace, aborting: " << e.what() << endl;
+            abort();
+        }
+
+        startStreamWriter();
     }
 
-    writeTcgLlvmCtx();
-    writeCPUStateSyncTables();
-    writeDebugCPUStateSyncTables();
+    StreamedWindow *window = new StreamedWindow;
+    takeStreamedWindow(*window);
+    pushStreamedWindow(window);
 //    debug_writeMemoSyncTables();
 
     ++m_streamed_index;
     m_streamed_tb_count = tb_count;
 }
 
+static uint64_t cpuStateSyncTables_size(const vector<cpuStateSyncTable_ty>& cpuStateSyncTables)
+{
+    uint64_t size = 0;
+    for(vector<cpuStateSyncTable_ty>::const_iterator it = cpuStateSyncTables.begin();
+            it != cpuStateSyncTables.end(); ++it) {
+        size += sizeof(cpuStateSyncTable_ty) +
+                it->m_elements.size() * sizeof(CPUStateSideEffect) +
+                it->m_data.size();
+    }
+
+    return size;
+}
+
+uint64_t StreamedWindow::get_size() const
+{
+    uint64_t size = sizeof(StreamedWindow) + m_tcg_llvm_offline_ctx.get_tcg_tb_irs_bytes();
+
+    size += cpuStateSyncTables_size(m_cpuStateSyncTables);
+    size += cpuStateSyncTables_size(m_tbPostSyncTables);
+
+    for(vector<debug_cpuStateSyncTable_ty>::const_iterator it = m_debug_cpuStateSyncTables.begin();
+            it != m_debug_cpuStateSyncTables.end(); ++it) {
+        size += sizeof(debug_cpuStateSyncTable_ty);
+
+        for(vector<CPUStateElement>::const_iterator e_it = it->second.begin();
+                e_it != it->second.end(); ++e_it) {
+            size += sizeof(CPUStateElement) + e_it->m_name.size() + e_it->m_data.size();
+        }
+    }
+
+    return size;
+}
+
+// Move the traced data of the current window into window
+void RuntimeEnv::takeStreamedWindow(StreamedWindow& window)
+{
+    window.m_index = m_streamed_index;
+    window.m_first_tb = m_streamed_tb_count;
+
+    window.m_tcg_llvm_offline_ctx.swap(m_tcg_llvm_offline_ctx);
+    m_tcg_llvm_offline_ctx.dump_cpuState_size(sizeof(CPUArchState));
+
+    window.m_cpuStateSyncTables.swap(m_cpuStateSyncTables);
+    window.m_debug_cpuStateSyncTables.swap(m_debug_cpuStateSyncTables);
+    window.m_tbPostSyncTables.swap(m_tbPostSyncTables);
+
+    window.m_size = window.get_size();
+}
+
+void RuntimeEnv::writeStreamedWindow(StreamedWindow& window)
+{
+    CRETE_PROFILE_SHARED_SCOPE(CRETE_PROF_STREAM_WRITE);
+
+    writeTcgLlvmCtx(window.m_tcg_llvm_offline_ctx, window.m_index);
+    writeCPUStateSyncTables(window.m_cpuStateSyncTables, window.m_first_tb);
+    writeDebugCPUStateSyncTables(window.m_debug_cpuStateSyncTables, window.m_index);
+
+    if(!window.m_tbPostSyncTables.empty()) {
+        writeCPUStateSyncTables(window.m_tbPostSyncTables, window.m_first_tb,
+                crete::trace::chunk_tb_post_sync_tables);
+    }
+
+    // The window is on disk before the next one is taken
+    m_trace_writer.sync();
+}
+
+void RuntimeEnv::startStreamWriter()
+{
+    assert(!m_stream_writer_started);
+
+    qemu_mutex_init(&m_stream_mutex);
+    qemu_cond_init(&m_stream_cond);
+    m_stream_writer_stop = false;
+    m_stream_writer_started = true;
+
+    qemu_thread_create(&m_stream_writer, "crete-trace-writer",
+            streamWriterThread, this, QEMU_THREAD_JOINABLE);
+}
+
+// Wait for all the queued windows to be written, and join the writer thread.
+// Rethrows the failure of the writer thread, if any.
+void RuntimeEnv::stopStreamWriter()
+{
+    if(!m_stream_writer_started)
+        return;
+
+    qemu_mutex_lock(&m_stream_mutex);
+    m_stream_writer_stop = true;
+    qemu_cond_broadcast(&m_stream_cond);
+    qemu_mutex_unlock(&m_stream_mutex);
+
+    qemu_thread_join(&m_stream_writer);
+
+    assert(m_stream_queue.empty() && m_stream_queued_size == 0);
+    qemu_cond_destroy(&m_stream_cond);
+    qemu_mutex_destroy(&m_stream_mutex);
+    m_stream_writer_started = false;
+
+    if(m_stream_error) {
+        boost::exception_ptr error = m_stream_error;
+        m_stream_error = boost::exception_ptr();
+
+        boost::rethrow_exception(error);
+    }
+}
+
+void RuntimeEnv::pushStreamedWindow(StreamedWindow *window)
+{
+    assert(m_stream_writer_started);
+
+    qemu_mutex_lock(&m_stream_mutex);
+
+    // Backpressure: a window beyond the budget waits for the writer, unless
+    // nothing else is queued
+    while(!m_stream_queue.empty() &&
+          m_stream_queued_size + window->m_size > m_stream_writer_budget) {
+        qemu_cond_wait(&m_stream_cond, &m_stream_mutex);
+    }
+
+    m_stream_queue.push_back(window);
+    m_stream_queued_size += window->m_size;
+    qemu_cond_broadcast(&m_stream_cond);
+
+    qemu_mutex_unlock(&m_stream_mutex);
+}
+
+void *RuntimeEnv::streamWriterThread(void *opaque)
+{
+    RuntimeEnv *rt = (RuntimeEnv *)opaque;
+
+    qemu_mutex_lock(&rt->m_stream_mutex);
+    for(;;) {
+        while(rt->m_stream_queue.empty() && !rt->m_stream_writer_stop)
+            qemu_cond_wait(&rt->m_stream_cond, &rt->m_stream_mutex);
+
+        if(rt->m_stream_queue.empty())
+            break;
+
+        // Stays queued while being written, so that it counts against the budget
+        StreamedWindow *window = rt->m_stream_queue.front();
+        qemu_mutex_unlock(&rt->m_stream_mutex);
+
+        if(!rt->m_stream_error) {
+            try {
+                rt->writeStreamedWindow(*window);
+            }
+            catch(std::exception& e) {
+                std::cerr << "[CRETE Exception] " << e.what() << std::endl;
+                rt->m_stream_error = boost::current_exception();
+            }
+        }
+
+        qemu_mutex_lock(&rt->m_stream_mutex);
+        rt->m_stream_queue.pop_front();
+        rt->m_stream_queued_size -= window->m_size;
+        delete window;
+        qemu_cond_broadcast(&rt->m_stream_cond);
+    }
+    qemu_mutex_unlock(&rt->m_stream_mutex);
+
+    return NULL;
+}
+
 void RuntimeEnv::printInfo()
 {
 #if defined(CRETE_DEBUG) || defined(CRETE_DBG_CALL_STACK)
@@ -582,12 +1112,17 @@ void RuntimeEnv::verifyDumpData() const
     assert(m_debug_cpuStateSyncTables.size() == (rt_dump_tb_count - m_streamed_tb_count) &&
                "Something wrong in m_cpuStateSyncTables dump, its size should be equal to rt_dump_tb_count all the time.\n");
 
-    assert(m_memoSyncTables.size() == (rt_dump_tb_count) &&
+    assert(m_memoSyncTables.get_tb_count() == (rt_dump_tb_count) &&
                 "Something wrong in m_memoSyncTables dump, its size should be equal to rt_dump_tb_count all the time.\n");
 
     assert(m_interruptStates.size() == (rt_dump_tb_count) &&
     		"Something wrong in m_interruptStates dump, its size should be equal to (rt_dump_tb_count - 1) all the time.\n");
 
+#if defined(CRETE_TB_SLICING)
+    assert(m_tbPostSyncTables.size() == (rt_dump_tb_count - m_streamed_tb_count) &&
+            "Something wrong in m_tbPostSyncTables dump, its size should be equal to rt_dump_tb_count all the time.\n");
+#endif
+
 #if defined(CRETE_DBG_MEM_MONI)
     assert(m_debug_memoSyncTables.size() == (rt_dump_tb_count) &&
             "Something wrong in m_debug_memoSyncTables dump, its size should be equal to rt_dump_tb_count all the time.\n");
@@ -660,42 +1195,43 @@ void RuntimeEnv::dump_tloTbPc(const uint64_t pc)
 
 void RuntimeEnv::dump_tloTcgCtx(const TCGContext &tcg_ctx)
 {
-	m_tcg_llvm_offline_ctx.dump_tcg_ctx(tcg_ctx);
+	m_tcg_llvm_offline_ctx.dump_tcg_tb_ir(tcg_ctx);
 }
 
 void RuntimeEnv::dump_tloHelpers(const TCGContext &tcg_ctx)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_HELPER_NAMES);
+
 	m_tcg_llvm_offline_ctx.dump_tcg_helper_name(tcg_ctx);
 
 	m_debug_helper_names = m_tcg_llvm_offline_ctx.get_helper_names();
 }
 
-void RuntimeEnv::dump_tcg_temp(const vector<TCGTemp> &tcg_temp)
-{
-	m_tcg_llvm_offline_ctx.dump_tcg_temp(tcg_temp);
-}
-
 void RuntimeEnv::dump_tloTbInstCount(const uint64_t inst_count)
 {
 	m_tcg_llvm_offline_ctx.dump_tlo_tb_inst_count(inst_count);
 }
 
-void RuntimeEnv::writeTcgLlvmCtx()
+// The IR of a window is the entry streamed_index of chunk_tb_irs
+void RuntimeEnv::writeTcgLlvmCtx(const TCGLLVMOfflineContext& tcg_llvm_offline_ctx,
+        uint64_t streamed_index)
 {
-    stringstream ss;
-    ss << "dump_tcg_llvm_offline." << m_streamed_index << ".bin";
-    ofstream ofs(getOutputFilename(ss.str()).c_str(), ios_base::binary);
+    ostringstream oss(ios_base::out | ios_base::binary);
+    {
+        boost::archive::binary_oarchive oa(oss);
+        oa << tcg_llvm_offline_ctx;
+    }
+    const string archive = oss.str();
 
-    assert(ofs.good());
-	try {
-        boost::archive::binary_oarchive oa(ofs);
-	    oa << m_tcg_llvm_offline_ctx;
-	}
-	catch(std::exception &e){
-	    cerr << e.what() << endl;
-	}
+    crete::trace::ChunkBuilder chunk(crete::trace::chunk_tb_irs, streamed_index);
+    chunk.begin_tb();
+
+    crete::trace::TBIRHeader header;
+    header.size = archive.size();
+    chunk.append(header);
+    chunk.append(archive.data(), archive.size());
 
-    m_tcg_llvm_offline_ctx = TCGLLVMOfflineContext();
+    m_trace_writer.write_chunk(chunk);
 }
 
 string RuntimeEnv::getOutputFilename(const string &fileName) const
@@ -754,9 +1290,11 @@ void RuntimeEnv::writeConcolics()
 
 void RuntimeEnv::setCPUStatePostInterest(const void *src)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_CPU_STATE);
+
     assert(src);
     memcpy(m_cpuState_post_insterest.second, src,
-            sizeof(CPUArchState));
+            m_cpuState_traced_size);
 }
 
 void RuntimeEnv::setFlagCPUStatePostInterest()
@@ -769,9 +1307,13 @@ void RuntimeEnv::setFlagCPUStatePostInterest()
 
 void RuntimeEnv::setCPUStatePreInterest(const void *src)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_CPU_STATE);
+
     assert(src);
+    // The whole CPUState is only needed by the first interested TB, as the initial
+    // CPUState (see addInitialCpuState())
     memcpy(m_cpuState_pre_interest.second, src,
-            sizeof(CPUArchState));
+            (rt_dump_tb_count == 0) ? sizeof(CPUArchState) : m_cpuState_traced_size);
     m_cpuState_pre_interest.first = true;
 }
 
@@ -782,39 +1324,7 @@ void RuntimeEnv::resetCPUStatePreInterest()
 
 void RuntimeEnv::writeMemoSyncTables()
 {
-    ofstream o_sm(getOutputFilename("dump_new_sync_memos.bin").c_str(),
-                ios_base::binary);
-    assert(o_sm && "Create file failed: dump_new_sync_memos.bin\n");
-
-    // boost::unordered_map is not supported by boost::serialization
-    // Covert boost::unordered_map to vector< pair<> >
-    vector<vector<pair<uint64_t, uint8_t> > > to_serialize;
-    to_serialize.reserve(m_memoSyncTables.size());
-
-    for(memoSyncTables_ty::const_iterator it = m_memoSyncTables.begin();
-            it != m_memoSyncTables.end(); ++it) {
-        vector<pair<uint64_t, uint8_t> > temp_memSyncTable;
-        temp_memSyncTable.reserve(it->size());
-
-        for(memoSyncTable_ty::const_iterator in_it = it->begin();
-                in_it != it->end(); ++in_it) {
-            temp_memSyncTable.push_back(*in_it);
-        }
-
-        assert(temp_memSyncTable.size() == it->size());
-        to_serialize.push_back(temp_memSyncTable);
-    }
-
-    assert(to_serialize.size() == m_memoSyncTables.size());
-
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << to_serialize;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
-    }
-
+    m_memoSyncTables.write(m_trace_writer);
     m_memoSyncTables.clear();
 }
 
@@ -893,21 +1403,11 @@ void RuntimeEnv::debug_writeMemoSyncTables()
         if(m_debug_memoMergePoints[i] == OutofInterestTb ||
                 m_debug_memoMergePoints[i] == NormalTb) {
             assert(m_debug_memoSyncTables[i].empty() && "Something is wrong in debug_mergeMemoSyncTables().\n");
-            assert(m_memoSyncTables[i].empty());
+            assert(m_memoSyncTables.is_table_empty(i));
         }
     }
 
-    ofstream o_sm(getOutputFilename("dump_sync_memos.bin").c_str(),
-                ios_base::binary);
-    assert(o_sm && "Create file failed: dump_sync_memos.bin\n");
-
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << m_debug_memoSyncTables;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
-    }
+    crete_write_archive(getOutputFilename("dump_sync_memos.bin"), m_debug_memoSyncTables);
 
 #if defined(CRETE_DBG_TA)
     print_memoSyncTables();
@@ -1049,7 +1549,7 @@ void RuntimeEnv::print_memoSyncTables()
     cerr << "[memoSyncTables:]\n";
     for(uint64_t temp_tb_count = 0; temp_tb_count < m_debug_memoSyncTables.size();
             ++temp_tb_count){
-        if(m_memoSyncTables[temp_tb_count].empty()){
+        if(m_memoSyncTables.is_table_empty(temp_tb_count)){
             assert(m_debug_memoSyncTables[temp_tb_count].empty());
             cerr << "===================================================================\n";
             cerr << "tb_count: " << dec << temp_tb_count<< ": NULL\n";
@@ -1060,10 +1560,13 @@ void RuntimeEnv::print_memoSyncTables()
             cerr << "tb_count: " << dec << temp_tb_count << endl;
             cerr << "===================================================================\n";
 
-            cerr << "memoSyncTables size = " << m_memoSyncTables[temp_tb_count].size() << "\n";
-            for(memoSyncTable_ty::iterator m_it = m_memoSyncTables[temp_tb_count].begin();
-                    m_it != m_memoSyncTables[temp_tb_count].end(); ++m_it){
-                cerr << hex << "0x" << m_it->first << ": (0x " << (uint64_t)m_it->second  << "); ";
+            pair<const crete::trace::MemoLoadRecord *, const crete::trace::MemoLoadRecord *>
+                    table = m_memoSyncTables.get_table(temp_tb_count);
+            cerr << "memoSyncTables size = " << (table.second - table.first) << "\n";
+            for(const crete::trace::MemoLoadRecord *m_it = table.first;
+                    m_it != table.second; ++m_it){
+                cerr << hex << "0x" << m_it->addr << ": (" << dec << m_it->size
+                        << ", 0x" << hex << m_it->value  << "); ";
             }
 
             cerr << "---------------------------------------------------------------------\n"
@@ -1089,40 +1592,35 @@ void RuntimeEnv::writeInitialCpuState()
 {
     assert(m_initial_CpuState.size() == sizeof(CPUArchState));
 
-    ofstream o_sm(getOutputFilename("dump_initial_cpuState.bin").c_str(),
-                ios_base::binary);
-    assert(o_sm && "Create file failed: dump_initial_cpuState.bin\n");
+    string path = getOutputFilename("dump_initial_cpuState.bin");
+    ofstream o_sm(path.c_str(), ios_base::binary);
+    if(!o_sm.good())
+        throw runtime_error("can't open file: " + path);
+
     o_sm.write((const char*)m_initial_CpuState.data(), sizeof(CPUArchState));
-    o_sm.clear();
+    o_sm.flush();
+    if(!o_sm.good())
+        throw runtime_error("failed to write file: " + path);
 
     m_initial_CpuState.clear();
 }
 
 void RuntimeEnv::writeDebugCpuStateOffsets()
 {
-    ofstream o_sm(getOutputFilename("dump_debug_cpuState_offsets.bin").c_str(),
-                ios_base::binary);
-    assert(o_sm && "Create file failed: dump_debug_cpuState_offsets.bin\n");
-
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << m_debug_cpuState_offsets;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
-    }
+    crete_write_archive(getOutputFilename("dump_debug_cpuState_offsets.bin"),
+            m_debug_cpuState_offsets);
 
     m_debug_cpuState_offsets.clear();
 }
 
 
-void RuntimeEnv::checkEmptyCPUStateSyncTables()
+void RuntimeEnv::checkEmptyCPUStateSyncTables(vector<cpuStateSyncTable_ty>& cpuStateSyncTables)
 {
     uint64_t tb_count = 0;
-    for(vector<cpuStateSyncTable_ty>::iterator it = m_cpuStateSyncTables.begin();
-            it != m_cpuStateSyncTables.end(); ++it) {
-        if(it->first && it->second.empty()) {
-            it->first = false;
+    for(vector<cpuStateSyncTable_ty>::iterator it = cpuStateSyncTables.begin();
+            it != cpuStateSyncTables.end(); ++it) {
+        if(it->m_valid && it->m_elements.empty()) {
+            it->m_valid = false;
 
 #if defined(CRETE_DBG_CK)
             fprintf(stderr, "CPUState is not changed between tb-%lu, and tb-%lu\n",
@@ -1134,44 +1632,48 @@ void RuntimeEnv::checkEmptyCPUStateSyncTables()
     }
 }
 
-void RuntimeEnv::writeCPUStateSyncTables()
+void RuntimeEnv::writeCPUStateSyncTables(vector<cpuStateSyncTable_ty>& cpuStateSyncTables,
+        uint64_t first_tb, crete::trace::ChunkType type)
 {
-    checkEmptyCPUStateSyncTables();
+    checkEmptyCPUStateSyncTables(cpuStateSyncTables);
 
-    stringstream ss;
-    ss << "dump_sync_cpu_states." << m_streamed_index << ".bin";
-    ofstream o_sm(getOutputFilename(ss.str()).c_str(), ios_base::binary);
+    crete::trace::ChunkBuilder chunk(type, first_tb);
 
-    assert(o_sm.good() && "Create file failed: dump_sync_cpu_states.bin\n");
+    for(vector<cpuStateSyncTable_ty>::const_iterator it = cpuStateSyncTables.begin();
+            it != cpuStateSyncTables.end(); ++it) {
+        chunk.begin_tb();
 
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << m_cpuStateSyncTables;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
+        crete::trace::CPUSyncTableHeader header;
+        header.valid = it->m_valid;
+        header.element_count = it->m_elements.size();
+        chunk.append(header);
+
+        for(vector<CPUStateSideEffect>::const_iterator e_it = it->m_elements.begin();
+                e_it != it->m_elements.end(); ++e_it) {
+            crete::trace::CPUSyncRecord record;
+            record.field_id = e_it->m_field_id;
+            record.offset = e_it->m_offset;
+            record.size = e_it->m_size;
+            record.data_offset = e_it->m_data_offset;
+            chunk.append(record);
+        }
+
+        chunk.append(it->m_data.data(), it->m_data.size());
     }
 
-    m_cpuStateSyncTables.clear();
+    m_trace_writer.write_chunk(chunk);
 }
 
-void RuntimeEnv::writeDebugCPUStateSyncTables()
+void RuntimeEnv::writeDebugCPUStateSyncTables(
+        const vector<debug_cpuStateSyncTable_ty>& debug_cpuStateSyncTables,
+        uint64_t streamed_index)
 {
     stringstream ss;
-    ss << "dump_debug_sync_cpu_states." << m_streamed_index << ".bin";
-    ofstream o_sm(getOutputFilename(ss.str()).c_str(), ios_base::binary);
-
-    assert(o_sm && "Create file failed: dump_debug_sync_cpu_states.bin\n");
+    ss << "dump_debug_sync_cpu_states." << streamed_index << ".bin";
+    string path = getOutputFilename(ss.str());
 
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << m_debug_cpuStateSyncTables;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
-    }
-
-    m_debug_cpuStateSyncTables.clear();
+    crete_write_archive(path, debug_cpuStateSyncTables);
+    crete::trace::sync_file(path);
 }
 
 // Check whether the given entry (addr, size) overlaps with existing entries in target_memoSyncTable
@@ -1239,21 +1741,28 @@ vector<uint64_t> RuntimeEnv::overlapsMemoSyncEntry(uint64_t addr, uint32_t size,
     return ret_addrs;
 }
 
-void RuntimeEnv::writeInterruptStates() const
+void RuntimeEnv::writeInterruptStates()
 {
     assert(m_interruptStates.size() == rt_dump_tb_count);
 
-    ofstream o_sm(getOutputFilename("dump_qemu_interrupt_info.bin").c_str(),
-            ios_base::binary);
-    assert(o_sm && "Create file failed: dump_qemu_interrupt_info.bin\n");
+    crete::trace::ChunkBuilder chunk(crete::trace::chunk_interrupt_states, 0);
 
-    try {
-        boost::archive::binary_oarchive oa(o_sm);
-        oa << m_interruptStates;
-    }
-    catch(std::exception &e){
-        cerr << e.what() << endl;
+    for(vector<interruptState_ty>::const_iterator it = m_interruptStates.begin();
+            it != m_interruptStates.end(); ++it) {
+        chunk.begin_tb();
+
+        if(!it->second)
+            continue;
+
+        crete::trace::InterruptRecord record;
+        record.intno = it->first.m_intno;
+        record.is_int = it->first.m_is_int;
+        record.error_code = it->first.m_error_code;
+        record.next_eip_addend = it->first.m_next_eip_addend;
+        chunk.append(record);
     }
+
+    m_trace_writer.write_chunk(chunk);
 }
 
 void RuntimeEnv::addTBGraphExecSequ(uint64_t tb_pc)
@@ -1261,22 +1770,32 @@ void RuntimeEnv::addTBGraphExecSequ(uint64_t tb_pc)
     m_tbGraphExecSequ.push_back(tb_pc);
 }
 
+void RuntimeEnv::writeCaptureProfile()
+{
+    vector<pair<string, uint64_t> > stats;
+    stats.push_back(make_pair("interested_tbs", rt_dump_tb_count));
+    stats.push_back(make_pair("captured_tb_irs", nb_captured_llvm_tb));
+    stats.push_back(make_pair("streamed_windows", m_streamed_index));
+
+    uint64_t tbs_plain_tci, tbs_instrumented_tci;
+    crete_tci_get_tb_exec_counts(&tbs_plain_tci, &tbs_instrumented_tci);
+    stats.push_back(make_pair("tbs_plain_tci", tbs_plain_tci));
+    stats.push_back(make_pair("tbs_instrumented_tci", tbs_instrumented_tci));
+
+    crete_profile_write(getOutputFilename("capture_profile.json"),
+            m_debug_helper_names, stats);
+}
+
 void RuntimeEnv::writeTBGraphExecSequ()
 {
-    string path = getOutputFilename("tb-seq.bin");
-    ofstream ofs(path.c_str(), ios_base::out | ios_base::binary);
-    if(!ofs.good())
-        throw runtime_error("can't open file: " + path);
+    vector<uint64_t> boundaries(m_tbGraphExecSequ.size());
+    for(uint64_t i = 0; i < boundaries.size(); ++i)
+        boundaries[i] = i * sizeof(uint64_t);
 
-    for(vector<uint64_t>::iterator iter = m_tbGraphExecSequ.begin();
-        iter != m_tbGraphExecSequ.end();
-        ++iter)
-    {
-        ofs.write(reinterpret_cast<const char*>(&*iter),
-                  sizeof(uint64_t));
-    }
+    m_trace_writer.write_chunk(crete::trace::chunk_tb_exec_sequence, 0, boundaries,
+            m_tbGraphExecSequ.data(), m_tbGraphExecSequ.size() * sizeof(uint64_t));
 
-    path = getOutputFilename("tb-seq.txt");
+    string path = getOutputFilename("tb-seq.txt");
     ofstream ofs_txt(path.c_str(), ios_base::out);
     if(!ofs_txt.good())
         throw runtime_error("can't open file: " + path);
@@ -1366,6 +1885,8 @@ void crete_runtime_dump_initialize()
 
     runtime_env = new RuntimeEnv;
 
+    crete_profile_reset();
+
     assert(runtime_env && g_crete_flags);
 
 #if defined(CRETE_CROSS_CHECK)
@@ -1388,6 +1909,8 @@ void crete_runtime_dump_close()
 
 void crete_pre_cpu_tb_exec(void *qemuCpuState, TranslationBlock *tb)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_PRE_TB);
+
     crete_pre_post_flag = true;
 
     CPUArchState *env = (CPUArchState *)qemuCpuState;
@@ -1417,8 +1940,8 @@ void crete_pre_cpu_tb_exec(void *qemuCpuState, TranslationBlock *tb)
     is_target_pid = (env->cr[3] == g_crete_target_pid);
     is_user_code = (tb->pc < USER_CODE_RANGE);
 
-//    bool is_in_include_filter = crete_is_pc_in_include_filter_range(tb->pc);
-    bool is_in_exclude_filter = crete_is_pc_in_exclude_filter_range(tb->pc);
+//    bool is_in_include_filter = crete_is_tb_in_include_filter_range(tb);
+    bool is_in_exclude_filter = crete_is_tb_in_exclude_filter_range(tb);
 
     // 2. set flag of filter TB based on above flags (taint analysis)
     int is_interested_tb =
@@ -1480,6 +2003,9 @@ void crete_pre_cpu_tb_exec(void *qemuCpuState, TranslationBlock *tb)
     if(flag_rt_dump_enable) {
         //3. keep a copy of the cpuState before the execution of a potential insterested tb
         runtime_env->setCPUStatePreInterest((void *)env);
+#if defined(CRETE_TB_SLICING)
+        runtime_env->setTBEntryTaint();
+#endif
 
         //4. MemosyncTable
 #if defined(CRETE_DBG_MEM_MONI)
@@ -1503,6 +2029,8 @@ void crete_pre_cpu_tb_exec(void *qemuCpuState, TranslationBlock *tb)
 int crete_post_cpu_tb_exec(void *qemuCpuState, TranslationBlock *input_tb, uint64_t next_tb,
         uint64_t crete_interrupted_pc)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_POST_TB);
+
     assert(crete_pre_post_flag);
     crete_pre_post_flag = false;
 
@@ -1582,6 +2110,11 @@ int crete_post_cpu_tb_exec(void *qemuCpuState, TranslationBlock *input_tb, uint6
         // 2.3 dump the current CPUState for cross checking on klee side
         runtime_env->addDebugCpuStateSyncTable(qemuCpuState);
 
+#if defined(CRETE_TB_SLICING)
+        // 2.4 concrete globals written by the current TB
+        runtime_env->addTBPostSyncTable(qemuCpuState, tb.index_captured_llvm_tb);
+#endif
+
         // 3. Memory Monitoring
         if(flag_interested_tb_prev == 0){
             runtime_env->addCurrentMemoSyncTable();
@@ -1676,6 +2209,8 @@ void add_qemu_interrupt_state(struct RuntimeEnv *rt,
 
 void dump_memo_sync_table_entry(struct RuntimeEnv *rt, uint64_t addr, uint32_t size, uint64_t value)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_MEMO_SYNC);
+
 #if defined(CRETE_DBG_MEM_MONI)
     rt->addMemoSyncTableEntry(addr, size, value);
 #endif
@@ -1695,43 +2230,27 @@ int crete_flags_is_true(struct CreteFlags *cf)
 	return cf->is_true();
 }
 
-#define __CRETE_CALC_CPU_SIDE_EFFECT(in_type, in_name)                              \
-        if(memcmp(&reference->in_name, &target->in_name, sizeof(in_type)) != 0)     \
-        {                                                                           \
-            offset = CPU_OFFSET(in_name);                                           \
-            size   = sizeof(in_type);                                               \
-            name.str(string());                                                     \
-            name << #in_name;                                                       \
-            data.clear();                                                           \
-                                                                                    \
-            for(uint64_t j=0; j < size; ++j) {                                      \
-                data.push_back(*(uint8_t *)(((uint8_t *)target)                     \
-                        + offset + j));                                             \
-            }                                                                       \
-                                                                                    \
-            ret.push_back(CPUStateElement(offset, size, name.str(), data));         \
-        }
+// A CPUState field being traced for side-effects, whose index within
+// x86_cpuState_fields() is used as its field id
+struct CPUStateField {
+    uint32_t m_offset;
+    uint32_t m_size;
+    const char *m_name;
+    int32_t m_array_index; // -1 if the field is not an element of an array
 
+    CPUStateField(uint32_t offset, uint32_t size, const char *name, int32_t array_index)
+    :m_offset(offset), m_size(size), m_name(name), m_array_index(array_index) {}
+};
 
-#define __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(in_type, in_name, array_size)            \
+#define __CRETE_ADD_CPU_FIELD(in_type, in_name)                                     \
+        fields.push_back(CPUStateField(CPU_OFFSET(in_name), sizeof(in_type),        \
+                #in_name, -1));
+
+#define __CRETE_ADD_CPU_FIELD_ARRAY(in_type, in_name, array_size)                   \
         for(uint64_t i = 0; i < (array_size); ++i)                                  \
         {                                                                           \
-            if(memcmp(&reference->in_name[i], &target->in_name[i],                  \
-                    sizeof(in_type)) != 0)                                          \
-            {                                                                       \
-                offset = CPU_OFFSET(in_name) + i*sizeof(in_type);                   \
-                size   = sizeof(in_type);                                           \
-                name.str(string());                                                 \
-                name << #in_name << "[" << dec << i << "]";                         \
-                data.clear();                                                       \
-                                                                                    \
-                for(uint64_t j=0; j < size; ++j) {                                  \
-                    data.push_back(*(uint8_t *)(((uint8_t *)target)                 \
-                            + offset + j));                                         \
-                }                                                                   \
-                                                                                    \
-                ret.push_back(CPUStateElement(offset, size, name.str(), data));     \
-            }                                                                       \
+            fields.push_back(CPUStateField(CPU_OFFSET(in_name) + i*sizeof(in_type), \
+                    sizeof(in_type), #in_name, i));                                 \
         }
 
 // List of CPUState being ignored by cpuStateSyncTable
@@ -1745,213 +2264,204 @@ int crete_flags_is_true(struct CreteFlags *cf)
 // int old_exception;                 Irrelevant + cannot trace
 // CPU_COMMON and all below           Irrelevant
 
-// Compare two cpu states, return the different elements of target cpu state
-static vector<CPUStateElement> x86_cpuState_compuate_side_effect(const CPUArchState *reference,
-        const CPUArchState *target) {
-    vector<CPUStateElement> ret;
-    ret.clear();
-
-    uint64_t offset;
-    uint64_t size;
-    stringstream name;
-    vector<uint8_t> data;
-
+// Fill fields with all the CPUState fields being traced for side-effects
+static void x86_cpuState_init_fields(vector<CPUStateField> &fields) {
     /* standard registers */
     // target_ulong regs[CPU_NB_REGS];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(target_ulong, regs, CPU_NB_REGS)
+    __CRETE_ADD_CPU_FIELD_ARRAY(target_ulong, regs, CPU_NB_REGS)
 
 //xxx: not traced
 // target_ulong eip;
 
    // target_ulong eflags;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, eflags)
+    __CRETE_ADD_CPU_FIELD(target_ulong, eflags)
 
     /* emulator internal eflags handling */
     // target_ulong cc_dst;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, cc_dst)
+    __CRETE_ADD_CPU_FIELD(target_ulong, cc_dst)
     // target_ulong cc_src;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, cc_src)
+    __CRETE_ADD_CPU_FIELD(target_ulong, cc_src)
     // target_ulong cc_src2;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, cc_src2)
+    __CRETE_ADD_CPU_FIELD(target_ulong, cc_src2)
     //uint32_t cc_op;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, cc_op);
+    __CRETE_ADD_CPU_FIELD(uint32_t, cc_op);
 
     // int32_t df;
-    __CRETE_CALC_CPU_SIDE_EFFECT(int32_t, df)
+    __CRETE_ADD_CPU_FIELD(int32_t, df)
     // uint32_t hflags;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, hflags)
+    __CRETE_ADD_CPU_FIELD(uint32_t, hflags)
     // uint32_t hflags2;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, hflags2)
+    __CRETE_ADD_CPU_FIELD(uint32_t, hflags2)
 
     /* segments */
     // SegmentCache segs[6];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(SegmentCache, segs, 6)
+    __CRETE_ADD_CPU_FIELD_ARRAY(SegmentCache, segs, 6)
     // SegmentCache ldt;
-    __CRETE_CALC_CPU_SIDE_EFFECT(SegmentCache, ldt)
+    __CRETE_ADD_CPU_FIELD(SegmentCache, ldt)
     // SegmentCache tr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(SegmentCache, tr)
+    __CRETE_ADD_CPU_FIELD(SegmentCache, tr)
     // SegmentCache gdt;
-    __CRETE_CALC_CPU_SIDE_EFFECT(SegmentCache, gdt)
+    __CRETE_ADD_CPU_FIELD(SegmentCache, gdt)
     // SegmentCache idt;
-    __CRETE_CALC_CPU_SIDE_EFFECT(SegmentCache, idt)
+    __CRETE_ADD_CPU_FIELD(SegmentCache, idt)
 
 // xxx: not traced
 // target_ulong cr[5];
-//    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(target_ulong, cr, 5)
+//    __CRETE_ADD_CPU_FIELD_ARRAY(target_ulong, cr, 5)
 
     // int32_t a20_mask;
-    __CRETE_CALC_CPU_SIDE_EFFECT(int32_t, a20_mask)
+    __CRETE_ADD_CPU_FIELD(int32_t, a20_mask)
 
     // BNDReg bnd_regs[4];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(BNDReg, bnd_regs, 4)
+    __CRETE_ADD_CPU_FIELD_ARRAY(BNDReg, bnd_regs, 4)
     // BNDCSReg bndcs_regs;
-    __CRETE_CALC_CPU_SIDE_EFFECT(BNDCSReg, bndcs_regs)
+    __CRETE_ADD_CPU_FIELD(BNDCSReg, bndcs_regs)
     // uint64_t msr_bndcfgs;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_bndcfgs)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_bndcfgs)
 
     /* Beginning of state preserved by INIT (dummy marker).  */
 //xxx: not traced
 //    struct {} start_init_save;
-//    __CRETE_CALC_CPU_SIDE_EFFECT(struct {}, start_init_save)
+//    __CRETE_ADD_CPU_FIELD(struct {}, start_init_save)
 
     /* FPU state */
     // unsigned int fpstt;
-    __CRETE_CALC_CPU_SIDE_EFFECT(unsigned int, fpstt)
+    __CRETE_ADD_CPU_FIELD(unsigned int, fpstt)
     // uint16_t fpus;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, fpus)
+    __CRETE_ADD_CPU_FIELD(uint16_t, fpus)
     // uint16_t fpuc;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, fpuc)
+    __CRETE_ADD_CPU_FIELD(uint16_t, fpuc)
     // uint8_t fptags[8];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(uint8_t, fptags, 8)
+    __CRETE_ADD_CPU_FIELD_ARRAY(uint8_t, fptags, 8)
     // FPReg fpregs[8];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(FPReg, fpregs, 8)
+    __CRETE_ADD_CPU_FIELD_ARRAY(FPReg, fpregs, 8)
     /* KVM-only so far */
     // uint16_t fpop;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, fpop)
+    __CRETE_ADD_CPU_FIELD(uint16_t, fpop)
     // uint64_t fpip;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, fpip)
+    __CRETE_ADD_CPU_FIELD(uint64_t, fpip)
     // uint64_t fpdp;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, fpdp)
+    __CRETE_ADD_CPU_FIELD(uint64_t, fpdp)
 
     /* emulator internal variables */
     // float_status fp_status;
-    __CRETE_CALC_CPU_SIDE_EFFECT(float_status, fp_status)
+    __CRETE_ADD_CPU_FIELD(float_status, fp_status)
     // floatx80 ft0;
-    __CRETE_CALC_CPU_SIDE_EFFECT(floatx80, ft0)
+    __CRETE_ADD_CPU_FIELD(floatx80, ft0)
 
     // float_status mmx_status;
-    __CRETE_CALC_CPU_SIDE_EFFECT(float_status, mmx_status)
+    __CRETE_ADD_CPU_FIELD(float_status, mmx_status)
     // float_status sse_status;
-    __CRETE_CALC_CPU_SIDE_EFFECT(float_status, sse_status)
+    __CRETE_ADD_CPU_FIELD(float_status, sse_status)
     // uint32_t mxcsr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, mxcsr)
+    __CRETE_ADD_CPU_FIELD(uint32_t, mxcsr)
     // XMMReg xmm_regs[CPU_NB_REGS == 8 ? 8 : 32];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(XMMReg, xmm_regs, CPU_NB_REGS == 8 ? 8 : 32)
+    __CRETE_ADD_CPU_FIELD_ARRAY(XMMReg, xmm_regs, CPU_NB_REGS == 8 ? 8 : 32)
     // XMMReg xmm_t0;
-    __CRETE_CALC_CPU_SIDE_EFFECT(XMMReg, xmm_t0)
+    __CRETE_ADD_CPU_FIELD(XMMReg, xmm_t0)
     // MMXReg mmx_t0;
-    __CRETE_CALC_CPU_SIDE_EFFECT(MMXReg, mmx_t0)
+    __CRETE_ADD_CPU_FIELD(MMXReg, mmx_t0)
 
     // uint64_t opmask_regs[NB_OPMASK_REGS];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(uint64_t, opmask_regs, NB_OPMASK_REGS)
+    __CRETE_ADD_CPU_FIELD_ARRAY(uint64_t, opmask_regs, NB_OPMASK_REGS)
 
     /* sysenter registers */
     // uint32_t sysenter_cs;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, sysenter_cs)
+    __CRETE_ADD_CPU_FIELD(uint32_t, sysenter_cs)
     // target_ulong sysenter_esp;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, sysenter_esp)
+    __CRETE_ADD_CPU_FIELD(target_ulong, sysenter_esp)
     // target_ulong sysenter_eip;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, sysenter_eip)
+    __CRETE_ADD_CPU_FIELD(target_ulong, sysenter_eip)
     // uint64_t efer;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, efer)
+    __CRETE_ADD_CPU_FIELD(uint64_t, efer)
     // uint64_t star;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, star)
+    __CRETE_ADD_CPU_FIELD(uint64_t, star)
 
     // uint64_t vm_hsave;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, vm_hsave)
+    __CRETE_ADD_CPU_FIELD(uint64_t, vm_hsave)
 
 #ifdef TARGET_X86_64
     // target_ulong lstar;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, lstar)
+    __CRETE_ADD_CPU_FIELD(target_ulong, lstar)
     // target_ulong cstar;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, cstar)
+    __CRETE_ADD_CPU_FIELD(target_ulong, cstar)
     // target_ulong fmask;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, fmask)
+    __CRETE_ADD_CPU_FIELD(target_ulong, fmask)
     // target_ulong kernelgsbase;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, kernelgsbase)
+    __CRETE_ADD_CPU_FIELD(target_ulong, kernelgsbase)
 #endif
 
     // uint64_t tsc;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, tsc)
+    __CRETE_ADD_CPU_FIELD(uint64_t, tsc)
     // uint64_t tsc_adjust;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, tsc_adjust)
+    __CRETE_ADD_CPU_FIELD(uint64_t, tsc_adjust)
     // uint64_t tsc_deadline;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, tsc_deadline)
+    __CRETE_ADD_CPU_FIELD(uint64_t, tsc_deadline)
 
     // uint64_t mcg_status;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, mcg_status)
+    __CRETE_ADD_CPU_FIELD(uint64_t, mcg_status)
     // uint64_t msr_ia32_misc_enable;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_ia32_misc_enable)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_ia32_misc_enable)
     // uint64_t msr_ia32_feature_control;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_ia32_feature_control)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_ia32_feature_control)
 
     // uint64_t msr_fixed_ctr_ctrl;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_fixed_ctr_ctrl)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_fixed_ctr_ctrl)
     // uint64_t msr_global_ctrl;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_global_ctrl)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_global_ctrl)
     // uint64_t msr_global_status;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_global_status)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_global_status)
     // uint64_t msr_global_ovf_ctrl;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_global_ovf_ctrl)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_global_ovf_ctrl)
     // uint64_t msr_fixed_counters[MAX_FIXED_COUNTERS];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(uint64_t, msr_fixed_counters, MAX_FIXED_COUNTERS)
+    __CRETE_ADD_CPU_FIELD_ARRAY(uint64_t, msr_fixed_counters, MAX_FIXED_COUNTERS)
     // uint64_t msr_gp_counters[MAX_GP_COUNTERS];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(uint64_t, msr_gp_counters, MAX_GP_COUNTERS)
+    __CRETE_ADD_CPU_FIELD_ARRAY(uint64_t, msr_gp_counters, MAX_GP_COUNTERS)
     // uint64_t msr_gp_evtsel[MAX_GP_COUNTERS];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(uint64_t, msr_gp_evtsel, MAX_GP_COUNTERS)
+    __CRETE_ADD_CPU_FIELD_ARRAY(uint64_t, msr_gp_evtsel, MAX_GP_COUNTERS)
 
     // uint64_t pat;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, pat)
+    __CRETE_ADD_CPU_FIELD(uint64_t, pat)
     // uint32_t smbase;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, smbase)
+    __CRETE_ADD_CPU_FIELD(uint32_t, smbase)
 
     /* End of state preserved by INIT (dummy marker).  */
 // xxx: not traced
 //    struct {} end_init_save;
-//    __CRETE_CALC_CPU_SIDE_EFFECT(struct {}, end_init_save)
+//    __CRETE_ADD_CPU_FIELD(struct {}, end_init_save)
 
     // uint64_t system_time_msr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, system_time_msr)
+    __CRETE_ADD_CPU_FIELD(uint64_t, system_time_msr)
     // uint64_t wall_clock_msr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, wall_clock_msr)
+    __CRETE_ADD_CPU_FIELD(uint64_t, wall_clock_msr)
     // uint64_t steal_time_msr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, steal_time_msr)
+    __CRETE_ADD_CPU_FIELD(uint64_t, steal_time_msr)
     // uint64_t async_pf_en_msr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, async_pf_en_msr)
+    __CRETE_ADD_CPU_FIELD(uint64_t, async_pf_en_msr)
     // uint64_t pv_eoi_en_msr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, pv_eoi_en_msr)
+    __CRETE_ADD_CPU_FIELD(uint64_t, pv_eoi_en_msr)
 
     // uint64_t msr_hv_hypercall;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_hv_hypercall)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_hv_hypercall)
     // uint64_t msr_hv_guest_os_id;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_hv_guest_os_id)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_hv_guest_os_id)
     // uint64_t msr_hv_vapic;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_hv_vapic)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_hv_vapic)
     // uint64_t msr_hv_tsc;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, msr_hv_tsc)
+    __CRETE_ADD_CPU_FIELD(uint64_t, msr_hv_tsc)
 
     /* exception/interrupt handling */
 
 // xxx: not traced
 // int error_code;
-//    __CRETE_CALC_CPU_SIDE_EFFECT(int, error_code)
+//    __CRETE_ADD_CPU_FIELD(int, error_code)
 
     // int exception_is_int;
-    __CRETE_CALC_CPU_SIDE_EFFECT(int, exception_is_int)
+    __CRETE_ADD_CPU_FIELD(int, exception_is_int)
     // target_ulong exception_next_eip;
-    __CRETE_CALC_CPU_SIDE_EFFECT(target_ulong, exception_next_eip)
+    __CRETE_ADD_CPU_FIELD(target_ulong, exception_next_eip)
     // target_ulong dr[8];
-    __CRETE_CALC_CPU_SIDE_EFFECT_ARRAY(target_ulong, dr, 8)
+    __CRETE_ADD_CPU_FIELD_ARRAY(target_ulong, dr, 8)
 
 //xxx: not traced
 //    union {
@@ -1960,31 +2470,31 @@ static vector<CPUStateElement> x86_cpuState_compuate_side_effect(const CPUArchSt
 //    };
 
     // int old_exception;
-    __CRETE_CALC_CPU_SIDE_EFFECT(int, old_exception)
+    __CRETE_ADD_CPU_FIELD(int, old_exception)
     // uint64_t vm_vmcb;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, vm_vmcb)
+    __CRETE_ADD_CPU_FIELD(uint64_t, vm_vmcb)
     // uint64_t tsc_offset;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, tsc_offset)
+    __CRETE_ADD_CPU_FIELD(uint64_t, tsc_offset)
     // uint64_t intercept;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint64_t, intercept)
+    __CRETE_ADD_CPU_FIELD(uint64_t, intercept)
     // uint16_t intercept_cr_read;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, intercept_cr_read)
+    __CRETE_ADD_CPU_FIELD(uint16_t, intercept_cr_read)
     // uint16_t intercept_cr_write;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, intercept_cr_write)
+    __CRETE_ADD_CPU_FIELD(uint16_t, intercept_cr_write)
     // uint16_t intercept_dr_read;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, intercept_dr_read)
+    __CRETE_ADD_CPU_FIELD(uint16_t, intercept_dr_read)
     // uint16_t intercept_dr_write;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint16_t, intercept_dr_write)
+    __CRETE_ADD_CPU_FIELD(uint16_t, intercept_dr_write)
     // uint32_t intercept_exceptions;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint32_t, intercept_exceptions)
+    __CRETE_ADD_CPU_FIELD(uint32_t, intercept_exceptions)
     // uint8_t v_tpr;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint8_t, v_tpr)
+    __CRETE_ADD_CPU_FIELD(uint8_t, v_tpr)
 
     /* KVM states, automatically cleared on reset */
     // uint8_t nmi_injected;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint8_t, nmi_injected)
+    __CRETE_ADD_CPU_FIELD(uint8_t, nmi_injected)
     // uint8_t nmi_pending;
-    __CRETE_CALC_CPU_SIDE_EFFECT(uint8_t, nmi_pending)
+    __CRETE_ADD_CPU_FIELD(uint8_t, nmi_pending)
 
 // TODO: xxx not traced
 //    CPU_COMMON
@@ -2032,5 +2542,47 @@ static vector<CPUStateElement> x86_cpuState_compuate_side_effect(const CPUArchSt
     TPRAccess tpr_access_type;
 */
 
-    return ret;
+}
+
+static const vector<CPUStateField>& x86_cpuState_fields()
+{
+    static vector<CPUStateField> fields;
+    if(fields.empty())
+        x86_cpuState_init_fields(fields);
+
+    return fields;
+}
+
+static uint64_t x86_cpuState_traced_size()
+{
+    const vector<CPUStateField> &fields = x86_cpuState_fields();
+
+    uint64_t traced_size = 0;
+    for(vector<CPUStateField>::const_iterator it = fields.begin();
+            it != fields.end(); ++it) {
+        traced_size = std::max(traced_size, (uint64_t)(it->m_offset + it->m_size));
+    }
+
+    assert(traced_size <= sizeof(CPUArchState));
+    return traced_size;
+}
+
+// Compare two cpu states, and append the traced fields of target cpu state which are
+// different from reference to sync_table
+static void x86_cpuState_compuate_side_effect(const uint8_t *reference,
+        const uint8_t *target, CPUStateSyncTable &sync_table)
+{
+    const vector<CPUStateField> &fields = x86_cpuState_fields();
+
+    sync_table.m_valid = true;
+    for(uint32_t field_id = 0; field_id < fields.size(); ++field_id) {
+        const CPUStateField &field = fields[field_id];
+        if(memcmp(reference + field.m_offset, target + field.m_offset, field.m_size) == 0)
+            continue;
+
+        sync_table.m_elements.push_back(CPUStateSideEffect(field_id, field.m_offset,
+                field.m_size, sync_table.m_data.size()));
+        sync_table.m_data.insert(sync_table.m_data.end(), target + field.m_offset,
+                target + field.m_offset + field.m_size);
+    }
 }
@@ -86,9 +86,18 @@ int  crete_flags_is_true(struct CreteFlags *cf);
 #include <iostream>
 #include <fstream>
 
+#include <deque>
+
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/map.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include <crete/trace_file.h>
+
+extern "C" {
+#include "qemu/thread.h"
+}
 
 /***********************************/
 /* External interface for C++ code */
@@ -161,6 +170,59 @@ struct CPUStateElement{
     }
 };
 
+// Compact record of a CPUState field changed by code out of interest, whose bytes are
+// stored in CPUStateSyncTable::m_data, starting from m_data_offset
+struct CPUStateSideEffect {
+    uint32_t m_field_id; // index of the field within the table of traced CPUState fields
+    uint32_t m_offset;
+    uint32_t m_size;
+    uint32_t m_data_offset;
+
+    CPUStateSideEffect(uint32_t field_id, uint32_t offset, uint32_t size, uint32_t data_offset)
+    :m_field_id(field_id), m_offset(offset), m_size(size), m_data_offset(data_offset) {}
+
+    // For serialization
+    CPUStateSideEffect()
+    :m_field_id(0), m_offset(0), m_size(0), m_data_offset(0) {}
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_field_id;
+        ar & m_offset;
+        ar & m_size;
+        ar & m_data_offset;
+    }
+};
+
+struct CPUStateSyncTable {
+    bool m_valid;
+    vector<CPUStateSideEffect> m_elements;
+    vector<uint8_t> m_data;
+
+    CPUStateSyncTable()
+    :m_valid(false) {}
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & m_valid;
+        ar & m_elements;
+        ar & m_data;
+    }
+};
+
+// A memory-based global of tcg_ctx, whose concrete writes by a TB can be applied by
+// the replayer instead of being computed by the TB (see CRETE_TB_SLICING)
+struct TBSliceGlobal {
+    uint32_t m_index; // index within tcg_ctx.temps
+    uint32_t m_offset;
+    uint32_t m_size;
+
+    TBSliceGlobal(uint32_t index, uint32_t offset, uint32_t size)
+    :m_index(index), m_offset(offset), m_size(size) {}
+};
+
 struct QemuInterruptInfo {
     int m_intno;
     int m_is_int;
@@ -185,22 +247,122 @@ struct QemuInterruptInfo {
     }
 };
 
-// <address, value>
-typedef boost::unordered_map<uint64_t, uint8_t> memoSyncTable_ty;
-typedef vector<memoSyncTable_ty> memoSyncTables_ty;
+// Loads captured for memory synchronization, one table per interested TB.
+// Load records of all the tables are appended to one arena in the order of TBs,
+// so that they are written as a trace chunk without being reshaped. Records of
+// the current TB stay at the tail of the arena until the TB is added as a new
+// table, merged into the last added table, or dropped.
+class MemoSyncArena
+{
+public:
+    MemoSyncArena();
+
+    // Record a load of the current TB. Loads of the same (addr, size) within the
+    // current TB are recorded once, with the first value.
+    void add_load(uint64_t addr, uint32_t size, uint64_t value);
+
+    void add_current_table();
+    void merge_current_table();
+    void clear_current_table();
+
+    uint64_t get_tb_count() const { return m_table_sizes.size(); }
+    bool is_table_empty(uint64_t tb_index) const { return m_table_sizes[tb_index] == 0; }
+    // [first, last) records of tb_index
+    pair<const crete::trace::MemoLoadRecord *, const crete::trace::MemoLoadRecord *>
+    get_table(uint64_t tb_index) const;
+
+    void write(crete::trace::TraceWriter& writer) const;
+    void clear();
+
+private:
+    bool is_recorded(uint64_t addr, uint32_t size);
+    void reset_dedup() { m_dedup_seq_begin = m_dedup_seq_next; }
+
+private:
+    static const uint64_t dedup_slot_count = 1024; // power of 2
+
+    vector<crete::trace::MemoLoadRecord> m_records;
+    // Number of records of each table
+    vector<uint64_t> m_table_sizes;
+    // The last table added by add_current_table(), which merge_current_table() merges into
+    uint64_t m_merge_point;
+    // First record of the current TB
+    uint64_t m_current_begin;
+
+    // Open-addressing set of the records of the current TB. Each slot holds the
+    // sequence number of a record, where slots holding a sequence number issued
+    // before the current TB started are free. The records of the current TB are
+    // numbered from m_dedup_seq_begin in the order of appending.
+    vector<uint64_t> m_dedup_slots;
+    uint64_t m_dedup_seq_begin;
+    uint64_t m_dedup_seq_next;
+};
 
 typedef map<uint64_t, CreteMemoInfo> debug_memoSyncTable_ty;
 typedef vector<debug_memoSyncTable_ty> debug_memoSyncTables_ty;
 
+typedef CPUStateSyncTable cpuStateSyncTable_ty;
+
 // bool: valid table or not
 // vector<>: contents
-typedef pair<bool, vector<CPUStateElement> > cpuStateSyncTable_ty;
+typedef pair<bool, vector<CPUStateElement> > debug_cpuStateSyncTable_ty;
 
 typedef pair<QemuInterruptInfo, bool> interruptState_ty;
 
 //<name, concolic_memo>
 typedef map<string, CreteMemoInfo> creteConcolics_ty;
 
+// What the IR of a captured TB is generated from. Guest code is keyed by its
+// hash, and compared in full against TBIRStoreEntry::m_code on lookup.
+struct TBIRKey
+{
+    uint64_t m_pc;
+    uint64_t m_cs_base;
+    uint64_t m_flags;
+    uint64_t m_cflags;
+    uint64_t m_end_pc; // crete_interrupted_pc, 0 for a complete TB
+    uint64_t m_code_hash;
+
+    bool operator<(const TBIRKey& rhs) const
+    {
+        if(m_pc != rhs.m_pc) return m_pc < rhs.m_pc;
+        if(m_code_hash != rhs.m_code_hash) return m_code_hash < rhs.m_code_hash;
+        if(m_end_pc != rhs.m_end_pc) return m_end_pc < rhs.m_end_pc;
+        if(m_flags != rhs.m_flags) return m_flags < rhs.m_flags;
+        if(m_cflags != rhs.m_cflags) return m_cflags < rhs.m_cflags;
+        return m_cs_base < rhs.m_cs_base;
+    }
+};
+
+// Captured IR of a TB, kept across the iterations traced by this VM
+struct TBIRStoreEntry
+{
+    vector<uint8_t> m_code;
+    uint64_t m_inst_count;
+    TCGLLVMOfflineTBIR m_tb_ir;
+
+    // index_captured_llvm_tb of this IR in the trace of RuntimeEnv m_generation
+    uint64_t m_generation;
+    uint64_t m_index;
+};
+
+typedef map<TBIRKey, TBIRStoreEntry> TBIRStore;
+
+// Traced data of a streaming window, handed off to the stream writer thread
+struct StreamedWindow
+{
+    uint64_t m_index;    // m_streamed_index
+    uint64_t m_first_tb; // m_streamed_tb_count
+    uint64_t m_size;     // estimated memory usage, see get_size()
+
+    TCGLLVMOfflineContext m_tcg_llvm_offline_ctx;
+    vector<cpuStateSyncTable_ty> m_cpuStateSyncTables;
+    vector<debug_cpuStateSyncTable_ty> m_debug_cpuStateSyncTables;
+    vector<cpuStateSyncTable_ty> m_tbPostSyncTables;
+
+    uint64_t get_size() const;
+};
+
 class RuntimeEnv
 {
 private:
@@ -218,12 +380,24 @@ private:
     pair<bool, void *> m_cpuState_post_insterest;
     // The CPUState before the execution of potential interested TBs
     pair<bool, void *> m_cpuState_pre_interest;
+    // Size of the prefix of CPUState covering all the fields traced for side-effects,
+    // which is the only part of CPUState being kept by the two CPUStates above
+    uint64_t m_cpuState_traced_size;
     // The CPUState after each interested TB being executed for cross checking on klee side
-    vector<cpuStateSyncTable_ty> m_debug_cpuStateSyncTables;
+    vector<debug_cpuStateSyncTable_ty> m_debug_cpuStateSyncTables;
+
+    // TB slicing: concrete globals written by each interested TB, which are applied
+    // by the replayer after the TB
+    vector<cpuStateSyncTable_ty> m_tbPostSyncTables;
+    // Globals of tcg_ctx being sliced, initialized on the first interested TB
+    vector<TBSliceGlobal> m_slice_globals;
+    // Bitmap of m_slice_globals tainted before the current TB, by global index
+    vector<uint64_t> m_tb_entry_tainted_globals;
+    // Bitmap of globals to be kept by each captured TB of this trace, see
+    // TCGLLVMOfflineContext::m_tb_kept_globals
+    vector<vector<uint64_t> > m_tb_kept_globals;
 
-    memoSyncTables_ty m_memoSyncTables;
-    memoSyncTable_ty m_currentMemoSyncTable;
-    uint64_t m_mergePoint_memoSyncTables;
+    MemoSyncArena m_memoSyncTables;
 
     // Memory state, being captured on-the-fly by monitoring memory operations of interested TBs
     // Each entry stores all load memory operations for each unique addr for each interested TB
@@ -231,10 +405,31 @@ private:
     debug_memoSyncTables_ty m_debug_memoSyncTables;
     vector<MemoMergePoint_ty> m_debug_memoMergePoints;
 
+    // Identifies the trace of this RuntimeEnv in TBIRStoreEntry
+    uint64_t m_tb_ir_generation;
+
     // Streaming tracing
     uint64_t m_streamed_tb_count;
     uint64_t m_streamed_index;
 
+    // Windows are written by a background thread, so that the guest does not
+    // pause at each of them. m_stream_cond is signaled on any change of the queue.
+    bool m_stream_writer_started;
+    bool m_stream_writer_stop;
+    QemuThread m_stream_writer;
+    QemuMutex m_stream_mutex;
+    QemuCond m_stream_cond;
+    deque<StreamedWindow *> m_stream_queue;
+    uint64_t m_stream_queued_size;
+    // Size of the queue beyond which tracing waits for the writer
+    uint64_t m_stream_writer_budget;
+    // First failure of the writer thread, rethrown by stopStreamWriter(). The windows
+    // queued after it are dropped, as the trace is incomplete anyway.
+    boost::exception_ptr m_stream_error;
+    // "dump_trace.bin": cpuState sync tables, memo sync tables, interrupt states, TB IR
+    // and the sequence of executed TBs
+    crete::trace::TraceWriter m_trace_writer;
+
     // crete miscs:
     // <name, concolic CreteMemoInfo>
     creteConcolics_ty m_concolics;
@@ -282,6 +477,10 @@ public:
     void addDebugCpuStateSyncTable(void *qemuCpuState);
     void printDebugCpuStateSyncTable(const string name) const;
 
+    // TB slicing
+    void setTBEntryTaint();
+    void addTBPostSyncTable(const void *qemuCpuState, uint64_t index_captured_llvm_tb);
+
     // Memory monitor
     void addCurrentMemoSyncTableEntry(uint64_t addr, uint32_t size, uint64_t value);
     void addCurrentMemoSyncTable();
@@ -324,10 +523,10 @@ private:
     void dump_tloTbPc(const uint64_t pc);
     void dump_tloTcgCtx(const TCGContext& tcg_ctx);
     void dump_tloHelpers(const TCGContext &tcg_ctx);
-    void dump_tcg_temp(const vector<TCGTemp>& tcg_temp);
     void dump_tloTbInstCount(const uint64_t inst_count);
 
-    void writeTcgLlvmCtx();
+    void writeTcgLlvmCtx(const TCGLLVMOfflineContext& tcg_llvm_offline_ctx,
+            uint64_t streamed_index);
 
     string getOutputFilename(const string &fileName) const;
 
@@ -346,15 +545,30 @@ private:
     void debugMergeMemoSync();
     void print_memoSyncTables();
 
+    void initSliceGlobals();
+
     void writeInitialCpuState();
-    void checkEmptyCPUStateSyncTables();
-    void writeCPUStateSyncTables();
-    void writeDebugCPUStateSyncTables();
+    void checkEmptyCPUStateSyncTables(vector<cpuStateSyncTable_ty>& cpuStateSyncTables);
+    void writeCPUStateSyncTables(vector<cpuStateSyncTable_ty>& cpuStateSyncTables,
+            uint64_t first_tb,
+            crete::trace::ChunkType type = crete::trace::chunk_cpu_sync_tables);
+    void writeDebugCPUStateSyncTables(
+            const vector<debug_cpuStateSyncTable_ty>& debug_cpuStateSyncTables,
+            uint64_t streamed_index);
     void writeDebugCpuStateOffsets();
 
-    void writeInterruptStates() const;
+    void writeInterruptStates();
 
     void writeTBGraphExecSequ();
+    void writeCaptureProfile();
+
+    // Streaming
+    void takeStreamedWindow(StreamedWindow& window);
+    void writeStreamedWindow(StreamedWindow& window);
+    void startStreamWriter();
+    void stopStreamWriter();
+    void pushStreamedWindow(StreamedWindow *window);
+    static void *streamWriterThread(void *opaque);
 };
 
 class CreteFlags{
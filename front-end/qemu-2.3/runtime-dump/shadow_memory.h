@@ -0,0 +1,227 @@
+#ifndef CRETE_SHADOW_MEMORY_H
+#define CRETE_SHADOW_MEMORY_H
+
+#include <stdint.h>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace crete
+{
+namespace tci
+{
+
+// Tainted bytes and the values they had when being tainted. Shadow pages holding
+// a taint bitmap and the values are allocated on demand, and the page of the last
+// access is cached, so that checking an access of up to 8 bytes within a page is
+// one lookup and a mask test on the bitmap.
+class ShadowMemory
+{
+public:
+    static const uint64_t page_bits = 12;
+    static const uint64_t page_size = 1ULL << page_bits;
+
+    struct Page
+    {
+        Page() { memset(this, 0, sizeof(Page)); }
+
+        uint64_t taint[page_size / 64];
+        uint8_t value[page_size];
+    };
+
+    typedef boost::unordered_map<uint64_t, Page> pages_ty;
+
+public:
+    ShadowMemory();
+    ShadowMemory(const ShadowMemory& other);
+    ShadowMemory& operator=(const ShadowMemory& other);
+
+    // Check the tainted bytes of [addr, addr + size) against data (little-endian),
+    // size <= 8. Returns the mask of bytes still holding their tainted value, bit i
+    // for addr + i. Bytes changed since being tainted are untainted and set in changed.
+    uint8_t check(uint64_t addr, uint64_t size, uint64_t data, uint8_t& changed);
+    void taint(uint64_t addr, uint64_t size, uint64_t data);
+    void untaint(uint64_t addr, uint64_t size);
+
+    bool empty() const { return tainted_bytes_ == 0; }
+    std::vector<uint64_t> get_tainted_addrs() const;
+
+private:
+    Page* find_page(uint64_t page_no, bool create);
+    // Within one page, returns the mask of tainted bytes of [offset, offset + size)
+    static uint8_t get_taint_mask(const Page& page, uint64_t offset, uint64_t size);
+
+private:
+    pages_ty pages_;
+    uint64_t tainted_bytes_;
+
+    uint64_t cached_page_no_;
+    Page* cached_page_; // NULL for a page not allocated
+    bool cache_valid_;
+};
+
+inline ShadowMemory::ShadowMemory()
+    : tainted_bytes_(0)
+    , cached_page_no_(0)
+    , cached_page_(NULL)
+    , cache_valid_(false)
+{
+}
+
+inline ShadowMemory::ShadowMemory(const ShadowMemory& other)
+    : pages_(other.pages_)
+    , tainted_bytes_(other.tainted_bytes_)
+    , cached_page_no_(0)
+    , cached_page_(NULL)
+    , cache_valid_(false)
+{
+}
+
+inline ShadowMemory& ShadowMemory::operator=(const ShadowMemory& other)
+{
+    pages_ = other.pages_;
+    tainted_bytes_ = other.tainted_bytes_;
+    cache_valid_ = false;
+    cached_page_ = NULL;
+
+    return *this;
+}
+
+inline ShadowMemory::Page* ShadowMemory::find_page(uint64_t page_no, bool create)
+{
+    if(cache_valid_ && cached_page_no_ == page_no &&
+            (cached_page_ || !create))
+        return cached_page_;
+
+    Page* page = NULL;
+    if(create) {
+        page = &pages_[page_no];
+    } else {
+        pages_ty::iterator it = pages_.find(page_no);
+        if(it != pages_.end())
+            page = &it->second;
+    }
+
+    // Elements of boost::unordered_map are not moved by rehashing
+    cached_page_no_ = page_no;
+    cached_page_ = page;
+    cache_valid_ = true;
+
+    return page;
+}
+
+inline uint8_t ShadowMemory::get_taint_mask(const Page& page, uint64_t offset, uint64_t size)
+{
+    assert(size <= 8 && offset + size <= page_size);
+
+    uint64_t word = offset / 64;
+    uint64_t bit = offset % 64;
+
+    uint64_t bits = page.taint[word] >> bit;
+    if(bit + size > 64)
+        bits |= page.taint[word + 1] << (64 - bit);
+
+    return (uint8_t)(bits & ((1ULL << size) - 1));
+}
+
+inline uint8_t ShadowMemory::check(uint64_t addr, uint64_t size, uint64_t data, uint8_t& changed)
+{
+    assert(size <= 8);
+
+    uint64_t offset = addr & (page_size - 1);
+    if(offset + size > page_size) {
+        uint64_t first = page_size - offset;
+        uint8_t first_changed = 0;
+        uint8_t second_changed = 0;
+
+        uint8_t ret = check(addr, first, data, first_changed);
+        ret |= check(addr + first, size - first, data >> (first * 8), second_changed) << first;
+        changed = first_changed | (second_changed << first);
+
+        return ret;
+    }
+
+    changed = 0;
+
+    Page* page = find_page(addr >> page_bits, false);
+    if(!page)
+        return 0;
+
+    uint8_t tainted = get_taint_mask(*page, offset, size);
+    if(!tainted)
+        return 0;
+
+    uint8_t ret = 0;
+    for(uint64_t i = 0; i < size; ++i) {
+        if(!((tainted >> i) & 1))
+            continue;
+
+        if(page->value[offset + i] == ((data >> i*8) & 0xff)) {
+            ret |= 1 << i;
+        } else {
+            page->taint[(offset + i) / 64] &= ~(1ULL << ((offset + i) % 64));
+            --tainted_bytes_;
+            changed |= 1 << i;
+        }
+    }
+
+    return ret;
+}
+
+inline void ShadowMemory::taint(uint64_t addr, uint64_t size, uint64_t data)
+{
+    for(uint64_t i = 0; i < size; ++i) {
+        uint64_t offset = (addr + i) & (page_size - 1);
+        Page* page = find_page((addr + i) >> page_bits, true);
+
+        uint64_t& word = page->taint[offset / 64];
+        uint64_t bit = 1ULL << (offset % 64);
+        if(!(word & bit)) {
+            word |= bit;
+            ++tainted_bytes_;
+        }
+
+        page->value[offset] = (data >> i*8) & 0xff;
+    }
+}
+
+inline void ShadowMemory::untaint(uint64_t addr, uint64_t size)
+{
+    if(tainted_bytes_ == 0)
+        return;
+
+    for(uint64_t i = 0; i < size; ++i) {
+        uint64_t offset = (addr + i) & (page_size - 1);
+        Page* page = find_page((addr + i) >> page_bits, false);
+        if(!page)
+            continue;
+
+        uint64_t& word = page->taint[offset / 64];
+        uint64_t bit = 1ULL << (offset % 64);
+        if(word & bit) {
+            word &= ~bit;
+            --tainted_bytes_;
+        }
+    }
+}
+
+inline std::vector<uint64_t> ShadowMemory::get_tainted_addrs() const
+{
+    std::vector<uint64_t> addrs;
+
+    for(pages_ty::const_iterator it = pages_.begin(); it != pages_.end(); ++it) {
+        for(uint64_t offset = 0; offset < page_size; ++offset) {
+            if((it->second.taint[offset / 64] >> (offset % 64)) & 1)
+                addrs.push_back((it->first << page_bits) + offset);
+        }
+    }
+
+    return addrs;
+}
+
+} // namespace tci
+} // namespace crete
+
+#endif // CRETE_SHADOW_MEMORY_H
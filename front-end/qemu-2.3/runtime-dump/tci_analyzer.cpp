@@ -10,11 +10,16 @@ extern "C" {
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <cstring>
 
 #include "crete-debug.h"
+#include "crete-profile.h"
+#include "shadow_memory.h"
 
 static const uint64_t CRETE_TCG_ENV_SIZE = sizeof(CPUArchState);
 
@@ -61,7 +66,7 @@ public:
     // The address of tainted memory byte
     typedef boost::unordered_set<uint64_t> MemSet;
     // virtual guest address, value
-    typedef boost::unordered_map<uint64_t, uint8_t> taintedMem_ty;
+    typedef ShadowMemory taintedMem_ty;
     // (offset, vCPUReg)
     typedef boost::unordered_map<uint64_t, vCPUReg> cpuRegsTable_ty;
 public:
@@ -83,6 +88,8 @@ public:
     void make_host_mem_concrete(uint64_t base_addr, uint64_t offset, uint64_t size);
 
     bool is_within_vcpu(uint64_t addr, uint64_t size);
+    bool is_vcpu_tainted(uint64_t offset, uint64_t size) const;
+    bool is_tb_taint_free(const CreteTBTaintInputs& inputs);
 
     bool is_block_symbolic();
     bool is_previous_block_symbolic();
@@ -102,6 +109,9 @@ private:
     // <tainted, value>
     std::pair<bool, uint8_t> guest_vcpu_regs_[CRETE_TCG_ENV_SIZE];
     uint64_t guest_vcpu_addr_; // The address of the guest virtual cpu
+    // Number of tainted bytes within guest_vcpu_regs_, so that checks of taint do not
+    // need to scan the whole array
+    uint64_t tainted_vcpu_bytes_;
 
     // <tainted, value>
     std::pair<bool, uint64_t> tcg_regs_[TCG_TARGET_NB_REGS];
@@ -120,6 +130,7 @@ private:
 
 Analyzer::Analyzer()
     : guest_vcpu_addr_(0)
+    , tainted_vcpu_bytes_(0)
     , tcg_sp_value_(0)
     , previous_block_symbolic_(false)
     , initialized_(false)
@@ -208,64 +219,54 @@ void Analyzer::make_tcg_reg_concrete(uint64_t index, uint64_t data)
 
 bool Analyzer::is_guest_mem_symbolic(uint64_t addr, uint64_t size, uint64_t data)
 {
-    bool ret = false;
+    uint8_t changed = 0;
+    uint8_t symbolic = guest_mem_.check(addr, size, data, changed);
 
-    taintedMem_ty::iterator it;
-    uint8_t byte_value = 0;
+#if defined(CRETE_DBG_TA) || defined(CRETE_DBG_CK)
     for(uint64_t i = 0; i < size; ++i) {
-        it = guest_mem_.find(addr + i);
-        if(it == guest_mem_.end())
-            continue;
-
-        byte_value = (data >> i*8) & 0xff;
-        if(it->second == byte_value) {
-            ret = true;
-
 #if defined(CRETE_DBG_TA)
-            if(is_in_list_crete_dbg_ta_guest_addr(addr+i))
-                fprintf(stderr, "is_guest_mem_symbolic() is true for address %p\n",
-                        (void *)(addr+i));
+        if(((symbolic >> i) & 1) && is_in_list_crete_dbg_ta_guest_addr(addr+i))
+            fprintf(stderr, "is_guest_mem_symbolic() is true for address %p\n",
+                    (void *)(addr+i));
 #endif
-        } else {
-            guest_mem_.erase(it);
-
 #if defined(CRETE_DBG_CK)
+        if((changed >> i) & 1)
             fprintf(stderr, "[CRETE Warning] TA: is_guest_mem_symbolic() "
                     "potential under-taint-analysis: (%p) is changed "
                     "while is tainted.\n", (void *)(addr + i));
 #endif
-        }
     }
+#endif
 
-    return ret;
+    return symbolic != 0;
 }
 
 void Analyzer::make_guest_mem_symbolic(uint64_t addr, uint64_t size, uint64_t data)
 {
-    for(uint64_t i = 0; i < size; ++i) {
-        guest_mem_[addr+i] = (data >> i*8) & 0xff;
+    guest_mem_.taint(addr, size, data);
 
 #if defined(CRETE_DBG_TA)
+    for(uint64_t i = 0; i < size; ++i) {
         if(is_in_list_crete_dbg_ta_guest_addr(addr+i))
             fprintf(stderr, "make_guest_mem_symbolic() for address %p\n",
                     (void *)(addr+i));
-#endif
     }
+#endif
 
     mark_block_symbolic();
 }
 
 void Analyzer::make_guest_mem_concrete(uint64_t addr, uint64_t size, uint64_t data)
 {
-    for(uint64_t i = 0; i < size; ++i) {
-        guest_mem_.erase(addr + i);
+    guest_mem_.untaint(addr, size);
 
 #if defined(CRETE_DBG_TA)
+    for(uint64_t i = 0; i < size; ++i) {
         if(is_in_list_crete_dbg_ta_guest_addr(addr+i))
             fprintf(stderr, "make_guest_mem_concrete() for address %p\n",
                     (void *)(addr+i));
-#endif
     }
+#endif
 }
 
 bool Analyzer::is_block_symbolic()
@@ -321,6 +322,7 @@ bool Analyzer::is_host_mem_symbolic(uint64_t base_addr, uint64_t offset, uint64_
 
             } else {
                 guest_vcpu_regs_[offset + i].first = false;
+                --tainted_vcpu_bytes_;
 
 #if defined(CRETE_DBG_CK)
             fprintf(stderr, "[CRETE Warning] TA: vcpu in is_host_mem_symbolic() "
@@ -334,31 +336,29 @@ bool Analyzer::is_host_mem_symbolic(uint64_t base_addr, uint64_t offset, uint64_
         assert(((offset >> 63) & 1)  && "[CRETE ERROR] when base addr is tcg_sp_value_, "
                 "its offset should always be negative.\n ");
 
-        taintedMem_ty::iterator it;
-        uint8_t byte_value;
-        for(uint64_t i = 0; i < size; ++i) {
-            it = tcg_call_stack_mem_.find(offset + i);
-            if(it == tcg_call_stack_mem_.end())
-                continue;
+        assert(size <= 8);
+        uint64_t data = 0;
+        memcpy(&data, (const void *)(tcg_sp_value_ + offset), size);
 
-            byte_value = *(uint8_t *)(tcg_sp_value_ + offset + i);
-            if(it->second == byte_value) {
-                ret = true;
+        uint8_t changed = 0;
+        uint8_t symbolic = tcg_call_stack_mem_.check(offset, size, data, changed);
+        ret = (symbolic != 0);
 
+#if defined(CRETE_DBG_TA) || defined(CRETE_DBG_CK)
+        for(uint64_t i = 0; i < size; ++i) {
 #if defined(CRETE_DBG_TA)
+            if((symbolic >> i) & 1)
                 fprintf(stderr, "[CRETE Info] TA: tcg_sp_value_ is symbolic: offset %lu\n",
                         offset + i);
 #endif
-            } else {
-                tcg_call_stack_mem_.erase(it);
-
 #if defined(CRETE_DBG_CK)
+            if((changed >> i) & 1)
                 fprintf(stderr, "[CRETE Warning] TA: tcg_call_stack_mem_ in is_host_mem_symbolic() "
                         "potential under-taint-analysis: (%ld) is changed "
                         "while is tainted.\n", (int64_t)(offset + i));
 #endif
-            }
         }
+#endif
     } else {
         assert(0 && "[CRETE ERROR] base_addr is neither guest_vcpu_addr_ nor tcg_sp_value_\n");
     }
@@ -397,6 +397,9 @@ void Analyzer::make_host_mem_symbolic(uint64_t base_addr, uint64_t offset, uint6
         assert( (offset + size -1) < CRETE_TCG_ENV_SIZE);
         const uint8_t *current_cpuState = (const uint8_t *)guest_vcpu_addr_;
         for(uint64_t i = 0; i < size; ++i){
+            if(!guest_vcpu_regs_[offset + i].first)
+                ++tainted_vcpu_bytes_;
+
             guest_vcpu_regs_[offset + i].second = current_cpuState[offset + i];
             guest_vcpu_regs_[offset + i].first = true;
         }
@@ -404,9 +407,11 @@ void Analyzer::make_host_mem_symbolic(uint64_t base_addr, uint64_t offset, uint6
         assert(((offset >> 63) & 1)  && "[CRETE ERROR] when base addr is not vcpu, "
                 "its offset should always be negative.\n ");
 
-        for(uint64_t i = 0; i < size ; ++i) {
-            tcg_call_stack_mem_[offset + i] = *(uint8_t *)(tcg_sp_value_ + offset + i);
-        }
+        assert(size <= 8);
+        uint64_t data = 0;
+        memcpy(&data, (const void *)(tcg_sp_value_ + offset), size);
+
+        tcg_call_stack_mem_.taint(offset, size, data);
     } else {
         assert(0 && "[CRETE ERROR] base_addr is neither guest_vcpu_addr_ nor tcg_sp_value_\n");
     }
@@ -435,15 +440,17 @@ void Analyzer::make_host_mem_concrete(uint64_t base_addr, uint64_t offset, uint6
         }
 
         assert( (offset + size -1) < CRETE_TCG_ENV_SIZE);
-        for(uint64_t i = 0; i < size; ++i)
+        for(uint64_t i = 0; i < size; ++i) {
+            if(guest_vcpu_regs_[offset + i].first)
+                --tainted_vcpu_bytes_;
+
             guest_vcpu_regs_[offset + i].first = false;
+        }
     } else if (base_addr == tcg_sp_value_) {
         assert(((offset >> 63) & 1)  && "[CRETE ERROR] when base addr is not vcpu, "
                 "its offset should always be negative.\n ");
 
-        for(uint64_t i = 0; i < size ; ++i) {
-            tcg_call_stack_mem_.erase(offset + i);
-        }
+        tcg_call_stack_mem_.untaint(offset, size);
     } else {
         assert(0 && "[CRETE ERROR] base_addr is neither guest_vcpu_addr_ nor tcg_sp_value_\n");
     }
@@ -462,15 +469,69 @@ bool Analyzer::is_within_vcpu(uint64_t addr, uint64_t size)
         return false;
 }
 
+// Whether any byte of vcpu [offset, offset + size) still holds its tainted value.
+// Unlike is_host_mem_symbolic(), bytes changed since being tainted are not untainted.
+bool Analyzer::is_vcpu_tainted(uint64_t offset, uint64_t size) const
+{
+    if(tainted_vcpu_bytes_ == 0 || guest_vcpu_addr_ == 0)
+        return false;
+
+    assert(offset + size <= CRETE_TCG_ENV_SIZE);
+    const uint8_t *current_cpuState = (const uint8_t *)guest_vcpu_addr_;
+    for(uint64_t i = offset; i < offset + size; ++i) {
+        if(guest_vcpu_regs_[i].first &&
+                guest_vcpu_regs_[i].second == current_cpuState[i])
+            return true;
+    }
+
+    return false;
+}
+
+// Whether a tb can be interpreted without taint analysis: it has no custom instruction
+// introducing taint, reads or writes no tainted byte of vcpu, and accesses guest memory
+// only when guest memory is free of taint. Like is_host_mem_symbolic(), tainted bytes of
+// vcpu that changed since being tainted are untainted, as the tb may write them.
+// The call stack only holds the spilled temps of the tb being executed, which are
+// written before being read by the tb, so taint left there by other TBs is ignored.
+bool Analyzer::is_tb_taint_free(const CreteTBTaintInputs& inputs)
+{
+    if(inputs.custom_instr || inputs.unknown_mem)
+        return false;
+
+    if(inputs.guest_mem && !guest_mem_.empty())
+        return false;
+
+    if(tainted_vcpu_bytes_ == 0)
+        return true;
+
+    const uint8_t *current_cpuState = (const uint8_t *)guest_vcpu_addr_;
+    for(uint8_t r = 0; r < inputs.nb_env_ranges; ++r) {
+        uint64_t end = std::min<uint64_t>(inputs.env_end[r], CRETE_TCG_ENV_SIZE);
+        for(uint64_t i = inputs.env_begin[r]; i < end; ++i) {
+            if(!guest_vcpu_regs_[i].first)
+                continue;
+
+            if(guest_vcpu_regs_[i].second == current_cpuState[i])
+                return false;
+
+            guest_vcpu_regs_[i].first = false;
+            --tainted_vcpu_bytes_;
+        }
+    }
+
+    return true;
+}
+
 void Analyzer::dbg_print()
 {
-    for(taintedMem_ty::const_iterator it = guest_mem_.begin();
-    it != guest_mem_.end();
+    std::vector<uint64_t> tainted_addrs = guest_mem_.get_tainted_addrs();
+    for(std::vector<uint64_t>::const_iterator it = tainted_addrs.begin();
+    it != tainted_addrs.end();
     ++it)
     {
         std::cerr << "tained guest mem: "
         << std::hex
-        << it->first
+        << *it
         << std::dec
         << std::endl;
     }
@@ -856,6 +917,34 @@ bool crete_tci_is_current_block_symbolic()
     return is_current_block_symbolic();
 }
 
+bool crete_tci_is_tb_taint_free(const CreteTBTaintInputs *inputs)
+{
+    return analyzer.is_tb_taint_free(*inputs);
+}
+
+// Executions of interested TBs of the current iteration
+static uint64_t tb_exec_plain_count = 0;
+static uint64_t tb_exec_instrumented_count = 0;
+
+void crete_tci_count_tb_exec(bool plain)
+{
+    if(plain)
+        ++tb_exec_plain_count;
+    else
+        ++tb_exec_instrumented_count;
+}
+
+void crete_tci_get_tb_exec_counts(uint64_t *plain, uint64_t *instrumented)
+{
+    *plain = tb_exec_plain_count;
+    *instrumented = tb_exec_instrumented_count;
+}
+
+bool crete_tci_is_vcpu_tainted(uint64_t offset, uint64_t size)
+{
+    return analyzer.is_vcpu_tainted(offset, size);
+}
+
 void crete_tci_next_tci_instr(void)
 {
     crete_read_was_symbolic = false;
@@ -1073,6 +1162,8 @@ void crete_tci_st_i64(uint64_t t1, uint64_t offset)
 // address will not cause over-tainting with concrete value
 void crete_tci_qemu_ld8u(uint64_t t0, uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     crete_read_was_symbolic = analyzer.is_guest_mem_symbolic(addr, 1, data);
 }
 
@@ -1083,6 +1174,8 @@ void crete_tci_qemu_ld8s(uint64_t t0, uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_ld16u(uint64_t t0, uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     crete_read_was_symbolic =
             analyzer.is_guest_mem_symbolic(addr, 2, data);
 }
@@ -1094,6 +1187,8 @@ void crete_tci_qemu_ld16s(uint64_t t0, uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_ld32u(uint64_t t0, uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     crete_read_was_symbolic =
             analyzer.is_guest_mem_symbolic(addr, 4, data);
 }
@@ -1110,6 +1205,8 @@ void crete_tci_qemu_ld32(uint64_t t0, uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_ld64(uint64_t t0, uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     crete_read_was_symbolic =
             analyzer.is_guest_mem_symbolic(addr, 8, data);
 }
@@ -1123,6 +1220,8 @@ void crete_tci_qemu_ld64(uint64_t t0, uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_st8(uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     if(crete_read_was_symbolic)
     {
         analyzer.make_guest_mem_symbolic(addr, 1, data);
@@ -1135,6 +1234,8 @@ void crete_tci_qemu_st8(uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_st16(uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     if(crete_read_was_symbolic)
     {
         analyzer.make_guest_mem_symbolic(addr, 2, data);
@@ -1147,6 +1248,8 @@ void crete_tci_qemu_st16(uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_st32(uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     if(crete_read_was_symbolic)
     {
         analyzer.make_guest_mem_symbolic(addr, 4, data);
@@ -1159,6 +1262,8 @@ void crete_tci_qemu_st32(uint64_t addr, uint64_t data)
 
 void crete_tci_qemu_st64(uint64_t addr, uint64_t data)
 {
+    CRETE_PROFILE_SCOPE(CRETE_PROF_TAINT_CHECK);
+
     if(crete_read_was_symbolic)
     {
         analyzer.make_guest_mem_symbolic(addr, 8, data);
@@ -1211,6 +1316,8 @@ void tci_analyzer_print()
 void crete_tci_next_iteration()
 {
     analyzer = Analyzer();
+    tb_exec_plain_count = 0;
+    tb_exec_instrumented_count = 0;
 }
 
 bool crete_tci_is_previous_block_symbolic()
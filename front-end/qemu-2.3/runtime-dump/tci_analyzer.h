@@ -8,6 +8,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+struct TranslationBlock;
+struct CreteTBTaintInputs;
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -19,6 +22,12 @@ void crete_tci_set_crete_read_was_symbolic(bool input);
 
 bool crete_tci_is_current_block_symbolic(void);
 bool crete_tci_is_previous_block_symbolic(void);
+// Whether the inputs of a tb are free of taint, so that it can run on the plain TCI
+bool crete_tci_is_tb_taint_free(const struct CreteTBTaintInputs *inputs);
+// Executions of interested TBs on the plain and the instrumented TCI
+void crete_tci_count_tb_exec(bool plain);
+void crete_tci_get_tb_exec_counts(uint64_t *plain, uint64_t *instrumented);
+bool crete_tci_is_vcpu_tainted(uint64_t offset, uint64_t size); // taint of vcpu bytes
 void crete_tci_mark_block_symbolic(void);
 void crete_tci_next_iteration(void); // reset for taint analysis
 
@@ -58,6 +67,9 @@ void crete_tci_qemu_st16(uint64_t addr, uint64_t data);
 void crete_tci_qemu_st32(uint64_t addr, uint64_t data);
 void crete_tci_qemu_st64(uint64_t addr, uint64_t data);
 
+// crete_tci.c: summarizes the TCI code [code, code + size) of tb
+void crete_tci_summarize_tb(struct TranslationBlock *tb, const uint8_t *code, int size);
+
 // Trace Graph
 bool crete_tci_is_block_branching(void);
 void crete_tci_brcond(void);
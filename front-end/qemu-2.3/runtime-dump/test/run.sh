@@ -0,0 +1 @@
+./crete_shadow_memory.test --show_progress=yes
@@ -0,0 +1,199 @@
+#define BOOST_TEST_MODULE crete_shadow_memory top-level test suite
+
+#include <boost/test/unit_test.hpp>
+
+#include "shadow_memory.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace crete::tci;
+
+// Byte-wise reference of ShadowMemory: tainted address -> value when tainted
+class ReferenceMemory
+{
+public:
+    uint8_t check(uint64_t addr, uint64_t size, uint64_t data, uint8_t& changed)
+    {
+        uint8_t ret = 0;
+        changed = 0;
+
+        for(uint64_t i = 0; i < size; ++i) {
+            auto it = bytes_.find(addr + i);
+            if(it == bytes_.end())
+                continue;
+
+            if(it->second == ((data >> i*8) & 0xff)) {
+                ret |= 1 << i;
+            } else {
+                bytes_.erase(it);
+                changed |= 1 << i;
+            }
+        }
+
+        return ret;
+    }
+
+    void taint(uint64_t addr, uint64_t size, uint64_t data)
+    {
+        for(uint64_t i = 0; i < size; ++i)
+            bytes_[addr + i] = (data >> i*8) & 0xff;
+    }
+
+    void untaint(uint64_t addr, uint64_t size)
+    {
+        for(uint64_t i = 0; i < size; ++i)
+            bytes_.erase(addr + i);
+    }
+
+    bool empty() const { return bytes_.empty(); }
+
+    vector<uint64_t> get_tainted_addrs() const
+    {
+        vector<uint64_t> addrs;
+        for(const auto& b : bytes_)
+            addrs.push_back(b.first);
+
+        return addrs;
+    }
+
+private:
+    map<uint64_t, uint8_t> bytes_;
+};
+
+template <typename Memory>
+auto sorted_tainted_addrs(const Memory& m) -> vector<uint64_t>
+{
+    auto addrs = m.get_tainted_addrs();
+    sort(addrs.begin(), addrs.end());
+
+    return addrs;
+}
+
+// Addresses clustered around page boundaries, so that accesses straddle pages and
+// hit the cached page, plus the top of the address space, where call stack slots
+// addressed by tcg_sp and a negative offset wrap
+auto random_addr(mt19937_64& gen) -> uint64_t
+{
+    static const uint64_t bases[] = {0x0,
+                                     0x1000,
+                                     0x7fff0000,
+                                     0xc0001000,
+                                     0x0 - ShadowMemory::page_size};
+
+    auto base = bases[gen() % (sizeof(bases) / sizeof(bases[0]))];
+    auto pages = gen() % 3;
+    auto offset = int64_t(gen() % 48) - 24;
+
+    return base + pages * ShadowMemory::page_size + offset;
+}
+
+// A small value range, so that checks often find the tainted values unchanged
+auto random_data(mt19937_64& gen) -> uint64_t
+{
+    auto data = uint64_t(0);
+    for(auto i = 0; i < 8; ++i)
+        data |= (gen() % 3) << i*8;
+
+    return data;
+}
+
+BOOST_AUTO_TEST_SUITE(shadow_memory)
+
+BOOST_AUTO_TEST_CASE(page_straddling)
+{
+    auto shadow = ShadowMemory{};
+    auto addr = ShadowMemory::page_size - 3;
+
+    shadow.taint(addr, 8, 0x0807060504030201ULL);
+    BOOST_CHECK(!shadow.empty());
+    BOOST_CHECK_EQUAL(shadow.get_tainted_addrs().size(), 8u);
+
+    uint8_t changed = 0;
+    BOOST_CHECK_EQUAL(shadow.check(addr, 8, 0x0807060504030201ULL, changed), 0xff);
+    BOOST_CHECK_EQUAL(changed, 0);
+
+    // Change the bytes on either side of the page boundary
+    BOOST_CHECK_EQUAL(shadow.check(addr, 8, 0x0807060505ff0201ULL, changed), 0xf3);
+    BOOST_CHECK_EQUAL(changed, 0x0c);
+    BOOST_CHECK_EQUAL(shadow.get_tainted_addrs().size(), 6u);
+
+    shadow.untaint(addr, 8);
+    BOOST_CHECK(shadow.empty());
+    BOOST_CHECK_EQUAL(shadow.check(addr, 8, 0, changed), 0);
+    BOOST_CHECK_EQUAL(changed, 0);
+}
+
+BOOST_AUTO_TEST_CASE(address_space_wrap)
+{
+    auto shadow = ShadowMemory{};
+    auto addr = uint64_t(0) - 4;
+
+    shadow.taint(addr, 8, 0x1122334455667788ULL);
+
+    auto addrs = sorted_tainted_addrs(shadow);
+    BOOST_REQUIRE_EQUAL(addrs.size(), 8u);
+    BOOST_CHECK_EQUAL(addrs.front(), 0u);
+    BOOST_CHECK_EQUAL(addrs.back(), uint64_t(0) - 1);
+
+    uint8_t changed = 0;
+    BOOST_CHECK_EQUAL(shadow.check(0, 4, 0x11223344ULL, changed), 0x0f);
+    BOOST_CHECK_EQUAL(changed, 0);
+}
+
+BOOST_AUTO_TEST_CASE(randomized_reference)
+{
+    auto gen = mt19937_64{0xc4e7e};
+
+    for(auto round = 0; round < 20; ++round) {
+        auto shadow = ShadowMemory{};
+        auto reference = ReferenceMemory{};
+
+        for(auto op = 0; op < 5000; ++op) {
+            auto addr = random_addr(gen);
+            auto size = 1 + gen() % 8;
+            auto data = random_data(gen);
+
+            switch(gen() % 4) {
+            case 0:
+            case 1:
+            {
+                uint8_t changed = 0;
+                uint8_t ref_changed = 0;
+                auto mask = shadow.check(addr, size, data, changed);
+                auto ref_mask = reference.check(addr, size, data, ref_changed);
+
+                BOOST_REQUIRE_EQUAL(mask, ref_mask);
+                BOOST_REQUIRE_EQUAL(changed, ref_changed);
+                break;
+            }
+            case 2:
+                shadow.taint(addr, size, data);
+                reference.taint(addr, size, data);
+                break;
+            case 3:
+                shadow.untaint(addr, size);
+                reference.untaint(addr, size);
+                break;
+            }
+
+            BOOST_REQUIRE_EQUAL(shadow.empty(), reference.empty());
+
+            // A copy drops the cached page of the original
+            if(op % 1000 == 999) {
+                auto copy = ShadowMemory{shadow};
+                shadow = copy;
+            }
+        }
+
+        auto addrs = sorted_tainted_addrs(shadow);
+        auto ref_addrs = reference.get_tainted_addrs();
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(addrs.begin(), addrs.end(),
+                                        ref_addrs.begin(), ref_addrs.end());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
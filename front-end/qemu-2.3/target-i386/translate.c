@@ -4638,6 +4638,8 @@ static target_ulong disas_insn(CPUX86State *env, DisasContext *s,
             uint64_t arg = cpu_ldq_code(env, s->pc);
             tcg_gen_movi_i64(cpu_tmp1_i64, arg);
 
+            s->tb->taint_inputs.custom_instr = 1;
+
             switch(arg)
             {
             default:
@@ -61,6 +61,8 @@
 #include "translate-all.h"
 #include "qemu/timer.h"
 
+#include "runtime-dump/tci_analyzer.h"
+
 //#define DEBUG_TB_INVALIDATE
 //#define DEBUG_FLUSH
 /* make various TB consistency checks */
@@ -181,6 +183,9 @@ int cpu_gen_code(CPUArchState *env, TranslationBlock *tb, int *gen_code_size_ptr
 #endif
     gen_code_size = tcg_gen_code(s, gen_code_buf);
     *gen_code_size_ptr = gen_code_size;
+#if defined(CONFIG_CRETE) || 1
+    crete_tci_summarize_tb(tb, gen_code_buf, gen_code_size);
+#endif
 #ifdef CONFIG_PROFILER
     s->code_time += profile_getclock();
     s->code_in_len += tb->size;
@@ -727,6 +732,9 @@ static TranslationBlock *tb_alloc(target_ulong pc)
 #if defined(CONFIG_CRETE) || 1
     tb->tcg_ctx_captured = 0;
     tb->index_captured_llvm_tb = -1;
+    tb->pc_filter_gen = 0; /* Filter generations start from 1 */
+    tb->pc_filter_verdict = 0;
+    memset(&tb->taint_inputs, 0, sizeof(tb->taint_inputs));
 #endif
 
     return tb;
@@ -0,0 +1,230 @@
+#include <crete/asio/client.h>
+#include <crete/asio/server.h>
+#include <crete/asio/common.h>
+#include <crete/exception.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+/**
+ * Measures the throughput of a transfer from a Server to a Client over loopback, for each
+ * of the ways crete streams data:
+ *  - chunked: write()/read() of common.h, in default_chunk_size packets (file to file);
+ *  - bulk: write_bulk()/read_bulk(), in bulk_buffer_size packets (memory to memory);
+ *  - file: write_file()/read_file(), using sendfile(2) (file to file).
+ */
+
+namespace crete
+{
+namespace bench
+{
+
+using Transfer = std::function<void (Server&)>;
+using Receive = std::function<void (Client&)>;
+
+auto run(const std::string& name,
+         uint64_t size,
+         const Transfer& transfer,
+         const Receive& receive) -> void
+{
+    Server server;
+
+    auto port = boost::lexical_cast<std::string>(server.port());
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread receiver{[&port, &receive] {
+        Client client{"localhost", port};
+
+        client.connect();
+
+        receive(client);
+    }};
+
+    server.open_connection_wait();
+
+    transfer(server);
+
+    receiver.join();
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(8) << name
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << (size / (1024.0 * 1024.0)) / elapsed << " MiB/s"
+              << std::setw(10) << elapsed * 1000 << " ms"
+              << std::endl;
+}
+
+auto make_payload(const fs::path& path,
+                  uint64_t size) -> std::vector<char>
+{
+    auto payload = std::vector<char>(size);
+
+    for(auto i = uint64_t{0}; i < size; ++i)
+    {
+        payload[i] = static_cast<char>(i * 2654435761u >> 24);
+    }
+
+    fs::ofstream ofs{path, std::ios::binary};
+
+    ofs.write(payload.data(),
+              static_cast<std::streamsize>(payload.size()));
+
+    return payload;
+}
+
+auto bench_chunked(const fs::path& src,
+                   const fs::path& dst,
+                   uint64_t size) -> void
+{
+    run("chunked",
+        size,
+        [&src](Server& server) {
+            fs::ifstream ifs{src, std::ios::binary};
+
+            write(server,
+                  ifs,
+                  default_chunk_size);
+        },
+        [&dst](Client& client) {
+            fs::ofstream ofs{dst, std::ios::binary};
+
+            read(client,
+                 ofs);
+        });
+}
+
+auto bench_bulk(const std::vector<char>& payload) -> void
+{
+    run("bulk",
+        payload.size(),
+        [&payload](Server& server) {
+            auto pkinfo = PacketInfo{0,0,0};
+            pkinfo.type = packet_type::chunk;
+
+            for(auto pos = std::size_t{0}; pos < payload.size(); pos += bulk_buffer_size)
+            {
+                auto count = std::min(bulk_buffer_size,
+                                      payload.size() - pos);
+
+                server.write_bulk({boost::asio::buffer(payload.data() + pos, count)},
+                                  pkinfo);
+            }
+
+            server.write_bulk({},
+                              pkinfo);
+        },
+        [](Client& client) {
+            auto buf = std::vector<char>{};
+
+            while(client.read_bulk(buf).size != 0)
+            {
+            }
+        });
+}
+
+auto bench_file(const fs::path& src,
+                const fs::path& dst,
+                uint64_t size) -> void
+{
+    run("file",
+        size,
+        [&src](Server& server) {
+            auto pkinfo = PacketInfo{0,0,0};
+            pkinfo.type = packet_type::chunk;
+
+            server.write_file(src,
+                              pkinfo);
+        },
+        [&dst](Client& client) {
+            client.read_file(dst);
+        });
+}
+
+} // namespace bench
+} // namespace crete
+
+int main(int argc, char* argv[])
+{
+    using namespace crete::bench;
+
+    try
+    {
+        po::options_description desc("Options");
+
+        desc.add_options()
+                ("help,h", "displays help message")
+                ("size,s", po::value<uint64_t>()->default_value(256), "size of the transfer, in MiB")
+                ("mode,m", po::value<std::string>()->default_value("all"), "chunked, bulk, file or all")
+            ;
+
+        po::variables_map var_map;
+        po::store(po::parse_command_line(argc, argv, desc), var_map);
+        po::notify(var_map);
+
+        if(var_map.count("help"))
+        {
+            std::cout << desc << std::endl;
+
+            return 0;
+        }
+
+        auto size = var_map["size"].as<uint64_t>() * 1024 * 1024;
+        auto mode = var_map["mode"].as<std::string>();
+
+        auto dir = fs::temp_directory_path() / fs::unique_path("crete-asio-bench-%%%%%%%%");
+        fs::create_directories(dir);
+
+        auto src = dir / "src";
+        auto dst = dir / "dst";
+
+        auto payload = make_payload(src,
+                                    size);
+
+        if(mode == "chunked" || mode == "all")
+        {
+            bench_chunked(src, dst, size);
+        }
+        if(mode == "bulk" || mode == "all")
+        {
+            bench_bulk(payload);
+        }
+        if(mode == "file" || mode == "all")
+        {
+            bench_file(src, dst, size);
+        }
+
+        fs::remove_all(dir);
+    }
+    catch(crete::Exception& e)
+    {
+        std::cerr << "crete-asio-bench: [CRETE] Exception: " << boost::diagnostic_information(e) << std::endl;
+        return -1;
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << "crete-asio-bench: [std] Exception: " << boost::diagnostic_information(e) << std::endl;
+        return -1;
+    }
+    catch(...)
+    {
+        std::cerr << "crete-asio-bench: [...] Exception: " << boost::current_exception_diagnostic_information() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -85,4 +85,28 @@ PacketInfo Client::read(boost::posix_time::time_duration timeout)
     return pimpl_->read(timeout);
 }
 
+size_t Client::write_bulk(const std::vector<boost::asio::const_buffer>& buffers,
+                          const PacketInfo& pkinfo)
+{
+    return pimpl_->write_bulk(buffers, pkinfo);
+}
+
+PacketInfo Client::read_bulk(std::vector<char>& buf)
+{
+    return pimpl_->read_bulk(buf);
+}
+
+uint64_t Client::write_file(const boost::filesystem::path& path,
+                            const PacketInfo& pkinfo,
+                            const StreamProgress& progress)
+{
+    return pimpl_->write_file(path, pkinfo, progress);
+}
+
+PacketInfo Client::read_file(const boost::filesystem::path& path,
+                             const StreamProgress& progress)
+{
+    return pimpl_->read_file(path, progress);
+}
+
 } // namespace crete
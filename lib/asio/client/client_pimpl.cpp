@@ -1,5 +1,6 @@
 #include "client_pimpl.h"
 #include <crete/asio/common.h>
+#include <crete/asio/bulk.h>
 
 #include <boost/asio.hpp>
 #include <boost/lambda/bind.hpp>
@@ -266,4 +267,36 @@ PacketInfo ClientImpl::read(boost::posix_time::time_duration timeout)
     return pktinfo;
 }
 
+size_t ClientImpl::write_bulk(const std::vector<boost::asio::const_buffer>& buffers,
+                              const PacketInfo& pkinfo)
+{
+    return bulk::write_bulk(socket_,
+                            buffers,
+                            pkinfo);
+}
+
+PacketInfo ClientImpl::read_bulk(std::vector<char>& buf)
+{
+    return bulk::read_bulk(socket_,
+                           buf);
+}
+
+uint64_t ClientImpl::write_file(const boost::filesystem::path& path,
+                                const PacketInfo& pkinfo,
+                                const StreamProgress& progress)
+{
+    return bulk::write_file(socket_,
+                            path,
+                            pkinfo,
+                            progress);
+}
+
+PacketInfo ClientImpl::read_file(const boost::filesystem::path& path,
+                                 const StreamProgress& progress)
+{
+    return bulk::read_file(socket_,
+                           path,
+                           progress);
+}
+
 } // namespace crete
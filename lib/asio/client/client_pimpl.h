@@ -36,6 +36,15 @@ public:
     PacketInfo read(boost::asio::streambuf& sbuf);
     PacketInfo read();
     PacketInfo read(boost::posix_time::time_duration timeout);
+    // Bulk transfers: see crete/asio/bulk.h.
+    size_t write_bulk(const std::vector<boost::asio::const_buffer>& buffers,
+                      const PacketInfo& pkinfo);
+    PacketInfo read_bulk(std::vector<char>& buf);
+    uint64_t write_file(const boost::filesystem::path& path,
+                        const PacketInfo& pkinfo,
+                        const StreamProgress& progress = StreamProgress());
+    PacketInfo read_file(const boost::filesystem::path& path,
+                         const StreamProgress& progress = StreamProgress());
 
     void connect();
     void connect(boost::posix_time::time_duration timeout);
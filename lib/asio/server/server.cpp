@@ -1,4 +1,5 @@
 #include <crete/asio/server.h>
+#include <crete/asio/bulk.h>
 #include <crete/exception.h>
 
 #include <iostream>
@@ -211,6 +212,38 @@ PacketInfo Server::read()
     return pktinfo;
 }
 
+size_t Server::write_bulk(const std::vector<boost::asio::const_buffer>& buffers,
+                          const PacketInfo& pkinfo)
+{
+    return bulk::write_bulk(socket_,
+                            buffers,
+                            pkinfo);
+}
+
+PacketInfo Server::read_bulk(std::vector<char>& buf)
+{
+    return bulk::read_bulk(socket_,
+                           buf);
+}
+
+uint64_t Server::write_file(const boost::filesystem::path& path,
+                            const PacketInfo& pkinfo,
+                            const StreamProgress& progress)
+{
+    return bulk::write_file(socket_,
+                            path,
+                            pkinfo,
+                            progress);
+}
+
+PacketInfo Server::read_file(const boost::filesystem::path& path,
+                             const StreamProgress& progress)
+{
+    return bulk::read_file(socket_,
+                           path,
+                           progress);
+}
+
 void crete::Server::update_directory(const boost::filesystem::path& from, const boost::filesystem::path& to)
 {
     namespace fs = boost::filesystem;
@@ -1,24 +1,18 @@
 #include <crete/cluster/common.h>
+#include <crete/cluster/directory_stream.h>
 #include <crete/exception.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/uuid/uuid_generators.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/filter/bzip2.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/device/array.hpp>
 
 //#include <boost/algorithm/string/join.hpp>
 
-#include <boost/process.hpp>
-
+#include <algorithm>
+#include <functional>
 #include <iostream> // testing.
 
 namespace fs = boost::filesystem;
-namespace bp = boost::process;
 namespace bui = boost::uuids;
 
 namespace crete
@@ -32,73 +26,318 @@ ImageInfo::ImageInfo(const boost::filesystem::path& image) :
 {
 }
 
-/**
- * @brief archive_directory archives a directory into a single archived file
- *        of the same name. Please note that this is done in-place.
- * @param dir - path to the directory to be archived, in-place.
- * @note Compression is also done on the archive.
- */
-auto archive_directory(const boost::filesystem::path& dir) -> void
+namespace
 {
-    auto tmp = fs::path{dir}.replace_extension("tmp");
 
-    CRETE_EXCEPTION_ASSERT(fs::exists(dir), err::file_missing{dir.string()});
+// Kinds of the entries of a directory archive.
+const auto entry_end = uint8_t{0};
+const auto entry_directory = uint8_t{1};
+const auto entry_file = uint8_t{2};
+const auto entry_symlink = uint8_t{3};
+
+// Integers are archived little-endian, as the nodes and dispatch need not share a host.
+auto write_uint(std::ostream& os, uint64_t value, std::size_t bytes) -> void
+{
+    for(auto i = std::size_t{0}; i < bytes; ++i)
+    {
+        os.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
 
-    bp::context ctx;
-    ctx.work_directory = dir.parent_path().string();
-    ctx.environment = bp::self::get_environment();
-    auto exe = bp::find_executable_in_path("tar");
-    auto args = std::vector<std::string>{fs::path{exe}.filename().string(),
-                                         "-zcf",
-                                         tmp.filename().string(),
-                                         dir.filename().string()
-                                         };
+auto read_uint(std::istream& is, std::size_t bytes) -> uint64_t
+{
+    auto value = uint64_t{0};
 
-    auto proc = bp::launch(exe, args, ctx);
-    auto status = proc.wait();
+    for(auto i = std::size_t{0}; i < bytes; ++i)
+    {
+        auto c = is.get();
 
-    CRETE_EXCEPTION_ASSERT(status.exit_status() == 0, err::process_exit_status{exe});
+        CRETE_EXCEPTION_ASSERT(c != std::istream::traits_type::eof(),
+                               err::msg{"truncated directory archive"});
 
-    auto rcount = fs::remove_all(dir);
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(c)) << (8 * i);
+    }
 
-    CRETE_EXCEPTION_ASSERT(rcount > 0, err::file_remove{dir.string()});
+    return value;
+}
 
-    fs::rename(tmp,
-               dir);
+auto write_string(std::ostream& os, const std::string& str) -> void
+{
+    write_uint(os, str.size(), 4);
+    os.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+auto read_string(std::istream& is) -> std::string
+{
+    auto size = read_uint(is, 4);
+    auto str = std::string(size, '\0');
+
+    is.read(&str[0], static_cast<std::streamsize>(size));
+
+    CRETE_EXCEPTION_ASSERT(static_cast<uint64_t>(is.gcount()) == size,
+                           err::msg{"truncated directory archive"});
+
+    return str;
+}
+
+// Archived paths are relative to the parent of the directory, so they start with its name.
+auto validate_entry_path(const fs::path& path,
+                         const fs::path& top) -> void
+{
+    CRETE_EXCEPTION_ASSERT(!path.empty() && path.is_relative(),
+                           err::invalid{path.string()});
+
+    for(const auto& e : path)
+    {
+        CRETE_EXCEPTION_ASSERT(e != ".." && e != ".",
+                               err::invalid{path.string()});
+    }
+
+    CRETE_EXCEPTION_ASSERT(*path.begin() == top,
+                           err::invalid{path.string()});
+}
+
+// Symlinks may only point within the directory they're restored in.
+auto validate_symlink_target(const fs::path& target) -> void
+{
+    CRETE_EXCEPTION_ASSERT(!target.empty() && target.is_relative(),
+                           err::invalid{target.string()});
+
+    for(const auto& e : target)
+    {
+        CRETE_EXCEPTION_ASSERT(e != "..",
+                               err::invalid{target.string()});
+    }
+}
+
+// Refuses to restore an entry through an existing symlink (e.g., left over in 'parent').
+auto validate_no_symlink(const fs::path& parent,
+                         const fs::path& rel) -> void
+{
+    auto path = parent;
+
+    for(const auto& e : rel)
+    {
+        path /= e;
+
+        CRETE_EXCEPTION_ASSERT(!fs::is_symlink(fs::symlink_status(path)),
+                               err::invalid{path.string()});
+    }
+}
+
+} // namespace
+
+auto directory_size(const fs::path& dir) -> uint64_t
+{
+    auto size = uint64_t{0};
+
+    for(auto it = fs::recursive_directory_iterator{dir};
+        it != fs::recursive_directory_iterator{};
+        ++it)
+    {
+        if(fs::is_regular_file(it->symlink_status()))
+        {
+            size += fs::file_size(it->path());
+        }
+    }
+
+    return size;
 }
 
 /**
- * @brief restore_directory restores a previously archived directory via archive_directory().
- *        Please note that this is done in-place.
- * @param dir - path to the directory to be restored, in-place.
- * @note Archive is decompressed.
+ * @brief write_directory archives the directory 'dir' into 'os'.
+ *
+ * Entries are: kind (1 byte), path relative to the parent of 'dir' (4-byte size + bytes),
+ * permissions (4 bytes), and then the file's size (8 bytes) + contents, or the symlink's target.
+ * Directories precede their contents. An entry of kind 'entry_end' closes the archive.
  */
-auto restore_directory(const boost::filesystem::path& dir) -> void
+auto write_directory(const fs::path& dir,
+                     std::ostream& os,
+                     uint64_t total_size,
+                     const StreamProgress& progress) -> void
+{
+    CRETE_EXCEPTION_ASSERT(fs::is_directory(dir), err::file_missing{dir.string()});
+
+    auto buf = std::vector<char>(directory_chunk_size);
+    auto done = uint64_t{0};
+
+    auto write_entry = [&os](uint8_t kind,
+                             const fs::path& path,
+                             const fs::file_status& status) {
+        os.put(static_cast<char>(kind));
+        write_string(os, path.generic_string());
+        write_uint(os, static_cast<uint64_t>(status.permissions()), 4);
+    };
+
+    std::function<void(const fs::path&, const fs::path&)> write_entries;
+    write_entries = [&](const fs::path& path, const fs::path& rel) {
+        auto status = fs::symlink_status(path);
+
+        if(fs::is_symlink(status))
+        {
+            write_entry(entry_symlink, rel, status);
+            write_string(os, fs::read_symlink(path).string());
+        }
+        else if(fs::is_directory(status))
+        {
+            write_entry(entry_directory, rel, status);
+
+            for(auto it = fs::directory_iterator{path};
+                it != fs::directory_iterator{};
+                ++it)
+            {
+                write_entries(it->path(),
+                              rel / it->path().filename());
+            }
+        }
+        else if(fs::is_regular_file(status))
+        {
+            fs::ifstream ifs{path, std::ios::in | std::ios::binary};
+
+            CRETE_EXCEPTION_ASSERT(ifs.good(), err::file_open_failed{path.string()});
+
+            auto size = fs::file_size(path);
+
+            write_entry(entry_file, rel, status);
+            write_uint(os, size, 8);
+
+            for(auto left = size; left > 0;)
+            {
+                auto count = std::min(left, static_cast<uint64_t>(buf.size()));
+
+                ifs.read(buf.data(), static_cast<std::streamsize>(count));
+
+                CRETE_EXCEPTION_ASSERT(static_cast<uint64_t>(ifs.gcount()) == count,
+                                       err::file{path.string()});
+
+                os.write(buf.data(), static_cast<std::streamsize>(count));
+
+                left -= count;
+                done += count;
+
+                if(progress)
+                {
+                    progress(done, total_size);
+                }
+            }
+        }
+        else
+        {
+            CRETE_EXCEPTION_THROW(err::file{path.string()}); // Sockets, devices, etc. have no place in a trace.
+        }
+    };
+
+    write_entries(dir,
+                  dir.filename());
+
+    os.put(static_cast<char>(entry_end));
+
+    CRETE_EXCEPTION_ASSERT(os.good(), err::msg{"failed to write directory archive: " + dir.string()});
+}
+
+auto read_directory(std::istream& is,
+                    const fs::path& parent,
+                    uint64_t total_size,
+                    const StreamProgress& progress) -> fs::path
 {
-    auto tmp = fs::path{dir}.replace_extension("tmp");
+    auto buf = std::vector<char>(directory_chunk_size);
+    auto done = uint64_t{0};
+    auto top = fs::path{};
+    // Created once everything else is, so that no entry is written through them.
+    auto symlinks = std::vector<std::pair<fs::path, fs::path>>{};
+
+    while(true)
+    {
+        auto kind = static_cast<uint8_t>(read_uint(is, 1));
+
+        if(kind == entry_end)
+        {
+            break;
+        }
+
+        auto rel = fs::path{read_string(is)};
+        auto perms = static_cast<fs::perms>(read_uint(is, 4));
+
+        if(top.empty())
+        {
+            top = *rel.begin();
+        }
+
+        validate_entry_path(rel, top);
+        validate_no_symlink(parent, rel);
+
+        auto path = parent / rel;
+
+        if(kind == entry_directory)
+        {
+            fs::create_directories(path);
+            fs::permissions(path, perms);
+        }
+        else if(kind == entry_file)
+        {
+            auto size = read_uint(is, 8);
+
+            fs::ofstream ofs{path, std::ios::out | std::ios::binary | std::ios::trunc};
+
+            CRETE_EXCEPTION_ASSERT(ofs.good(), err::file_open_failed{path.string()});
+
+            for(auto left = size; left > 0;)
+            {
+                auto count = std::min(left, static_cast<uint64_t>(buf.size()));
+
+                is.read(buf.data(), static_cast<std::streamsize>(count));
+
+                CRETE_EXCEPTION_ASSERT(static_cast<uint64_t>(is.gcount()) == count,
+                                       err::msg{"truncated directory archive"});
+
+                ofs.write(buf.data(), static_cast<std::streamsize>(count));
+
+                left -= count;
+                done += count;
+
+                if(progress)
+                {
+                    progress(done, total_size);
+                }
+            }
+
+            ofs.close();
+
+            CRETE_EXCEPTION_ASSERT(!ofs.fail(), err::file_create{path.string()});
+
+            fs::permissions(path, perms);
+        }
+        else if(kind == entry_symlink)
+        {
+            auto target = fs::path{read_string(is)};
+
+            validate_symlink_target(target);
 
-    CRETE_EXCEPTION_ASSERT(fs::exists(dir), err::file_missing{dir.string()});
+            symlinks.emplace_back(target, rel);
+        }
+        else
+        {
+            CRETE_EXCEPTION_THROW(err::msg{"invalid directory archive entry"});
+        }
+    }
 
-    fs::rename(dir,
-               tmp);
+    CRETE_EXCEPTION_ASSERT(!top.empty(), err::msg{"empty directory archive"});
 
-    bp::context ctx;
-    ctx.work_directory = dir.parent_path().string();
-    ctx.environment = bp::self::get_environment();
-    auto exe = bp::find_executable_in_path("tar");
-    auto args = std::vector<std::string>{fs::path{exe}.filename().string(),
-                                         "-xf",
-                                         tmp.filename().string(),
-                                         };
+    for(const auto& link : symlinks)
+    {
+        validate_no_symlink(parent, link.second);
 
-    auto proc = bp::launch(exe, args, ctx);
-    auto status = proc.wait();
+        auto path = parent / link.second;
 
-    CRETE_EXCEPTION_ASSERT(status.exit_status() == 0, err::process_exit_status{exe});
+        fs::remove(path);
+        fs::create_symlink(link.first, path);
+    }
 
-    auto rcount = fs::remove_all(tmp);
+    // Reaching the end of the compressed stream is what has its checksum verified.
+    CRETE_EXCEPTION_ASSERT(is.peek() == std::istream::traits_type::eof(),
+                           err::msg{"trailing data in directory archive"});
 
-    CRETE_EXCEPTION_ASSERT(rcount > 0, err::file_remove{dir.string()});
+    return parent / top;
 }
 
 auto GuestData::write_guest_config(const boost::filesystem::path &output) -> void
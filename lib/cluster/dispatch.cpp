@@ -1,4 +1,5 @@
 #include <crete/cluster/dispatch.h>
+#include <crete/cluster/directory_stream.h>
 #include <crete/exception.h>
 #include <crete/logger.h>
 #include <crete/async_task.h>
@@ -31,6 +32,34 @@ namespace crete
 namespace cluster
 {
 
+/**
+ * @brief Publishes the progress of a stream over a node connection, for display,
+ * until it goes out of scope.
+ */
+class StreamTracker
+{
+public:
+    StreamTracker(NodeConnection& conn) : conn_(conn) {}
+    ~StreamTracker()
+    {
+        conn_.stream_size = 0;
+        conn_.stream_done = 0;
+    }
+
+    auto progress() -> StreamProgress
+    {
+        auto& conn = conn_;
+
+        return [&conn](uint64_t done, uint64_t size) {
+            conn.stream_size = size;
+            conn.stream_done = done;
+        };
+    }
+
+private:
+    NodeConnection& conn_;
+};
+
 namespace vm
 {
 // +--------------------------------------------------+
@@ -187,12 +216,12 @@ public:
     //   +------------------+------------------+------------------+---------------------+------------------+
       Row<TraceRxed         ,trace             ,TxTest            ,none                 ,is_prev_task_finished>,
     //   +------------------+------------------+------------------+---------------------+------------------+
-      Row<TxTest            ,test              ,TestTxed          ,ActionSequence_<mpl::vector<
-                                                                       tx_test,
-                                                                       rx_status>>      ,none                 >,
+      Row<TxTest            ,test              ,TestTxed          ,tx_test              ,none                 >,
     //   +------------------+------------------+------------------+---------------------+------------------+
-      Row<TestTxed          ,poll              ,RxStatus          ,none                 ,Not_<has_error>      >,
-      Row<TestTxed          ,poll              ,ErrorRxed         ,rx_error             ,has_error            >,
+      Row<TestTxed          ,poll              ,RxStatus          ,none                 ,And_<is_prev_task_finished,
+                                                                                              Not_<has_error>>>,
+      Row<TestTxed          ,poll              ,ErrorRxed         ,rx_error             ,And_<is_prev_task_finished,
+                                                                                              has_error>      >,
     //   +------------------+------------------+------------------+---------------------+------------------+
       Row<ErrorRxed         ,poll              ,RxStatus          ,none                 ,none                 >
     > {};
@@ -448,6 +477,8 @@ struct VMNodeFSM_::TestTxed : public msm::front::state<>
     template <class Event,class FSM>
     void on_exit(Event const&,FSM& ) {std::cout << "leaving: TestTxed" << std::endl;}
 #endif // defined(CRETE_DEBUG)
+
+    std::unique_ptr<AsyncTask> async_task_;
 };
 
 struct VMNodeFSM_::ErrorRxed : public msm::front::state<>
@@ -524,23 +555,21 @@ struct VMNodeFSM_::update_image
                 BOOST_THROW_EXCEPTION(Exception{} << err::file_missing{image_path.string()});
             }
 
-            fs::ifstream ifs(image_path);
-
-            CRETE_EXCEPTION_ASSERT(ifs.good(), err::file_open_failed{image_path.string()});
-
             auto pkinfo = PacketInfo{0,0,0};
-            auto lock = node->acquire();
-
-            pkinfo.id = lock->status.id;
+            pkinfo.id = node->acquire()->status.id;
             pkinfo.type = packet_type::cluster_image;
 
-            lock->server.write(pkinfo);
+            auto conn = connection(node);
+            boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+            StreamTracker tracker{*conn};
+
+            conn->server.write(pkinfo);
 
             std::cout << "Sending OS image to VM Node..." << std::endl;
 
-            write(lock->server,
-                  ifs,
-                  default_chunk_size);
+            conn->server.write_file(image_path,
+                                    pkinfo,
+                                    tracker.progress());
 
         }
         , fsm.node_
@@ -553,15 +582,16 @@ struct VMNodeFSM_::rx_guest_data
     template <class EVT,class FSM,class SourceState,class TargetState>
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
     {
-        auto lock = fsm.node_->acquire();
-
         auto pkinfo = PacketInfo{0,0,0};
-        pkinfo.id = lock->status.id;
+        pkinfo.id = fsm.node_->acquire()->status.id;
         pkinfo.type = packet_type::cluster_request_guest_data;
 
-        lock->server.write(pkinfo);
+        auto conn = connection(fsm.node_);
+        boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
 
-        read_serialized_binary(lock->server,
+        conn->server.write(pkinfo);
+
+        read_serialized_binary(conn->server,
                                fsm.guest_data_,
                                packet_type::cluster_tx_guest_data);
     }
@@ -606,15 +636,19 @@ struct VMNodeFSM_::rx_trace
 struct VMNodeFSM_::tx_test
 {
     template <class EVT,class FSM,class SourceState,class TargetState>
-    auto operator()(EVT const& ev, FSM& fsm, SourceState&, TargetState&) -> void
+    auto operator()(EVT const& ev, FSM& fsm, SourceState&, TargetState& ts) -> void
     {
-        if(ev.tests_.empty())
+        // Off the dispatch thread, along with the status exchange that follows.
+        ts.async_task_.reset(new AsyncTask{[]( NodeRegistrar::Node node
+                                             , const std::vector<TestCase> tests)
         {
-            return;
-        }
+            transmit_tests(node,
+                           tests);
 
-        transmit_tests(fsm.node_,
-                       ev.tests_);
+            cluster::poll(node);
+        }
+        , fsm.node_
+        , ev.tests_});
     }
 };
 
@@ -766,7 +800,7 @@ class SVMNodeFSM_ : public boost::msm::front::state_machine_def<SVMNodeFSM_>
 {
 private:
     NodeRegistrar::Node node_;
-    std::vector<TestCase> tests_;
+    std::shared_ptr<std::vector<TestCase>> tests_ = std::make_shared<std::vector<TestCase>>();
     std::deque<log::NodeError> errors_;
 
     friend class vm::VMNodeFSM_; // Allow reuse of VMNode's actions/guards with private members.
@@ -866,8 +900,10 @@ public:
                                                                                               has_error>      >,
       Row<RxTest            ,poll              ,TestRxed          ,rx_test              ,has_tests            >,
     //   +------------------+------------------+------------------+---------------------+------------------+
-      Row<TestRxed          ,test              ,RxStatus          ,none                 ,Not_<has_error>      >,
-      Row<TestRxed          ,test              ,ErrorRxed         ,rx_error             ,has_error            >,
+      Row<TestRxed          ,test              ,RxStatus          ,none                 ,And_<is_prev_task_finished,
+                                                                                              Not_<has_error>>>,
+      Row<TestRxed          ,test              ,ErrorRxed         ,rx_error             ,And_<is_prev_task_finished,
+                                                                                              has_error>      >,
     //   +------------------+------------------+------------------+---------------------+------------------+
       Row<ErrorRxed         ,poll              ,RxStatus          ,none                 ,none                 >
     > {};
@@ -898,7 +934,7 @@ auto SVMNodeFSM_::node_status() -> const NodeStatus&
 
 auto SVMNodeFSM_::tests() -> const std::vector<TestCase>&
 {
-    return tests_;
+    return *tests_;
 }
 
 auto SVMNodeFSM_::errors() -> const std::deque<log::NodeError>&
@@ -987,6 +1023,8 @@ struct SVMNodeFSM_::TestRxed : public msm::front::state<>
     template <class Event,class FSM>
     void on_exit(Event const&,FSM& ) {std::cout << "leaving: TestRxed" << std::endl;}
 #endif // defined(CRETE_DEBUG)
+
+    std::unique_ptr<AsyncTask> async_task_;
 };
 
 struct SVMNodeFSM_::Error : public msm::front::state<>
@@ -1043,9 +1081,15 @@ struct SVMNodeFSM_::tx_trace
 struct SVMNodeFSM_::rx_test
 {
     template <class EVT,class FSM,class SourceState,class TargetState>
-    auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
+    auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState& ts) -> void
     {
-        fsm.tests_ = receive_tests(fsm.node_);
+        ts.async_task_.reset(new AsyncTask{[]( NodeRegistrar::Node node
+                                             , std::shared_ptr<std::vector<TestCase>> tests)
+        {
+            *tests = receive_tests(node);
+        }
+        , fsm.node_
+        , fsm.tests_});
     }
 };
 
@@ -1114,6 +1158,7 @@ public:
     auto display_status(std::ostream& os) -> void;
     auto write_tc_tree(std::ostream& os) -> void;
     auto write_statistics() -> void;
+    auto collect_capture_profile(const fs::path& trace) -> void;
     auto test_pool() -> TestPool&;
     auto trace_pool() -> TracePool&;
     auto set_up_root_dir() -> void;
@@ -1123,6 +1168,7 @@ public:
     auto are_all_queues_empty() -> bool;
     auto are_nodes_inactive() -> bool;
     auto is_converged() -> bool;
+    auto idle_round() -> bool;
     auto write_target_log(const log::NodeError& ne,
                           const fs::path& subdir) -> void;
 
@@ -1236,6 +1282,7 @@ private:
     boost::filesystem::path current_target_seeds_;
     bool first_trace_rxed_{false};
     GuestData guest_data_;
+    bool idle_round_{false};
 };
 
 struct start
@@ -1432,12 +1479,14 @@ struct DispatchFSM_::reset
             for(auto& node : lock->nodes())
             {
                 {
-                    auto nl = node->acquire();
                     auto pkinfo = PacketInfo{0,0,0};
-                    pkinfo.id = nl->status.id;
+                    pkinfo.id = node->acquire()->status.id;
                     pkinfo.type = packet_type::cluster_reset;
 
-                    nl->server.write(pkinfo);
+                    auto conn = connection(node);
+                    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+                    conn->server.write(pkinfo);
                 }
 
                 register_node_fsm(node,
@@ -1461,19 +1510,25 @@ struct DispatchFSM_::assign_next_target
 
             for(auto& node : lock->nodes())
             {
-                auto nl = node->acquire();
+                auto pkinfo = PacketInfo{0,0,0};
 
-                if(nl->type != packet_type::cluster_request_vm_node)
                 {
-                    continue;
+                    auto nl = node->acquire();
+
+                    if(nl->type != packet_type::cluster_request_vm_node)
+                    {
+                        continue;
+                    }
+
+                    pkinfo.id = nl->status.id;
+                    pkinfo.type = packet_type::cluster_next_target;
                 }
 
-                auto pkinfo = PacketInfo{0,0,0};
-                pkinfo.id = nl->status.id;
-                pkinfo.type = packet_type::cluster_next_target;
+                auto conn = connection(node);
+                boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
 
                 auto& queue = fsm.next_target_queue_;
-                write_serialized_binary(nl->server,
+                write_serialized_binary(conn->server,
                                         pkinfo,
                                         queue.front());
                 fsm.target_ = queue.front();
@@ -1488,6 +1543,10 @@ struct DispatchFSM_::dispatch
     template <class EVT,class FSM,class SourceState,class TargetState>
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
     {
+        // Whether traces, tests or errors moved this round. The node FSMs advance on
+        // every poll regardless, as they exchange status with their nodes.
+        auto progressed = false;
+
         {
             auto vmns_lock = fsm.vm_node_fsms_.acquire();
 
@@ -1508,6 +1567,8 @@ struct DispatchFSM_::dispatch
                     if(HANDLED_TRUE == nfsm->process_event(vm::trace{}))
                     {
                         fsm.to_trace_pool(nfsm->get_trace());
+
+                        progressed = true;
                     }
                 }
                 else if(nfsm->is_flag_active<vm::flag::tx_test>())
@@ -1527,6 +1588,8 @@ struct DispatchFSM_::dispatch
                         ++tc_count;
                     }
 
+                    progressed = progressed || !tests.empty();
+
                     nfsm->process_event(vm::test{tests});
                 }
                 else if(nfsm->is_flag_active<vm::flag::error_rxed>())
@@ -1538,6 +1601,8 @@ struct DispatchFSM_::dispatch
                         fsm.write_target_log(err, dispatch_log_vm_dir_name);
                         fsm.node_error_log_ << "Target: " << fsm.target_ << "\n"
                                             <<  err.log << "\n";
+
+                        progressed = true;
                     }
 
                     nfsm->process_event(vm::poll{});
@@ -1545,10 +1610,14 @@ struct DispatchFSM_::dispatch
                 else if(nfsm->is_flag_active<vm::flag::tx_config>())
                 {
                     nfsm->process_event(vm::config{fsm.options_});
+
+                    progressed = true;
                 }
                 else if(nfsm->is_flag_active<vm::flag::image>())
                 {
                     nfsm->process_event(vm::image{fsm.options_.vm.image.path});
+
+                    progressed = true;
                 }
                 else if(nfsm->is_flag_active<vm::flag::guest_data_rxed>())
                 {
@@ -1577,6 +1646,8 @@ struct DispatchFSM_::dispatch
                     }
 
                     nfsm->process_event(vm::poll{});
+
+                    progressed = true;
                 }
                 else
                 {
@@ -1594,13 +1665,19 @@ struct DispatchFSM_::dispatch
             {
                 if(nfsm->is_flag_active<svm::flag::test_rxed>())
                 {
-                    // Assumption from svm_node The last test case is the input tc
-                    std::vector<TestCase> new_tcs = nfsm->tests();
-                    TestCase input_tc = new_tcs.back();
-                    new_tcs.pop_back();
-                    fsm.test_pool_.insert(new_tcs, input_tc);
+                    using boost::msm::back::HANDLED_TRUE;
+
+                    // The tests are received in the background, and are in once the FSM moves on.
+                    if(HANDLED_TRUE == nfsm->process_event(svm::test{}))
+                    {
+                        // Assumption from svm_node The last test case is the input tc
+                        std::vector<TestCase> new_tcs = nfsm->tests();
+                        TestCase input_tc = new_tcs.back();
+                        new_tcs.pop_back();
+                        fsm.test_pool_.insert(new_tcs, input_tc);
 
-                    nfsm->process_event(svm::test{});
+                        progressed = true;
+                    }
                 }
                 else if(nfsm->is_flag_active<svm::flag::tx_trace>())
                 {
@@ -1631,6 +1708,8 @@ struct DispatchFSM_::dispatch
                     if(next)
                     {
                         nfsm->process_event(svm::trace{*next});
+
+                        progressed = true;
                     }
                     else
                     {
@@ -1646,6 +1725,8 @@ struct DispatchFSM_::dispatch
                         fsm.write_target_log(err, dispatch_log_svm_dir_name);
                         fsm.node_error_log_ << "Target: " << fsm.target_ << "\n"
                                             <<  err.log << "\n";
+
+                        progressed = true;
                     }
 
                     nfsm->process_event(svm::poll{});
@@ -1653,6 +1734,8 @@ struct DispatchFSM_::dispatch
                 else if(nfsm->is_flag_active<vm::flag::tx_config>())
                 {
                     nfsm->process_event(vm::config{fsm.options_});
+
+                    progressed = true;
                 }
                 else
                 {
@@ -1662,6 +1745,7 @@ struct DispatchFSM_::dispatch
         }
 
         fsm.first_ = false;
+        fsm.idle_round_ = !progressed;
 
         fsm.display_status(std::cout);
         fsm.write_statistics();
@@ -1744,9 +1828,30 @@ auto DispatchFSM_::to_trace_pool(const fs::path& trace) -> void
 {
     CRETE_EXCEPTION_ASSERT(fs::exists(trace), err::file_missing{trace.string()})
 
+    collect_capture_profile(trace);
+
     trace_pool_.insert(trace);
 }
 
+// Keeps the capture profile of a trace, which goes away with the trace once it is
+// executed, as profile/capture/<trace>.json
+auto DispatchFSM_::collect_capture_profile(const fs::path& trace) -> void
+{
+    auto profile = trace / trace_capture_profile_file_name;
+
+    if(!fs::exists(profile))
+    {
+        return;
+    }
+
+    auto dir = root_ / dispatch_profile_dir_name / dispatch_profile_capture_dir_name;
+
+    fs::create_directories(dir);
+    fs::copy_file(profile,
+                  dir / (trace.filename().string() + ".json"),
+                  fs::copy_option::overwrite_if_exists);
+}
+
 auto DispatchFSM_::next_trace() -> boost::optional<fs::path>
 {
     return trace_pool_.next();
@@ -1812,6 +1917,16 @@ auto DispatchFSM_::are_all_queues_empty() -> bool
          && trace_pool_.count_next() == 0;
 }
 
+auto DispatchFSM_::idle_round() -> bool
+{
+    auto idle = idle_round_;
+
+    // Reported once, so that the steps in between rounds don't count as idle.
+    idle_round_ = false;
+
+    return idle;
+}
+
 auto DispatchFSM_::are_nodes_inactive() -> bool
 {
     auto lock = node_registrar_.acquire();
@@ -2032,6 +2147,14 @@ auto DispatchFSM_::display_status(std::ostream& os) -> void
             tt += to_string(lock->status.test_case_count) +
                   "/" +
                   to_string(lock->status.trace_count);
+
+            // Progress of the stream in flight, if any.
+            auto stream_size = lock->connection->stream_size.load();
+            if(stream_size > 0)
+            {
+                tt += " " + to_string(lock->connection->stream_done.load() * 100 / stream_size) + "%";
+            }
+
             os << setw(14) << tt
                  << "|";
         }
@@ -2151,6 +2274,11 @@ auto Dispatch::run() -> bool
     return ret;
 }
 
+auto Dispatch::is_idle() -> bool
+{
+    return !has_nodes() || dispatch_fsm_->idle_round();
+}
+
 auto Dispatch::has_nodes() -> bool
 {
     return !dispatch_fsm_->node_registrar().acquire()->nodes().empty();
@@ -2216,51 +2344,50 @@ auto sort_by_test(NodeRegistrar::Nodes& nodes) -> void
 auto receive_trace(NodeRegistrar::Node& node,
                    const fs::path& traces_dir) -> fs::path
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_trace_request;
 
-    lock->server.write(pkinfo);
+    auto trace = fs::path{};
 
-    auto trace_name = std::string{};
+    {
+        auto conn = connection(node);
+        boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+        StreamTracker tracker{*conn};
 
-    read_serialized_binary(lock->server,
-                           trace_name,
-                           packet_type::cluster_trace);
+        conn->server.write(pkinfo);
 
-    auto trace = traces_dir / trace_name;
+        auto trace_name = std::string{};
 
-    {
-        fs::ofstream ofs{trace,
-                         std::ios::out | std::ios::binary};
+        read_serialized_binary(conn->server,
+                               trace_name,
+                               packet_type::cluster_trace);
 
-        CRETE_EXCEPTION_ASSERT(ofs.good(),
-                               err::file_open_failed{trace.string()});
+        trace = receive_directory(conn->server,
+                                  traces_dir,
+                                  tracker.progress());
 
-        read(lock->server,
-             ofs);
+        CRETE_EXCEPTION_ASSERT(trace.filename() == trace_name,
+                               err::invalid{trace.string()});
     }
 
-    restore_directory(trace);
-
     return trace;
 }
 
 auto receive_tests(NodeRegistrar::Node& node) -> std::vector<TestCase>
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_test_case_request;
 
-    lock->server.write(pkinfo);
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    conn->server.write(pkinfo);
 
     auto tcs = std::vector<TestCase>{};
 
-    read_serialized_binary(lock->server,
+    read_serialized_binary(conn->server,
                            tcs,
                            packet_type::cluster_test_case);
 
@@ -2269,17 +2396,18 @@ auto receive_tests(NodeRegistrar::Node& node) -> std::vector<TestCase>
 
 auto receive_errors(NodeRegistrar::Node& node) -> std::vector<log::NodeError>
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_error_log_request;
 
-    lock->server.write(pkinfo);
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    conn->server.write(pkinfo);
 
     auto errs = std::vector<log::NodeError>{};
 
-    read_serialized_binary(lock->server,
+    read_serialized_binary(conn->server,
                            errs,
                            packet_type::cluster_test_case);
 
@@ -2290,15 +2418,17 @@ auto receive_image_info(NodeRegistrar::Node& node) -> ImageInfo
 {
     auto pkinfo = PacketInfo{0,0,0};
     auto image_info = ImageInfo{};
-    auto lock = node->acquire();
 
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.size = 0;
     pkinfo.type = packet_type::cluster_image_info_request;
 
-    lock->server.write(pkinfo);
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    conn->server.write(pkinfo);
 
-    read_serialized_binary(lock->server,
+    read_serialized_binary(conn->server,
                            image_info,
                            packet_type::cluster_image_info);
 
@@ -2308,27 +2438,21 @@ auto receive_image_info(NodeRegistrar::Node& node) -> ImageInfo
 auto transmit_trace(NodeRegistrar::Node& node,
                     const fs::path& trace) -> void
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_trace;
 
-    archive_directory(trace);
-
-    fs::ifstream ifs{trace,
-                     std::ios::in | std::ios::binary};
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+    StreamTracker tracker{*conn};
 
-    CRETE_EXCEPTION_ASSERT(ifs.good(),
-                           err::file_open_failed{trace.string()});
-
-    write_serialized_binary(lock->server,
+    write_serialized_binary(conn->server,
                             pkinfo,
                             trace.filename().string());
 
-    write(lock->server,
-          ifs,
-          default_chunk_size);
+    transmit_directory(conn->server,
+                       trace,
+                       tracker.progress());
 }
 
 auto transmit_tests(NodeRegistrar::Node& node,
@@ -2339,34 +2463,40 @@ auto transmit_tests(NodeRegistrar::Node& node,
         return;
     }
 
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_test_case;
 
-    write_serialized_binary(lock->server,
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    write_serialized_binary(conn->server,
                             pkinfo,
                             tcs);
 }
 
 auto transmit_commencement(NodeRegistrar::Node& node) -> void
 {
-    auto lock = node->acquire();
-    lock->server.write(lock->status.id,
+    auto id = node->acquire()->status.id;
+
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    conn->server.write(id,
                        packet_type::cluster_commence);
 }
 
 auto transmit_image_info(NodeRegistrar::Node& node,
                          const ImageInfo& ii) -> void
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_image_info;
 
-    write_serialized_binary(lock->server,
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    write_serialized_binary(conn->server,
                             pkinfo,
                             ii);
 }
@@ -2374,13 +2504,14 @@ auto transmit_image_info(NodeRegistrar::Node& node,
 auto transmit_config(NodeRegistrar::Node& node,
                      const option::Dispatch& options) -> void
 {
-    auto lock = node->acquire();
-
     auto pkinfo = PacketInfo{0,0,0};
-    pkinfo.id = lock->status.id;
+    pkinfo.id = node->acquire()->status.id;
     pkinfo.type = packet_type::cluster_config;
 
-    write_serialized_binary(lock->server,
+    auto conn = connection(node);
+    boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+    write_serialized_binary(conn->server,
                             pkinfo,
                             options);
 
@@ -6,6 +6,7 @@
 #include <boost/msm/front/state_machine_def.hpp> //front-end
 
 #include <crete/asio/common.h>
+#include <crete/reactor.h>
 
 namespace crete
 {
@@ -33,11 +34,13 @@ auto NodeRegistrar::nodes() -> NodeRegistrar::Nodes&
 
 auto NodeRegistrar::disconnect() -> void
 {
-    for(const auto& node : nodes_)
+    for(auto& node : nodes_)
     {
-        auto lock = node->acquire();
+        auto id = node->acquire()->status.id;
+        auto conn = connection(node);
+        boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
 
-        lock->server.write(lock->status.id,
+        conn->server.write(id,
                            packet_type::cluster_shutdown);
     }
 
@@ -99,25 +102,26 @@ auto NodeRegistrarDriver::connect() -> void
 
         {
             auto lock = node->acquire();
+            auto& server = lock->connection->server; // 'node' is local, so no one else uses the connection yet.
 
             auto node_id = pkinfo.id;
             auto node_type = pkinfo.type;
-            auto new_port = lock->server.port();
+            auto new_port = server.port();
 
             registrar_server.write(new_port,
                                    packet_type::cluster_port);
 
-            lock->server.open_connection_wait(); // TODO: (relevant anymore with new shutdown signal?): If it doesn't connect... Timeout. See examples for deadline_timer. Also, there's a quick and simple use of std::future, but, alas, clang++ and libstdc++4.6 don't agree. Need at least libstc++4.8 or libc++. open_connection_async can also be used as a timeout mechanism.
+            server.open_connection_wait(); // TODO: (relevant anymore with new shutdown signal?): If it doesn't connect... Timeout. See examples for deadline_timer. Also, there's a quick and simple use of std::future, but, alas, clang++ and libstdc++4.6 don't agree. Need at least libstc++4.8 or libc++. open_connection_async can also be used as a timeout mechanism.
 
         //            if(/*server didn't connect*/)
         //                error... or move on;
 
             // Request status.
-            lock->server.write(node_id,
-                               packet_type::cluster_status_request);
+            server.write(node_id,
+                         packet_type::cluster_status_request);
 
             cluster::NodeStatus status;
-            read_serialized_binary(lock->server,
+            read_serialized_binary(server,
                                    status,
                                    packet_type::cluster_status);
 
@@ -131,6 +135,8 @@ auto NodeRegistrarDriver::connect() -> void
         // call_back must happen before push_back, or race condition ensues.
         // 'node' is local until this call makes it externally visible.
         registrar_.acquire()->nodes().push_back(node);
+
+        Reactor::notify_all(); // Dispatch may be idling for lack of nodes.
     }
     else if(pkinfo.type == packet_type::cluster_shutdown)
     {
@@ -161,20 +167,32 @@ auto NodeRegistrarDriver::call_back(NodeRegistrar::Node& node) -> void
 
 auto poll(NodeRegistrar::Node& node) -> NodeStatus
 {
-    auto lock = node->acquire();
-    lock->server.write(lock->status.id, // id of the node. For sanity check on the client (superfluous).
-                       packet_type::cluster_status_request);
+    auto id = node->acquire()->status.id;
+    auto conn = connection(node);
 
     cluster::NodeStatus status;
-    read_serialized_binary(lock->server,
-                           status,
-                           packet_type::cluster_status);
 
-    lock->status = status;
+    {
+        boost::lock_guard<boost::mutex> conn_lock{conn->mutex};
+
+        conn->server.write(id, // id of the node. For sanity check on the client (superfluous).
+                           packet_type::cluster_status_request);
+
+        read_serialized_binary(conn->server,
+                               status,
+                               packet_type::cluster_status);
+    }
+
+    node->acquire()->status = status;
 
     return status;
 }
 
+auto connection(NodeRegistrar::Node& node) -> std::shared_ptr<NodeConnection>
+{
+    return node->acquire()->connection;
+}
+
 } // namespace cluster
 } // namespace crete
 
@@ -1,6 +1,7 @@
 #include <crete/cluster/svm_node.h>
 #include <crete/exception.h>
 #include <crete/cluster/common.h>
+#include <crete/cluster/directory_stream.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -35,21 +36,23 @@ SVMNode::SVMNode(node::option::SVMNode node_options)
     add_instances(node_options_.svm.count);
 }
 
-auto SVMNode::run() -> void
+auto SVMNode::run() -> bool
 {
     if(!commenced())
     {
-        return;
+        return false;
     }
 
-    poll();
+    return poll();
 }
 
-auto SVMNode::poll() -> void
+auto SVMNode::poll() -> bool
 {
     using namespace node::svm;
+    using boost::msm::back::HANDLED_TRUE;
 
     auto any_active = false;
+    auto progressed = false;
 
     for(auto& svm : svms_)
     {
@@ -67,6 +70,8 @@ auto SVMNode::poll() -> void
             svm->process_event(ev::start{svm_working_dir_name
                                         ,master_options()
                                         ,node_options_});
+
+            progressed = true;
         }
         else if(svm->is_flag_active<flag::next_trace>())
         {
@@ -75,6 +80,8 @@ auto SVMNode::poll() -> void
                 auto t = pop_trace();
                 svm->process_event(ev::next_trace{t});
 
+                progressed = true;
+
 //                std::ofstream ofs{"trace-seq.txt", std::ios::app};
 //                ofs << t.filename().string() << "\n";
             }
@@ -84,16 +91,21 @@ auto SVMNode::poll() -> void
             push(svm->tests());
 
             svm->process_event(ev::tests_queued{});
+
+            progressed = true;
         }
         else
         {
-            svm->process_event(ev::poll{});
+            // Guards reject the poll while the current task (e.g. klee) is running.
+            progressed = HANDLED_TRUE == svm->process_event(ev::poll{}) || progressed;
         }
 
         any_active = any_active || svm->is_flag_active<flag::active>();
     }
 
     active(any_active);
+
+    return progressed;
 }
 
 auto SVMNode::traces_directory() const -> fs::path
@@ -202,22 +214,15 @@ auto receive_trace(AtomicGuard<SVMNode>& node,
     read_serialized_binary(sbuf,
                            trace_name);
 
-    auto trace = node.acquire()->traces_directory() / trace_name;
-
-    {
-        fs::ofstream ofs{trace,
-                         std::ios::out | std::ios::binary};
-
-        CRETE_EXCEPTION_ASSERT(ofs.good(),
-                               err::file_open_failed{trace.string()});
-
-        read(client,
-             ofs);
-    }
+    auto trace = fs::path{};
 
     try
     {
-        restore_directory(trace);
+        trace = receive_directory(client,
+                                  node.acquire()->traces_directory());
+
+        CRETE_EXCEPTION_ASSERT(trace.filename() == trace_name,
+                               err::invalid{trace.string()});
     }
     catch(std::exception& e)
     {
@@ -28,6 +28,9 @@
 
 #include <memory>
 
+#include <pthread.h>
+#include <signal.h>
+
 namespace bp = boost::process;
 namespace fs = boost::filesystem;
 namespace msm = boost::msm;
@@ -48,6 +51,10 @@ namespace svm
 const auto klee_dir_name = std::string{"klee-run"};
 const auto concolic_log_name = std::string{"concolic.log"};
 const auto symbolic_log_name = std::string{"klee-run.log"};
+const auto translator_log_name = std::string{"translator.log"};
+const auto solver_cache_name = std::string{"solver-cache.bin"};
+// Time a translator worker is given to exit once asked to, before it's killed.
+const auto translator_worker_stop_timeout = boost::posix_time::seconds(5);
 
 // +--------------------------------------------------+
 // + Exceptions                                       +
@@ -63,6 +70,183 @@ struct SymbolicExecException : public SVMException
     std::vector<TestCase> tests_;
 };
 
+// +--------------------------------------------------+
+// + Translator Worker                                +
+// +--------------------------------------------------+
+
+// Long-lived translator in --worker mode. It links the helper library once and
+// translates each trace by a forked process, so only the TBs of a trace are
+// translated and linked per trace.
+class TranslatorWorker
+{
+public:
+    TranslatorWorker() = default;
+    TranslatorWorker(const TranslatorWorker&) = delete;
+    TranslatorWorker& operator=(const TranslatorWorker&) = delete;
+    ~TranslatorWorker();
+
+    // Translates trace_dir into trace_dir/dump_llvm_offline.bc, launching the
+    // worker from exe if it is not running
+    auto translate(const std::string& exe
+                  ,const fs::path& trace_dir
+                  ,AtomicGuard<pid_t>& child_pid) -> void;
+
+private:
+    auto launch(const std::string& exe) -> void;
+    auto write_request(const std::string& line) -> bool;
+    auto read_reply() -> std::string;
+    auto stop() -> void;
+
+    std::unique_ptr<bp::child> proc_;
+};
+
+TranslatorWorker::~TranslatorWorker()
+{
+    try
+    {
+        stop();
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << "[CRETE ERROR] " << e.what() << std::endl;
+    }
+}
+
+auto TranslatorWorker::launch(const std::string& exe) -> void
+{
+    bp::context ctx;
+    ctx.environment = bp::self::get_environment();
+    ctx.stdin_behavior = bp::capture_stream();
+    ctx.stdout_behavior = bp::capture_stream();
+    ctx.stderr_behavior = bp::inherit_stream();
+
+    auto args = std::vector<std::string>{fs::absolute(exe).string(), "--worker"}; // It appears our modified QEMU requires full path in argv[0]...
+
+    proc_.reset(new bp::child{bp::launch(exe, args, ctx)});
+
+    if(read_reply() != "ready")
+    {
+        stop();
+
+        BOOST_THROW_EXCEPTION(SVMException{} << err::process{exe}
+                                             << err::msg{"translator worker failed to start"});
+    }
+}
+
+// False if the worker is gone. SIGPIPE is blocked in this thread for the write, and the one
+// raised by a failed write is discarded, so that a dead worker doesn't kill the node.
+auto TranslatorWorker::write_request(const std::string& line) -> bool
+{
+    sigset_t pipe_set;
+    sigset_t old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    auto& os = proc_->get_stdin();
+    os << line << std::endl;
+
+    auto written = static_cast<bool>(os);
+
+    const auto no_wait = timespec{0, 0};
+    while(sigtimedwait(&pipe_set, nullptr, &no_wait) > 0)
+    {
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+
+    return written;
+}
+
+// Empty if the worker is gone
+auto TranslatorWorker::read_reply() -> std::string
+{
+    auto line = std::string{};
+
+    if(!std::getline(proc_->get_stdout(), line))
+    {
+        return std::string{};
+    }
+
+    return line;
+}
+
+auto TranslatorWorker::stop() -> void
+{
+    if(!proc_)
+    {
+        return;
+    }
+
+    // EOF on stdin ends the worker
+    proc_->get_stdin().close();
+
+    auto pid = proc_->get_id();
+    auto deadline = boost::get_system_time() + translator_worker_stop_timeout;
+    auto killed = false;
+
+    while(process::is_running(pid))
+    {
+        if(!killed && boost::get_system_time() >= deadline)
+        {
+            std::cerr << "[CRETE] translator worker didn't exit, killing it" << std::endl;
+
+            ::kill(pid, SIGKILL);
+            killed = true;
+        }
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    proc_.reset();
+}
+
+auto TranslatorWorker::translate(const std::string& exe
+                                ,const fs::path& trace_dir
+                                ,AtomicGuard<pid_t>& child_pid) -> void
+{
+    // Crashed since the last trace
+    if(proc_ && !process::is_running(proc_->get_id()))
+    {
+        stop();
+    }
+
+    if(!proc_)
+    {
+        launch(exe);
+    }
+
+    auto dir = fs::absolute(trace_dir).string();
+
+    child_pid.acquire() = proc_->get_id();
+
+    // A failed write or EOF on the reply counts as a failed translation
+    auto reply = write_request(dir) ? read_reply() : std::string{};
+
+    child_pid.acquire() = -1;
+
+    if(reply == "done " + dir)
+    {
+        return;
+    }
+
+    if(reply.empty())
+    {
+        // Killed or crashed, which is relaunched for the next trace
+        stop();
+    }
+
+    auto log = std::string{};
+    {
+        fs::ifstream ifs(trace_dir / translator_log_name);
+        log.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    BOOST_THROW_EXCEPTION(SVMException{} << err::process_exit_status{exe}
+                                         << err::msg{log});
+}
+
 // +--------------------------------------------------+
 // + Events                                           +
 // +--------------------------------------------------+
@@ -216,6 +400,7 @@ private:
     crete::log::Logger exception_log_;
     log::NodeError error_log_;
     std::shared_ptr<AtomicGuard<pid_t> > translator_child_pid_ = std::make_shared<AtomicGuard<pid_t> >(-1);
+    std::shared_ptr<TranslatorWorker> translator_worker_ = std::make_shared<TranslatorWorker>();
     std::shared_ptr<AtomicGuard<pid_t> > klee_child_pid_ = std::make_shared<AtomicGuard<pid_t> >(-1);
 };
 
@@ -473,7 +658,8 @@ struct KleeFSM_::prepare
         ts.async_task_.reset(new AsyncTask{[](fs::path trace_dir
                                              ,cluster::option::Dispatch dispatch_options
                                              ,option::SVMNode node_options
-                                             ,std::shared_ptr<AtomicGuard<pid_t>> child_pid)
+                                             ,std::shared_ptr<AtomicGuard<pid_t>> child_pid
+                                             ,std::shared_ptr<TranslatorWorker> translator_worker)
         {
             fs::path dir = trace_dir;
             fs::path kdir = dir / klee_dir_name;
@@ -521,43 +707,42 @@ struct KleeFSM_::prepare
                                                       << err::arg_invalid_str{"vm.arch"});
                 }
 
-                auto args = std::vector<std::string>{fs::absolute(exe).string()}; // It appears our modified QEMU requires full path in argv[0]...
+                if(node_options.translator.persistent)
+                {
+                    translator_worker->translate(exe, dir, *child_pid);
+                }
+                else
+                {
+                    auto args = std::vector<std::string>{fs::absolute(exe).string()}; // It appears our modified QEMU requires full path in argv[0]...
 
-                auto proc = bp::launch(exe, args, ctx);
+                    auto proc = bp::launch(exe, args, ctx);
 
-                child_pid->acquire() = proc.get_id();
+                    child_pid->acquire() = proc.get_id();
 
-                // TODO: xxx Work-around to resolve the deadlock happened within the child process
-                // when its output is redirected.
-                auto& pistream = proc.get_stdout();
-                std::stringstream ss;
-                std::string line;
+                    // TODO: xxx Work-around to resolve the deadlock happened within the child process
+                    // when its output is redirected.
+                    auto& pistream = proc.get_stdout();
+                    std::stringstream ss;
+                    std::string line;
 
-                while(std::getline(pistream, line))
-                    ss << line;
+                    while(std::getline(pistream, line))
+                        ss << line;
 
-                auto status = proc.wait();
+                    auto status = proc.wait();
 
-                // FIXME: xxx Between 'auto status = proc.wait();' and this statement,
-                //           there is a chance this pid is reclaimed by other process.
-                child_pid->acquire() = -1;
+                    // FIXME: xxx Between 'auto status = proc.wait();' and this statement,
+                    //           there is a chance this pid is reclaimed by other process.
+                    child_pid->acquire() = -1;
 
-                if(!process::is_exit_status_zero(status))
-                {
-                    BOOST_THROW_EXCEPTION(SVMException{} << err::process_exit_status{exe}
-                                                         << err::msg{ss.str()});
+                    if(!process::is_exit_status_zero(status))
+                    {
+                        BOOST_THROW_EXCEPTION(SVMException{} << err::process_exit_status{exe}
+                                                             << err::msg{ss.str()});
+                    }
                 }
 
                 fs::rename(dir / "dump_llvm_offline.bc",
                            dir / "run.bc");
-
-//                fs::remove(dir / "dump_tcg_llvm_offline.*.bin");
-                for( fs::directory_iterator dir_iter(dir), end_iter ; dir_iter != end_iter ; ++dir_iter)
-                {
-                    std::string filename = dir_iter->path().filename().string();
-                    if(filename.find("dump_tcg_llvm_offline") != std::string::npos)
-                        fs::remove(dir/filename);
-                }
             }
 
             // 2. copy files into kdir
@@ -586,7 +771,8 @@ struct KleeFSM_::prepare
         , fsm.trace_dir_
         , fsm.dispatch_options_
         , fsm.node_options_
-        , fsm.translator_child_pid_});
+        , fsm.translator_child_pid_
+        , fsm.translator_worker_});
     }
 };
 
@@ -667,6 +853,32 @@ struct KleeFSM_::execute_symbolic
                        ,add_args.begin()
                        ,add_args.end());
 
+            // Solver results are shared by all the traces of this node, unless the
+            // dispatch options pick another cache file
+            if(std::none_of(add_args.begin(),
+                            add_args.end(),
+                            [](const std::string& s)
+                            {
+                                return s.find("solver-cache-file") != std::string::npos;
+                            }))
+            {
+                args.emplace_back("--solver-cache-file=" +
+                                  (trace_dir.parent_path() / solver_cache_name).string());
+            }
+
+            // Consecutive queries of the replayed path share their prefix of constraints,
+            // which an incremental solver keeps asserted (crete-klee ignores it when the
+            // dispatch options set a solver timeout)
+            if(std::none_of(add_args.begin(),
+                            add_args.end(),
+                            [](const std::string& s)
+                            {
+                                return s.find("incremental-solver") != std::string::npos;
+                            }))
+            {
+                args.emplace_back("--incremental-solver");
+            }
+
             args.emplace_back("run.bc");
 
             for(auto& e : args)
@@ -68,6 +68,7 @@ Translator::Translator(const pt::ptree& tree)
 
         path.x86 = trans.get<std::string>("path.x86", path.x86);
         path.x64 = trans.get<std::string>("path.x64", path.x64);
+        persistent = trans.get<bool>("persistent", persistent);
 
         auto proc = [](const std::string& p)
         {
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <stdexcept>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -16,6 +17,139 @@ namespace crete
 namespace cluster
 {
 
+namespace
+{
+
+/**
+ * @brief 128-bit FNV-1a.
+ */
+class FNV1a128
+{
+public:
+    auto process_bytes(const void* data, std::size_t size) -> void
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+
+        for(auto i = std::size_t{0}; i < size; ++i)
+        {
+            state_ ^= bytes[i];
+            state_ *= prime;
+        }
+    }
+
+    auto value() const -> TestHash
+    {
+        return TestHash{static_cast<uint64_t>(state_ >> 64),
+                        static_cast<uint64_t>(state_)};
+    }
+
+private:
+    using uint128 = unsigned __int128;
+
+    static constexpr uint128 prime = (uint128{1} << 88) + 0x13b;
+    static constexpr uint128 offset_basis = (uint128{0x6c62272e07bb0142ULL} << 64) + 0x62b821756295c58dULL;
+
+    uint128 state_ = offset_basis;
+};
+
+auto is_same_test(const TestCase& lhs, const TestCase& rhs) -> bool
+{
+    const auto& lelems = lhs.get_elements();
+    const auto& relems = rhs.get_elements();
+
+    return lelems.size() == relems.size()
+        && std::equal(lelems.begin(), lelems.end(),
+                      relems.begin(),
+                      [](const TestCaseElement& l, const TestCaseElement& r) {
+        return l.name_size == r.name_size
+            && l.name == r.name
+            && l.data_size == r.data_size
+            && l.data == r.data;
+    });
+}
+
+/**
+ * @brief Reads a test written by TestCase::write().
+ *
+ * Unlike crete::read_test_case(), sizes are only bounded by the file, so that every test the
+ * pool accepted (empty ones, or ones over 1MB) can be read back.
+ */
+class PoolTestReader
+{
+public:
+    PoolTestReader(std::istream& is, const fs::path& path, uint64_t size)
+        : is_(is)
+        , path_(path)
+        , remaining_{size}
+    {
+    }
+
+    auto read() -> TestCase
+    {
+        auto tc = TestCase{};
+        auto elem_count = read_size();
+
+        for(auto i = uint32_t{0}; i < elem_count; ++i)
+        {
+            auto elem = TestCaseElement{};
+
+            elem.name_size = read_size();
+            read_bytes(elem.name, elem.name_size);
+            elem.data_size = read_size();
+            read_bytes(elem.data, elem.data_size);
+
+            tc.add_element(elem);
+        }
+
+        return tc;
+    }
+
+private:
+    auto read_size() -> uint32_t
+    {
+        auto size = uint32_t{0};
+        check_remaining(sizeof(size));
+        is_.read(reinterpret_cast<char*>(&size), sizeof(size));
+        check_stream();
+
+        return size;
+    }
+
+    auto read_bytes(std::vector<uint8_t>& bytes, uint32_t size) -> void
+    {
+        check_remaining(size);
+        bytes.resize(size);
+        is_.read(reinterpret_cast<char*>(bytes.data()), size);
+        check_stream();
+    }
+
+    auto check_remaining(uint64_t size) -> void
+    {
+        if(size > remaining_)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::file{path_.string()}
+                                              << err::msg{"truncated test case"});
+        }
+
+        remaining_ -= size;
+    }
+
+    auto check_stream() -> void
+    {
+        if(!is_.good())
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::file{path_.string()}
+                                              << err::msg{"failed to read test case"});
+        }
+    }
+
+    std::istream& is_;
+    const fs::path& path_;
+    uint64_t remaining_;
+};
+
+} // namespace
+
 TestPool::TestPool(const fs::path& root)
     : random_engine_{std::time(0)}
     , root_{root}
@@ -30,10 +164,10 @@ auto TestPool::next() -> boost::optional<TestCase>
     }
 
     // FIFO:
-    auto tc = next_.back();
+    auto tc_index = next_.back();
     next_.pop_back();
 
-    return boost::optional<TestCase>{tc};
+    return boost::optional<TestCase>{read_test_case(tc_index)};
 
     // Random:
 //    std::uniform_int_distribution<size_t> dist{0,
@@ -53,7 +187,7 @@ auto TestPool::insert(const TestCase& tc) -> bool
 {
     if(insert_tc_tree(tc))
     {
-        next_.push_front(tc);
+        next_.push_front(test_tree_.size());
         return true;
     }
 
@@ -62,13 +196,19 @@ auto TestPool::insert(const TestCase& tc) -> bool
 
 auto TestPool::insert(const TestCase& tc, const TestCase& input_tc) -> bool
 {
-    if(insert_tc_tree(tc, input_tc))
+    return insert(tc,
+                  find(input_tc, to_test_hash(input_tc)));
+}
+
+auto TestPool::insert(const TestCase& tc, const uint64_t input_tc_index) -> bool
+{
+    if(insert_tc_tree(tc, input_tc_index))
     {
-        next_.push_front(tc);
+        next_.push_front(test_tree_.size());
         return true;
     }
 
-    return false;;
+    return false;
 }
 
 auto TestPool::insert(const std::vector<TestCase>& tcs) -> void
@@ -81,9 +221,11 @@ auto TestPool::insert(const std::vector<TestCase>& tcs) -> void
 
 auto TestPool::insert(const std::vector<TestCase>& new_tcs, const TestCase& input_tc) -> void
 {
+    auto input_tc_index = find(input_tc, to_test_hash(input_tc));
+
     for(const auto& tc : new_tcs)
     {
-        insert(tc, input_tc);
+        insert(tc, input_tc_index);
     }
 }
 
@@ -91,6 +233,7 @@ auto TestPool::clear() -> void
 {
     next_.clear();
     test_tree_.clear();
+    test_indexes_.clear();
 }
 
 auto TestPool::count_all() const -> size_t
@@ -105,27 +248,30 @@ auto TestPool::count_next() const -> size_t
 
 auto TestPool::write_tc_tree(std::ostream& os) -> void const
 {
-    for(boost::unordered_map<TestHash, TestCaseTreeNode>::const_iterator it = test_tree_.begin();
+    for(std::vector<TestCaseTreeNode>::const_iterator it = test_tree_.begin();
             it != test_tree_.end(); ++it) {
-        os << "Node tc-" << it->second.m_tc_index << ": [";
-        for(std::vector<uint64_t>::const_iterator c_it = it->second.m_childern_tc_indexes.begin();
-                c_it != it->second.m_childern_tc_indexes.end(); ++c_it) {
+        os << "Node tc-" << it->m_tc_index << ": [";
+        for(std::vector<uint64_t>::const_iterator c_it = it->m_childern_tc_indexes.begin();
+                c_it != it->m_childern_tc_indexes.end(); ++c_it) {
             os << *c_it << " ";
         }
         os << "]\n";
     }
 }
 
+auto TestPool::test_case_path(const uint64_t tc_index) const -> fs::path
+{
+    return root_ / "test-case" / std::to_string(tc_index);
+}
+
 auto TestPool::write_test_case(const TestCase& tc, const uint64_t tc_index) -> void
 {
     namespace fs = boost::filesystem;
 
-    auto tc_root = root_ / "test-case";
-
-    if(!fs::exists(tc_root))
-        fs::create_directories(tc_root);
+    auto path = test_case_path(tc_index);
 
-    auto path = tc_root / std::to_string(tc_index);
+    if(!fs::exists(path.parent_path()))
+        fs::create_directories(path.parent_path());
 
     assert(!fs::exists(path) && "[Test Pool] Duplicate test case name.\n");
     fs::ofstream ofs(path,
@@ -139,49 +285,94 @@ auto TestPool::write_test_case(const TestCase& tc, const uint64_t tc_index) -> v
     tc.write(ofs);
 }
 
+auto TestPool::read_test_case(const uint64_t tc_index) const -> TestCase
+{
+    auto path = test_case_path(tc_index);
+
+    fs::ifstream ifs(path,
+                     std::ios_base::in | std::ios_base::binary);
+
+    if(!ifs.good())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{path.string()});
+    }
+
+    return PoolTestReader{ifs, path, fs::file_size(path)}.read();
+}
+
 auto TestPool::insert_tc_tree(const TestCase& tc) -> bool
 {
-    std::string test_hash = to_test_hash(tc);
-    if(test_tree_.find(test_hash) != test_tree_.end())
+    auto test_hash = to_test_hash(tc);
+    if(find(tc, test_hash) != 0)
     {
         return false;
     }
 
     // Add node to tc_tree_ for this new tc
-    test_tree_[test_hash] = TestCaseTreeNode();
-    test_tree_[test_hash].m_tc_index = test_tree_.size();
-    write_test_case(tc, test_tree_[test_hash].m_tc_index);
+    test_tree_.emplace_back();
+    test_tree_.back().m_tc_index = test_tree_.size();
+    test_indexes_.emplace(test_hash, test_tree_.back().m_tc_index);
+    write_test_case(tc, test_tree_.back().m_tc_index);
 
     return true;
 }
 
-auto TestPool::insert_tc_tree(const TestCase& tc, const TestCase& input_tc) -> bool
+auto TestPool::insert_tc_tree(const TestCase& tc, const uint64_t input_tc_index) -> bool
 {
-    std::string test_hash = to_test_hash(tc);
-    if(test_tree_.find(test_hash) != test_tree_.end())
+    // The input tc may not be in the pool (e.g., tests of a previous target, received after
+    // clear()), in which case the new tc is a root of the tree.
+    if(input_tc_index == 0 || input_tc_index > test_tree_.size())
     {
-        return false;
+        return insert_tc_tree(tc);
     }
 
-    // Add node to tc_tree_ for this new tc
-    test_tree_[test_hash] = TestCaseTreeNode();
-    test_tree_[test_hash].m_tc_index = test_tree_.size();
-    write_test_case(tc, test_tree_[test_hash].m_tc_index);
+    if(!insert_tc_tree(tc))
+    {
+        return false;
+    }
 
     // Set the parent tc_tree_node for this new
-    std::string input_tc_hash = to_test_hash(input_tc);
-    assert(test_tree_.find(input_tc_hash) != test_tree_.end());
-    test_tree_[input_tc_hash].m_childern_tc_indexes.push_back(test_tree_[test_hash].m_tc_index);
+    test_tree_.back().m_parent_tc_index = input_tc_index;
+    test_tree_[input_tc_index - 1].m_childern_tc_indexes.push_back(test_tree_.back().m_tc_index);
 
     return true;
 }
 
-auto TestPool::to_test_hash(const TestCase& tc) -> TestHash
+auto TestPool::find(const TestCase& tc, const TestHash& hash) const -> uint64_t
+{
+    auto range = test_indexes_.equal_range(hash);
+
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        // A different test sharing the hash is kept, as an entry of its own.
+        if(is_same_test(tc, read_test_case(it->second)))
+        {
+            return it->second;
+        }
+    }
+
+    return 0;
+}
+
+auto TestPool::to_test_hash(const TestCase& tc) const -> TestHash
 {
-    std::stringstream ss;
-    tc.write(ss);
+    // Hashes what TestCase::write() serializes, without building the serialization.
+    FNV1a128 hash;
+
+    const auto& elems = tc.get_elements();
+    auto elem_count = static_cast<uint32_t>(elems.size());
+
+    hash.process_bytes(&elem_count, sizeof(uint32_t));
+
+    for(const auto& elem : elems)
+    {
+        hash.process_bytes(&elem.name_size, sizeof(uint32_t));
+        hash.process_bytes(elem.name.data(), elem.name.size());
+        hash.process_bytes(&elem.data_size, sizeof(uint32_t));
+        hash.process_bytes(elem.data.data(), elem.data.size());
+    }
 
-    return ss.str();
+    return hash.value();
 }
 
 } // namespace cluster
@@ -64,7 +64,7 @@ void TracePool::print_elf_info(const std::set<fs::path>& traces)
 
 void TracePool::print_elf_info(const filesystem::path& trace_path)
 {
-    fs::path bin_seq = trace_path / "tb-seq.bin";
+    fs::path bin_seq = trace_path / "dump_trace.bin";
     fs::path elf_seq = trace_path / "tb-seq-elf.txt";
 
     fs::path pm_path = "guest-data/proc_maps.log";
@@ -219,7 +219,7 @@ auto TracePool::next() -> optional<TracePool::TracePath>
 
     if(trace)
     {
-        trace_analyzer_.submit_executed(parse_trace((*trace)/"tb-seq.bin"));
+        trace_analyzer_.submit_executed(parse_trace((*trace)/"dump_trace.bin"));
     }
 
     if(options_.trace.print_trace_selection)
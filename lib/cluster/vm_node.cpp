@@ -41,21 +41,23 @@ VMNode::VMNode(const node::option::VMNode& node_options,
     add_instances(node_options_.vm.count);
 }
 
-auto VMNode::run() -> void
+auto VMNode::run() -> bool
 {
     if(!commenced())
     {
-        return;
+        return false;
     }
 
-    poll();
+    return poll();
 }
 
-auto VMNode::poll() -> void
+auto VMNode::poll() -> bool
 {
     using namespace node::vm;
+    using boost::msm::back::HANDLED_TRUE;
 
     auto any_active = false;
+    auto progressed = false;
 
     for(auto& vm : vms_)
     {
@@ -83,12 +85,16 @@ auto VMNode::poll() -> void
             };
 
             vm->process_event(start_ev);
+
+            progressed = true;
         }
         else if(vm->is_flag_active<flag::trace_ready>())
         {
             push(vm->trace());
 
             vm->process_event(ev::trace_queued{});
+
+            progressed = true;
         }        
         else if(vm->is_flag_active<flag::next_test>())
         {
@@ -96,20 +102,24 @@ auto VMNode::poll() -> void
 
             if(has_tests)
             {
-                using boost::msm::back::HANDLED_TRUE;
-
                 auto t = pop_test();
 
                 if(HANDLED_TRUE != vm->process_event(ev::next_test{t}))
                 {
                     push(t);
                 }
+                else
+                {
+                    progressed = true;
+                }
             }
         }
         else if(vm->is_flag_active<flag::guest_data_rxed>())
         {
             guest_data_ = vm->guest_data();
             vm->process_event(ev::poll{});
+
+            progressed = true;
         }
         else if(vm->is_flag_active<flag::terminated>())
         {
@@ -117,7 +127,8 @@ auto VMNode::poll() -> void
         }
         else
         {
-            vm->process_event(ev::poll{});
+            // Guards reject the poll while the current task or test is running.
+            progressed = HANDLED_TRUE == vm->process_event(ev::poll{}) || progressed;
         }
 
         any_active = any_active
@@ -126,6 +137,8 @@ auto VMNode::poll() -> void
     }
 
     active(any_active);
+
+    return progressed;
 }
 
 auto VMNode::start_FSMs() -> void
@@ -384,12 +397,10 @@ auto receive_image(AtomicGuard<VMNode>& node,
         fs::remove(image_path);
     }
 
-    fs::ofstream ofs{image_path};
-
-    CRETE_EXCEPTION_ASSERT(ofs.good(), err::file_open_failed{image_path.string()});
+    auto pkinfo = client.read_file(image_path);
 
-    read(client,
-         ofs);
+    CRETE_EXCEPTION_ASSERT(pkinfo.type == packet_type::cluster_image,
+                           err::network_type_mismatch(pkinfo.type));
 
     std::cout << "receive_image: success" << std::endl;
 }
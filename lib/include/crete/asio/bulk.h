@@ -0,0 +1,403 @@
+#ifndef CRETE_ASIO_BULK_H
+#define CRETE_ASIO_BULK_H
+
+#include <crete/asio/common.h>
+#include <crete/exception.h>
+
+#include <boost/asio.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <zlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace crete
+{
+namespace bulk
+{
+
+/**
+ * Bulk transfers are framed as:
+ *
+ *  - the PacketInfo header, of size the length of the payload;
+ *  - the payload;
+ *  - a CRC-32 of the header and the payload (little-endian uint32_t).
+ *
+ * read_bulk() refuses packets larger than bulk_buffer_size before allocating for them, so
+ * write_bulk() is meant for payloads of at most that size.
+ *
+ * Unlike the chunked streaming of common.h (write()/read()), the payload isn't cut into
+ * default_chunk_size packets: buffers are gathered into a single write, and files are
+ * handed to the kernel with sendfile(2) instead of being copied through user space.
+ *
+ * Both ends must agree on the framing: a packet written by write_bulk()/write_file() is to
+ * be read by read_bulk()/read_file().
+ *
+ * The functions are shared by Server and ClientImpl, which forward to them with their socket.
+ */
+
+typedef std::vector<boost::asio::const_buffer> ConstBuffers;
+
+/**
+ * @brief CRC-32 of a payload.
+ *
+ * zlib's implementation is used over boost::crc_32_type, which is several times slower and
+ * would bound the throughput of the transfers.
+ */
+class Checksum
+{
+public:
+    Checksum() : crc_(::crc32(0L, Z_NULL, 0)) {}
+
+    void process_bytes(const void* data, size_t size)
+    {
+        const Bytef* bytes = static_cast<const Bytef*>(data);
+
+        // zlib takes 32-bit lengths.
+        while(size > 0)
+        {
+            uInt count = static_cast<uInt>(std::min<size_t>(size, std::numeric_limits<uInt>::max()));
+
+            crc_ = ::crc32(crc_, bytes, count);
+
+            bytes += count;
+            size -= count;
+        }
+    }
+
+    uint32_t checksum() const
+    {
+        return static_cast<uint32_t>(crc_);
+    }
+
+private:
+    uLong crc_;
+};
+
+inline
+void encode_checksum(uint32_t crc, uint8_t (&out)[sizeof(uint32_t)])
+{
+    for(size_t i = 0; i < sizeof(uint32_t); ++i)
+    {
+        out[i] = static_cast<uint8_t>(crc >> (8 * i));
+    }
+}
+
+inline
+uint32_t decode_checksum(const uint8_t (&in)[sizeof(uint32_t)])
+{
+    uint32_t crc = 0;
+
+    for(size_t i = 0; i < sizeof(uint32_t); ++i)
+    {
+        crc |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+
+    return crc;
+}
+
+template <typename Socket>
+void read_checksum(Socket& socket,
+                   const Checksum& checksum)
+{
+    uint8_t trailer[sizeof(uint32_t)];
+
+    boost::asio::read(socket,
+                      boost::asio::buffer(trailer));
+
+    CRETE_EXCEPTION_ASSERT(decode_checksum(trailer) == checksum.checksum(),
+                           err::network("checksum mismatch on bulk transfer"));
+}
+
+// Waits for the socket to accept more data, in case asio left its descriptor non-blocking.
+inline
+void wait_writable(int fd)
+{
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    while(::poll(&pfd, 1, -1) < 0)
+    {
+        CRETE_EXCEPTION_ASSERT(errno == EINTR,
+                               err::network("poll() failed on bulk transfer"));
+    }
+}
+
+/**
+ * @brief Sends 'buffers' as one packet, with a single gathered write.
+ * @return the size of the payload.
+ */
+template <typename Socket>
+size_t write_bulk(Socket& socket,
+                  const ConstBuffers& buffers,
+                  PacketInfo pkinfo)
+{
+    pkinfo.size = boost::asio::buffer_size(buffers);
+
+    CRETE_EXCEPTION_ASSERT(pkinfo.size <= bulk_buffer_size,
+                           err::network("bulk packet larger than bulk_buffer_size"));
+
+    Checksum checksum;
+    checksum.process_bytes(&pkinfo, sizeof(PacketInfo));
+
+    for(ConstBuffers::const_iterator it = buffers.begin();
+        it != buffers.end();
+        ++it)
+    {
+        checksum.process_bytes(boost::asio::buffer_cast<const void*>(*it),
+                               boost::asio::buffer_size(*it));
+    }
+
+    uint8_t trailer[sizeof(uint32_t)];
+    encode_checksum(checksum.checksum(), trailer);
+
+    ConstBuffers frame;
+    frame.reserve(buffers.size() + 2);
+    frame.push_back(boost::asio::buffer(reinterpret_cast<const uint8_t*>(&pkinfo),
+                                        sizeof(PacketInfo)));
+    frame.insert(frame.end(), buffers.begin(), buffers.end());
+    frame.push_back(boost::asio::buffer(trailer));
+
+    size_t nsent = boost::asio::write(socket,
+                                      frame);
+
+    CRETE_EXCEPTION_ASSERT(nsent == sizeof(PacketInfo) + pkinfo.size + sizeof(trailer),
+                           err::network("failed to send entire bulk packet"));
+
+    return pkinfo.size;
+}
+
+/**
+ * @brief Receives a packet sent by write_bulk() into 'buf', verifying its checksum.
+ */
+template <typename Socket>
+PacketInfo read_bulk(Socket& socket,
+                     std::vector<char>& buf)
+{
+    PacketInfo pkinfo;
+
+    boost::asio::read(socket,
+                      boost::asio::buffer(reinterpret_cast<uint8_t*>(&pkinfo),
+                                          sizeof(PacketInfo)));
+
+    // The header isn't verified until the trailer is read, so its size is bounded first.
+    CRETE_EXCEPTION_ASSERT(pkinfo.size <= bulk_buffer_size,
+                           err::network("bulk packet larger than bulk_buffer_size"));
+
+    buf.resize(pkinfo.size);
+
+    if(!buf.empty())
+    {
+        boost::asio::read(socket,
+                          boost::asio::buffer(buf));
+    }
+
+    Checksum checksum;
+    checksum.process_bytes(&pkinfo, sizeof(PacketInfo));
+    checksum.process_bytes(buf.data(), buf.size());
+
+    read_checksum(socket, checksum);
+
+    return pkinfo;
+}
+
+/**
+ * @brief Sends the contents of the file at 'path' as one packet, using sendfile(2).
+ * @param progress if set, called as the file is sent.
+ * @return the size of the file.
+ *
+ * The checksum is computed from a buffered read of the file, after it's sent, when it's
+ * in the page cache.
+ */
+template <typename Socket>
+uint64_t write_file(Socket& socket,
+                    const boost::filesystem::path& path,
+                    PacketInfo pkinfo,
+                    const StreamProgress& progress = StreamProgress())
+{
+    int fd = ::open(path.string().c_str(), O_RDONLY);
+
+    CRETE_EXCEPTION_ASSERT(fd >= 0, err::file_open_failed(path.string()));
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+
+        BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path.string()));
+    }
+
+    pkinfo.size = static_cast<uint64_t>(st.st_size);
+
+    boost::asio::write(socket,
+                       boost::asio::buffer(reinterpret_cast<const uint8_t*>(&pkinfo),
+                                           sizeof(PacketInfo)));
+
+    int sock_fd = socket.native_handle();
+    off_t offset = 0;
+
+    while(static_cast<uint64_t>(offset) < pkinfo.size)
+    {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(pkinfo.size - offset,
+                                                              bulk_buffer_size));
+
+        ssize_t nsent = ::sendfile(sock_fd, fd, &offset, count);
+
+        if(nsent < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            wait_writable(sock_fd);
+
+            continue;
+        }
+
+        if(nsent <= 0)
+        {
+            ::close(fd);
+
+            BOOST_THROW_EXCEPTION(Exception() << err::network("sendfile() failed on: " + path.string()));
+        }
+
+        if(progress)
+        {
+            progress(static_cast<uint64_t>(offset), pkinfo.size);
+        }
+    }
+
+    Checksum checksum;
+    checksum.process_bytes(&pkinfo, sizeof(PacketInfo));
+    std::vector<char> buf(bulk_buffer_size);
+
+    for(off_t pos = 0; static_cast<uint64_t>(pos) < pkinfo.size;)
+    {
+        ssize_t nread = ::pread(fd, buf.data(), buf.size(), pos);
+
+        if(nread < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(nread <= 0)
+        {
+            ::close(fd);
+
+            BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path.string()));
+        }
+
+        checksum.process_bytes(buf.data(), static_cast<size_t>(nread));
+        pos += nread;
+    }
+
+    ::close(fd);
+
+    uint8_t trailer[sizeof(uint32_t)];
+    encode_checksum(checksum.checksum(), trailer);
+
+    boost::asio::write(socket,
+                       boost::asio::buffer(trailer));
+
+    return pkinfo.size;
+}
+
+/**
+ * @brief Receives a packet sent by write_file() into the file at 'path', verifying its checksum.
+ * @param progress if set, called as the file is received.
+ *
+ * The file is truncated if it exists.
+ */
+template <typename Socket>
+PacketInfo read_file(Socket& socket,
+                     const boost::filesystem::path& path,
+                     const StreamProgress& progress = StreamProgress())
+{
+    PacketInfo pkinfo;
+
+    boost::asio::read(socket,
+                      boost::asio::buffer(reinterpret_cast<uint8_t*>(&pkinfo),
+                                          sizeof(PacketInfo)));
+
+    // The header isn't verified until the trailer is read, so a size that can't be written
+    // is refused up front, rather than filling the disk.
+    boost::filesystem::path dir = boost::filesystem::absolute(path).parent_path();
+
+    CRETE_EXCEPTION_ASSERT(pkinfo.size <= boost::filesystem::space(dir).available,
+                           err::network("bulk file larger than the space available for it"));
+
+    int fd = ::open(path.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    CRETE_EXCEPTION_ASSERT(fd >= 0, err::file_open_failed(path.string()));
+
+    Checksum checksum;
+    checksum.process_bytes(&pkinfo, sizeof(PacketInfo));
+    std::vector<char> buf(bulk_buffer_size);
+    uint64_t received = 0;
+
+    while(received < pkinfo.size)
+    {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(pkinfo.size - received,
+                                                              buf.size()));
+        boost::system::error_code error;
+
+        boost::asio::read(socket,
+                          boost::asio::buffer(buf.data(), count),
+                          error);
+
+        if(error)
+        {
+            ::close(fd);
+
+            throw boost::system::system_error(error);
+        }
+
+        checksum.process_bytes(buf.data(), count);
+
+        for(size_t written = 0; written < count;)
+        {
+            ssize_t n = ::write(fd, buf.data() + written, count - written);
+
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if(n <= 0)
+            {
+                ::close(fd);
+
+                BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path.string()));
+            }
+
+            written += static_cast<size_t>(n);
+        }
+
+        received += count;
+
+        if(progress)
+        {
+            progress(received, pkinfo.size);
+        }
+    }
+
+    ::close(fd);
+
+    read_checksum(socket, checksum);
+
+    return pkinfo;
+}
+
+} // namespace bulk
+} // namespace crete
+
+#endif // CRETE_ASIO_BULK_H
@@ -22,6 +22,7 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/asio.hpp>
+#include <boost/function.hpp>
 
 #include <crete/util/util.h>
 #include <crete/exception.h>
@@ -36,9 +37,13 @@ namespace crete
 
 const size_t asio_max_msg_size = 32;
 const uint32_t default_chunk_size = 1024;
+// Size of the buffers of bulk transfers (see bulk.h).
+const size_t bulk_buffer_size = 1024 * 1024;
 
 typedef unsigned short Port;
 typedef std::string IPAddress;
+// Reports the progress of a streamed file: (bytes streamed so far, stream size).
+typedef boost::function<void (uint64_t, uint64_t)> StreamProgress;
 
 namespace packet_type // Not an enum b/c pre-C++11 enums size types are impl-defined.
 {
@@ -72,6 +77,7 @@ const uint32_t chunk = 27;
 const uint32_t file_stream = 28;
 const uint32_t cluster_request_guest_data = 29;
 const uint32_t cluster_tx_guest_data = 30;
+const uint32_t directory_stream = 31;
 }
 
 struct PacketInfo
@@ -268,23 +274,25 @@ void read_serialized_text(
  * @param is stream with data to send
  * @param chunk_size amount of data to send at each increment. Pay careful attention here to avoid
  *        resource issues. Each packet can only be reasonably expected to send a certain amount of data.
+ * @param progress if set, called after each chunk sent.
  *
  * @pre connection represents a valid condition
  * @post is.tellg == std::ios::end
  *
  * @note 1. Chunks are not compressed. Future experimentation should be done to determine if doing so
  *          would be more efficient. It would be very simple to integrate with boost::iostreams compression.
- * @note 2. It would be nice if this took an optional logger to report on progress (% sent), for very large
- *          files that take an exceedingly long time (e.g., OS images).
+ * @note 2. 'progress' is there to report on very large files that take an exceedingly long time (e.g., OS images).
  */
 template<typename Connection>
 void write(Connection& connection,
            std::istream& is,
-           std::size_t chunk_size)
+           std::size_t chunk_size,
+           const StreamProgress& progress = StreamProgress())
 {
     std::vector<char> buf;
     std::size_t count = 0;
     std::streamsize bytes_read = 0;
+    uint64_t bytes_sent = 0;
     std::istream::pos_type stream_size = util::stream_size(is);
 
     // TODO: C++11: std::numeric_limits<decltype(chunk_size)>::max >= std::numeric_limits<std::vector::size_type>::max();
@@ -324,13 +332,21 @@ void write(Connection& connection,
                                    err::network("failed to send requested number of bytes"));
 
             ++count;
+
+            bytes_sent += bytes_written;
+
+            if(progress)
+            {
+                progress(bytes_sent, static_cast<uint64_t>(stream_size));
+            }
         }
     }while(bytes_read > 0);
 }
 
 template<typename Connection>
 void read(Connection& connection,
-          std::ostream& os)
+          std::ostream& os,
+          const StreamProgress& progress = StreamProgress())
 {
     PacketInfo pkinfo = connection.read();
 
@@ -361,6 +377,11 @@ void read(Connection& connection,
 
         os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
 
+        if(progress)
+        {
+            progress(bytes_written, stream_size);
+        }
+
     }while(bytes_written != stream_size);
 
     os.flush(); // Seems to be a bug in gcc-4.6. Destructor doesn't always call close/flush.
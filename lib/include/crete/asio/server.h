@@ -37,6 +37,15 @@ public:
     PacketInfo read(std::vector<char>& buf);
     PacketInfo read(boost::asio::streambuf& sbuf);
     PacketInfo read();
+    // Bulk transfers: see crete/asio/bulk.h.
+    size_t write_bulk(const std::vector<boost::asio::const_buffer>& buffers,
+                      const PacketInfo& pkinfo);
+    PacketInfo read_bulk(std::vector<char>& buf);
+    uint64_t write_file(const boost::filesystem::path& path,
+                        const PacketInfo& pkinfo,
+                        const StreamProgress& progress = StreamProgress());
+    PacketInfo read_file(const boost::filesystem::path& path,
+                         const StreamProgress& progress = StreamProgress());
 
     /// Handler signature: void handler(const boost::system::error_code&);
     template <typename Handler>
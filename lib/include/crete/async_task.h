@@ -1,6 +1,8 @@
 #ifndef CRETE_ASYNC_TASK_H
 #define CRETE_ASYNC_TASK_H
 
+#include <crete/reactor.h>
+
 #include <boost/thread.hpp>
 #include <atomic>
 #include <iostream>
@@ -65,6 +67,9 @@ AsyncTask::AsyncTask(Func f,
         }
 
         finished_flag_.exchange(true, std::memory_order_seq_cst);
+
+        // Whoever polls is_finished() may be blocked in a reactor.
+        Reactor::notify_all();
     };
 
     thread_ = boost::thread{wrapper, f};
@@ -145,9 +145,6 @@ struct Trace
     }
 };
 
-auto archive_directory(const boost::filesystem::path& dir) -> void;
-auto restore_directory(const boost::filesystem::path& dir) -> void;
-
 struct NodeRequest
 {
     NodeRequest(PacketInfo& pkinfo,
@@ -0,0 +1,245 @@
+#ifndef CRETE_CLUSTER_DIRECTORY_STREAM_H
+#define CRETE_CLUSTER_DIRECTORY_STREAM_H
+
+#include <crete/asio/common.h>
+#include <crete/exception.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/categories.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace crete
+{
+namespace cluster
+{
+
+// Size of the compressed chunks a directory is streamed in.
+const auto directory_chunk_size = bulk_buffer_size;
+
+/**
+ * Directories (traces) are sent between dispatch and the nodes as an archive that is
+ * compressed and written to the connection as it's produced, and restored as it's received,
+ * so that it's never staged on disk on either side:
+ *
+ *  - a packet_type::directory_stream header, of size the total size of the files;
+ *  - packet_type::chunk bulk packets of the zlib-compressed archive (see write_directory()),
+ *    each checksummed (see crete/asio/bulk.h);
+ *  - an empty packet_type::chunk bulk packet, marking the end.
+ *
+ * zlib at its fastest level stands in for a faster codec (e.g., LZ4), which isn't
+ * among the dependencies.
+ */
+
+auto directory_size(const boost::filesystem::path& dir) -> uint64_t;
+// Writes the archive of 'dir' to 'os'. 'progress' is given the bytes of files written so far.
+auto write_directory(const boost::filesystem::path& dir,
+                     std::ostream& os,
+                     uint64_t total_size,
+                     const StreamProgress& progress = StreamProgress{}) -> void;
+// Restores, under 'parent', the directory archived by write_directory() in 'is'. Returns its path.
+auto read_directory(std::istream& is,
+                    const boost::filesystem::path& parent,
+                    uint64_t total_size,
+                    const StreamProgress& progress = StreamProgress{}) -> boost::filesystem::path;
+
+template <typename Connection>
+auto transmit_directory(Connection& connection,
+                        const boost::filesystem::path& dir,
+                        const StreamProgress& progress = StreamProgress{}) -> void;
+template <typename Connection>
+auto receive_directory(Connection& connection,
+                       const boost::filesystem::path& parent,
+                       const StreamProgress& progress = StreamProgress{}) -> boost::filesystem::path;
+
+/**
+ * @brief Sink device writing each buffer it's given as a chunk bulk packet.
+ */
+template <typename Connection>
+class ChunkSink
+{
+public:
+    using char_type = char;
+    using category = boost::iostreams::sink_tag;
+
+    explicit ChunkSink(Connection& connection) : connection_(&connection) {}
+
+    auto write(const char* s, std::streamsize n) -> std::streamsize
+    {
+        auto pkinfo = PacketInfo{0,0,0};
+        pkinfo.type = packet_type::chunk;
+
+        // Sent straight from the stream's buffer.
+        auto sent = connection_->write_bulk({boost::asio::buffer(s, static_cast<std::size_t>(n))},
+                                            pkinfo);
+
+        CRETE_EXCEPTION_ASSERT(sent == static_cast<std::size_t>(n),
+                               err::network("failed to send requested number of bytes"));
+
+        return n;
+    }
+
+private:
+    Connection* connection_;
+};
+
+/**
+ * @brief Source device reading chunk bulk packets, up to the empty one.
+ *
+ * Copies share their state, so that the stream can be drained through the original
+ * once a copy is pushed onto a filtering stream.
+ */
+template <typename Connection>
+class ChunkSource
+{
+public:
+    using char_type = char;
+    using category = boost::iostreams::source_tag;
+
+    explicit ChunkSource(Connection& connection) :
+        connection_(&connection),
+        state_(std::make_shared<State>())
+    {}
+
+    auto read(char* s, std::streamsize n) -> std::streamsize
+    {
+        auto& st = *state_;
+
+        while(st.pos == st.buf.size())
+        {
+            if(st.done)
+            {
+                return -1;
+            }
+
+            auto pkinfo = connection_->read_bulk(st.buf);
+
+            CRETE_EXCEPTION_ASSERT(pkinfo.type == packet_type::chunk,
+                                   err::network_type_mismatch(pkinfo.type));
+
+            st.pos = 0;
+            st.done = pkinfo.size == 0;
+        }
+
+        auto count = std::min(static_cast<std::size_t>(n),
+                              st.buf.size() - st.pos);
+
+        std::copy(st.buf.begin() + st.pos,
+                  st.buf.begin() + st.pos + count,
+                  s);
+
+        st.pos += count;
+
+        return static_cast<std::streamsize>(count);
+    }
+
+    // Consumes the rest of the stream, e.g. what follows the end of the compressed data.
+    auto drain() -> void
+    {
+        auto& st = *state_;
+
+        st.pos = st.buf.size();
+
+        char c;
+        while(read(&c, 1) != -1)
+        {
+            st.pos = st.buf.size();
+        }
+    }
+
+private:
+    struct State
+    {
+        std::vector<char> buf;
+        std::size_t pos = 0;
+        bool done = false;
+    };
+
+    Connection* connection_;
+    std::shared_ptr<State> state_;
+};
+
+template <typename Connection>
+auto transmit_directory(Connection& connection,
+                        const boost::filesystem::path& dir,
+                        const StreamProgress& progress) -> void
+{
+    namespace bio = boost::iostreams;
+
+    auto total_size = directory_size(dir);
+
+    {
+        auto pkinfo = PacketInfo{0,0,0};
+        pkinfo.type = packet_type::directory_stream;
+        pkinfo.size = total_size;
+
+        connection.write(pkinfo);
+    }
+
+    {
+        bio::filtering_ostream os;
+
+        os.push(bio::zlib_compressor{bio::zlib_params{bio::zlib::best_speed}},
+                directory_chunk_size);
+        os.push(ChunkSink<Connection>{connection},
+                directory_chunk_size);
+
+        write_directory(dir,
+                        os,
+                        total_size,
+                        progress);
+
+        // Flushes the compressor's last block into the connection.
+        os.reset();
+    }
+
+    auto pkinfo = PacketInfo{0,0,0};
+    pkinfo.type = packet_type::chunk;
+
+    connection.write_bulk({},
+                          pkinfo);
+}
+
+template <typename Connection>
+auto receive_directory(Connection& connection,
+                       const boost::filesystem::path& parent,
+                       const StreamProgress& progress) -> boost::filesystem::path
+{
+    namespace bio = boost::iostreams;
+
+    auto pkinfo = connection.read();
+
+    CRETE_EXCEPTION_ASSERT(pkinfo.type == packet_type::directory_stream,
+                           err::network_type_mismatch(pkinfo.type));
+
+    auto source = ChunkSource<Connection>{connection};
+    auto dir = boost::filesystem::path{};
+
+    {
+        bio::filtering_istream is;
+
+        is.push(bio::zlib_decompressor{},
+                directory_chunk_size);
+        is.push(source,
+                directory_chunk_size);
+
+        dir = read_directory(is,
+                             parent,
+                             pkinfo.size,
+                             progress);
+    }
+
+    source.drain();
+
+    return dir;
+}
+
+} // namespace cluster
+} // namespace crete
+
+#endif // CRETE_CLUSTER_DIRECTORY_STREAM_H
@@ -26,6 +26,8 @@ const auto dispatch_root_dir_name = std::string{"dispatch"};
 const auto dispatch_trace_dir_name = std::string{"trace"};
 const auto dispatch_test_case_dir_name = std::string{"test-case"};
 const auto dispatch_profile_dir_name = std::string{"profile"};
+const auto dispatch_profile_capture_dir_name = std::string{"capture"};
+const auto trace_capture_profile_file_name = std::string{"capture_profile.json"};
 const auto dispatch_guest_data_dir_name = std::string{"guest-data"};
 const auto dispatch_guest_config_file_name = std::string{"crete-guest-config.serialized"};
 const auto dispatch_log_finish_file_name = std::string{"finish.log"};
@@ -68,6 +70,7 @@ public:
              const option::Dispatch& options);
 
     auto run() -> bool;
+    auto is_idle() -> bool; // Whether the last run() had nothing to do.
     auto has_nodes() -> bool;
 
 private:
@@ -3,21 +3,30 @@
 
 #include <crete/atomic_guard.h>
 #include <crete/cluster/common.h>
+#include <crete/cluster/directory_stream.h>
 #include <crete/asio/common.h>
 #include <crete/asio/client.h>
 #include <crete/exception.h>
 #include <crete/exception_propagator.h>
 #include <crete/test_case.h>
 #include <crete/async_task.h>
+#include <crete/reactor.h>
 
 #include <boost/thread.hpp>
 #include <boost/filesystem/fstream.hpp>
 
+#include <chrono>
+#include <memory>
+
 namespace crete
 {
 namespace cluster
 {
 
+// Longest the node sleeps between two polls that made no progress. Only bounds the
+// latency of the conditions that wake no one up, e.g. a file written by the guest.
+const auto node_idle_timeout = std::chrono::milliseconds{100};
+
 template <typename Node>
 class NodeDriver : public ExceptionPropagator
 {
@@ -38,6 +47,7 @@ private:
     IPAddress master_ip_address_;
     Port master_port_;
     bool shutdown_ = false;
+    std::shared_ptr<Reactor> reactor_{std::make_shared<Reactor>()}; // Shared, as the driver is copied into its thread.
 };
 
 template <typename Node>
@@ -104,9 +114,11 @@ auto NodeDriver<Node>::run_node(AsyncTask& async_task) -> void
             }
         }
 
+        auto progressed = false;
+
         try
         {
-            node_.acquire()->run();
+            progressed = node_.acquire()->run();
         }
         catch(boost::exception& e)
         {
@@ -120,6 +132,11 @@ auto NodeDriver<Node>::run_node(AsyncTask& async_task) -> void
         {
             BOOST_THROW_EXCEPTION(Exception{} << err::unknown_exception{"originating from NodeDriver<>::run_node"});
         }
+
+        if(!progressed)
+        {
+            reactor_->wait(node_idle_timeout);
+        }
     }
 }
 
@@ -156,6 +173,9 @@ auto NodeDriver<Node>::run_listener() -> void
             shutdown_ = process_default(node_,
                                         request);
         }
+
+        // The request may have given the node something to do (tests, traces, commencement, etc.).
+        reactor_->notify();
     }
 }
 
@@ -301,25 +321,14 @@ auto transmit_trace(Node& node,
 
     auto trace = node.acquire()->pop_trace();
 
-    archive_directory(trace);
-
-    {
-        fs::ifstream ifs{trace,
-                         std::ios::in | std::ios::binary};
-
-        CRETE_EXCEPTION_ASSERT(ifs.good(),
-                               err::file_open_failed{trace.string()});
-
-        write_serialized_binary(client,
-                                pkinfo,
-                                trace.filename().string());
+    write_serialized_binary(client,
+                            pkinfo,
+                            trace.filename().string());
 
-        write(client,
-              ifs,
-              default_chunk_size);
-    }
+    transmit_directory(client,
+                       trace);
 
-    fs::remove(trace);
+    fs::remove_all(trace);
 }
 
 template <typename Node>
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <memory>
+#include <atomic>
 
 #include <boost/thread.hpp>
 
@@ -20,13 +21,32 @@ namespace crete
 namespace cluster
 {
 
-struct CRETE_DLL_EXPORT RegistrarNode
+/**
+ * @brief The NodeConnection struct is the connection to a node, along with the progress of the
+ * stream (trace, tests, image) being transferred over it.
+ *
+ * It has its own lock, apart from the node's AtomicGuard, so that a transfer doesn't block the
+ * accesses to the node's status and the bookkeeping of dispatch while it's in flight.
+ *
+ * Invariants:
+ *  - 'mutex' is held across each exchange with the node (a request and its response).
+ *  - The node's AtomicGuard is never acquired while 'mutex' is held.
+ */
+struct CRETE_DLL_EXPORT NodeConnection
 {
-    RegistrarNode() // Giving 'Server' no port causes it to pick a valid one.
+    NodeConnection() // Giving 'Server' no port causes it to pick a valid one.
     {
     }
 
+    boost::mutex mutex;
     Server server;
+    std::atomic<uint64_t> stream_done{0};
+    std::atomic<uint64_t> stream_size{0}; // 0 when no stream is in flight.
+};
+
+struct CRETE_DLL_EXPORT RegistrarNode
+{
+    std::shared_ptr<NodeConnection> connection{std::make_shared<NodeConnection>()};
     NodeStatus status;
     uint32_t type = 0;
 };
@@ -85,6 +105,7 @@ private:
 };
 
 auto poll(NodeRegistrar::Node& node) -> NodeStatus;
+auto connection(NodeRegistrar::Node& node) -> std::shared_ptr<NodeConnection>;
 
 } // namespace cluster
 } // namespace crete
@@ -30,14 +30,14 @@ public:
 public:
     SVMNode(node::option::SVMNode node_options);
 
-    auto run() -> void;
+    auto run() -> bool; // Returns whether any instance made progress.
     auto start_FSMs() -> void;
     auto have_trace() const -> bool;
     auto add_instance() -> void;
     auto add_instances(size_t count) -> void;
     auto clean() -> void;
     auto reset() -> void;
-    auto poll() -> void;
+    auto poll() -> bool;
     auto traces_directory() const -> boost::filesystem::path;
 
 private:
@@ -28,6 +28,7 @@ struct Translator
         std::string x86;
         std::string x64;
     } path;
+    bool persistent{true}; // Keep one translator worker alive across traces
 };
 
 struct SVM
@@ -22,20 +22,52 @@ namespace cluster
 struct TestCaseTreeNode
 {
     uint64_t m_tc_index;
+    uint64_t m_parent_tc_index; // 0 for the tests without a parent (initial tests, seeds).
     std::vector<uint64_t> m_childern_tc_indexes;
 
-    TestCaseTreeNode() {};
+    TestCaseTreeNode() : m_tc_index{0}, m_parent_tc_index{0} {};
 };
 
+/**
+ * @brief 128-bit content hash of a test case (FNV-1a over its serialized form).
+ */
+struct TestHash
+{
+    uint64_t high;
+    uint64_t low;
+};
+
+inline
+auto operator==(const TestHash& lhs, const TestHash& rhs) -> bool
+{
+    return lhs.high == rhs.high && lhs.low == rhs.low;
+}
+
+inline
+auto hash_value(const TestHash& h) -> std::size_t
+{
+    return static_cast<std::size_t>(h.low);
+}
+
+/**
+ * @brief The TestPool class holds the generated tests, without duplicates.
+ *
+ * Tests are written to 'root/test-case/<index>' as they're inserted, and are only kept in
+ * memory as their hash and their node in the test case tree; the queue of tests to dispatch
+ * holds indexes, and next() reads the test back from its file.
+ *
+ * Tests with the same hash are compared against the test on disk, so that a collision
+ * doesn't drop a new test.
+ */
 class TestPool
 {
 public:
     using TracePath = boost::filesystem::path;
-    using TestQueue = std::deque<crete::TestCase>;
-    using TestHash = std::string;
+    using TestQueue = std::deque<uint64_t>; // Indexes of the tests.
 
 private:
-    boost::unordered_map<TestHash, TestCaseTreeNode> test_tree_;
+    std::vector<TestCaseTreeNode> test_tree_; // Node of test 'index' at 'index - 1'.
+    boost::unordered_multimap<TestHash, uint64_t> test_indexes_;
 
     TestQueue next_;
     std::mt19937 random_engine_; // TODO: currently unused in favor of FIFO; however, should random be optional?
@@ -59,11 +91,17 @@ public:
     auto write_tc_tree(std::ostream& os) -> void const;
 
 private:
+    // 'input_tc_index' is 0 if the input tc isn't in the pool.
+    auto insert(const TestCase& tc, const uint64_t input_tc_index) -> bool;
+    auto test_case_path(const uint64_t tc_index) const -> boost::filesystem::path;
     auto write_test_case(const TestCase& tc, const uint64_t tc_index) -> void;
+    auto read_test_case(const uint64_t tc_index) const -> TestCase;
     auto insert_tc_tree(const TestCase& tc) -> bool;
-    auto insert_tc_tree(const TestCase& tc, const TestCase& input_tc) -> bool;
+    auto insert_tc_tree(const TestCase& tc, const uint64_t input_tc_index) -> bool;
+    // Returns the index of 'tc' (0 if it's not in the pool).
+    auto find(const TestCase& tc, const TestHash& hash) const -> uint64_t;
 
-    auto to_test_hash(const TestCase& tc) -> TestHash;
+    auto to_test_hash(const TestCase& tc) const -> TestHash;
 };
 
 } // namespace cluster
@@ -36,7 +36,7 @@ public:
 
     using Node::update;
 
-    auto run() -> void;
+    auto run() -> bool; // Returns whether any instance made progress.
     auto add_instance() -> void;
     auto add_instances(size_t count) -> void;
     auto start_FSMs() -> void;
@@ -49,7 +49,7 @@ public:
     auto guest_data() -> const boost::optional<GuestData>&;
     auto reset_guest_data() -> void;
 
-    auto poll() -> void;
+    auto poll() -> bool;
 
 private:
     node::option::VMNode node_options_;
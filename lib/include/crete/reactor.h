@@ -0,0 +1,177 @@
+#ifndef CRETE_REACTOR_H
+#define CRETE_REACTOR_H
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <signal.h>
+
+namespace crete
+{
+
+/**
+ * @brief The Reactor class blocks a polling loop until there is something to poll for.
+ *
+ * A loop that drives state machines calls wait() whenever a pass over its FSMs made no
+ * progress. wait() returns as soon as one of the following happens:
+ *  - notify() is called, e.g. by a thread that received a request from the network;
+ *  - an AsyncTask finishes (see notify_all());
+ *  - a child process exits (SIGCHLD);
+ *  - the timeout expires, which covers the conditions no one signals (files showing up, etc.).
+ *
+ * Remarks:
+ *
+ * The FSMs are not thread-safe and are meant to be driven by a single thread, so the reactor
+ * only decides when that thread runs again, rather than running the transitions itself.
+ */
+class Reactor
+{
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    auto operator=(const Reactor&) -> Reactor& = delete;
+
+    // Thread-safe.
+    auto notify() -> void;
+    // Returns false if the timeout expired before any event.
+    auto wait(std::chrono::milliseconds timeout) -> bool;
+
+    // Notifies every reactor of the process.
+    static auto notify_all() -> void;
+
+private:
+    static auto registry_mutex() -> std::mutex&;
+    static auto registry() -> std::vector<Reactor*>&;
+
+    auto wait_child_signal() -> void;
+
+private:
+    boost::asio::io_service io_service_;
+    boost::asio::signal_set child_signals_;
+    boost::asio::steady_timer timer_;
+    std::atomic<bool> notify_pending_{false};
+};
+
+inline
+Reactor::Reactor() :
+    child_signals_{io_service_},
+    timer_{io_service_}
+{
+    child_signals_.add(SIGCHLD);
+
+    // asio installs its handler without SA_RESTART, which would make the blocking calls
+    // of the other threads (socket reads, waitpid, etc.) fail with EINTR when a child exits.
+    struct sigaction sa;
+    if(::sigaction(SIGCHLD, nullptr, &sa) == 0)
+    {
+        sa.sa_flags |= SA_RESTART;
+        ::sigaction(SIGCHLD, &sa, nullptr);
+    }
+
+    wait_child_signal();
+
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+
+    registry().push_back(this);
+}
+
+inline
+Reactor::~Reactor()
+{
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+
+    auto& reactors = registry();
+
+    reactors.erase(std::remove(reactors.begin(),
+                               reactors.end(),
+                               this),
+                   reactors.end());
+}
+
+inline
+auto Reactor::notify() -> void
+{
+    // One pending wake-up is as good as many.
+    if(!notify_pending_.exchange(true, std::memory_order_seq_cst))
+    {
+        io_service_.post([this] {
+            notify_pending_.exchange(false, std::memory_order_seq_cst);
+        });
+    }
+}
+
+inline
+auto Reactor::wait(std::chrono::milliseconds timeout) -> bool
+{
+    auto timed_out = false;
+
+    io_service_.reset();
+
+    timer_.expires_from_now(timeout);
+    timer_.async_wait([&timed_out](const boost::system::error_code& ec) {
+        if(ec != boost::asio::error::operation_aborted)
+        {
+            timed_out = true;
+        }
+    });
+
+    // Returns after the first handler: the timer, a child signal or a notification.
+    io_service_.run_one();
+
+    timer_.cancel();
+
+    // Runs the handler of the cancelled timer, and whatever else is ready.
+    io_service_.poll();
+
+    return !timed_out;
+}
+
+inline
+auto Reactor::notify_all() -> void
+{
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+
+    for(auto reactor : registry())
+    {
+        reactor->notify();
+    }
+}
+
+inline
+auto Reactor::registry_mutex() -> std::mutex&
+{
+    static std::mutex m;
+
+    return m;
+}
+
+inline
+auto Reactor::registry() -> std::vector<Reactor*>&
+{
+    static std::vector<Reactor*> reactors;
+
+    return reactors;
+}
+
+inline
+auto Reactor::wait_child_signal() -> void
+{
+    child_signals_.async_wait([this](const boost::system::error_code& ec, int) {
+        if(ec != boost::asio::error::operation_aborted)
+        {
+            wait_child_signal();
+        }
+    });
+}
+
+} // namespace crete
+
+#endif // CRETE_REACTOR_H
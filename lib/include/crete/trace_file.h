@@ -0,0 +1,242 @@
+#ifndef CRETE_TRACE_FILE_H
+#define CRETE_TRACE_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <utility>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+
+namespace crete
+{
+namespace trace
+{
+    // Layout of a trace file:
+    //
+    //   FileHeader
+    //   chunk 0: ChunkHeader, tb boundaries (uint64_t[tb_count + 1]), records
+    //   ...
+    //   chunk n-1
+    //   ChunkIndexEntry[chunk_count], starting at FileHeader::index_offset
+    //
+    // Each chunk holds the records of a range of consecutive TBs for one ChunkType.
+    // Records of the i-th TB of a chunk are [boundaries[i], boundaries[i+1]), relative
+    // to the end of the boundaries. Every section starts at an 8-byte aligned offset,
+    // so that a mmap'ed file can be accessed in place.
+    //
+    // The boundaries and records of a chunk may be stored compressed (see ChunkCodec), in
+    // which case TraceReader inflates the chunk on access, keeping only the most recently
+    // accessed compressed chunk of each type.
+    const char file_magic[8] = {'C', 'R', 'E', 'T', 'E', 'T', 'R', 'C'};
+    const uint32_t file_version = 3;
+
+    enum ChunkType
+    {
+        chunk_cpu_sync_tables = 1,
+        chunk_memo_sync_tables = 2,
+        chunk_interrupt_states = 3,
+        chunk_tb_post_sync_tables = 4, // optional, see below
+        chunk_tb_irs = 5,
+        chunk_tb_exec_sequence = 6
+    };
+
+    // Compression of chunk payload. Other values are reserved.
+    enum ChunkCodec
+    {
+        codec_none = 0,
+        codec_zlib = 1 // zlib stream (compress2())
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t chunk_count;
+        uint64_t index_offset;
+    };
+
+    struct ChunkHeader
+    {
+        uint32_t type;
+        uint32_t codec;
+        uint64_t first_tb;
+        uint64_t tb_count;
+        uint64_t raw_size;    // size of boundaries and records
+        uint64_t stored_size; // size of boundaries and records on disk
+    };
+
+    struct ChunkIndexEntry
+    {
+        uint32_t type;
+        uint32_t codec;
+        uint64_t offset; // of ChunkHeader
+        uint64_t first_tb;
+        uint64_t tb_count;
+    };
+
+    // Fixed-layout records
+
+    // chunk_cpu_sync_tables: one CPUSyncTableHeader per TB, followed by
+    // CPUSyncRecord[element_count] and the data of all the elements
+    struct CPUSyncTableHeader
+    {
+        uint32_t valid;
+        uint32_t element_count;
+    };
+
+    struct CPUSyncRecord
+    {
+        uint32_t field_id;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t data_offset;
+    };
+
+    // chunk_tb_post_sync_tables: same layout as chunk_cpu_sync_tables, holding the
+    // concrete CPUState fields written by a TB itself, which are applied after the TB
+    // instead of being computed by its sliced bitcode. Traces captured without TB
+    // slicing have no chunk of this type.
+
+    // chunk_memo_sync_tables: MemoLoadRecord[] per TB, in the order of loads. When
+    // records overlap, the bytes of the earliest record are the ones to sync.
+    struct MemoLoadRecord
+    {
+        uint64_t addr;
+        uint64_t value; // little-endian, size bytes
+        uint32_t size;
+        uint32_t padding;
+    };
+
+    // chunk_interrupt_states: zero or one InterruptRecord per TB
+    struct InterruptRecord
+    {
+        int32_t intno;
+        int32_t is_int;
+        int32_t error_code;
+        int32_t next_eip_addend;
+    };
+
+    // chunk_tb_irs: indexed by tracing window rather than by TB, one entry per chunk.
+    // The entry of a window is a TBIRHeader, followed by the TCGLLVMOfflineContext of the
+    // window as a boost binary archive, which the translator loads. The TCG IR has no
+    // fixed layout of its own, so the archive is kept as the payload.
+    struct TBIRHeader
+    {
+        uint64_t size; // of the archive
+    };
+
+    // chunk_tb_exec_sequence: one uint64_t per executed TB, its guest pc, in the order of
+    // execution
+
+    // Accumulates records of consecutive TBs for one chunk
+    class ChunkBuilder
+    {
+    public:
+        ChunkBuilder(ChunkType type, uint64_t first_tb);
+
+        // Starts the records of the next TB
+        void begin_tb();
+        void append(const void* data, uint64_t size);
+
+        template <typename T>
+        void append(const T& record) { append(&record, sizeof(T)); }
+
+        ChunkType get_type() const { return type_; }
+        uint64_t get_first_tb() const { return first_tb_; }
+        uint64_t get_tb_count() const { return boundaries_.size(); }
+        const std::vector<uint64_t>& get_boundaries() const { return boundaries_; }
+        const std::vector<uint8_t>& get_records() const { return records_; }
+
+    private:
+        ChunkType type_;
+        uint64_t first_tb_;
+        std::vector<uint64_t> boundaries_; // Start of each TB
+        std::vector<uint8_t> records_;
+    };
+
+    class TraceWriter : boost::noncopyable
+    {
+    public:
+        TraceWriter();
+        ~TraceWriter();
+
+        // Chunks are compressed with codec, unless that doesn't make them smaller
+        void open(const std::string& path, ChunkCodec codec = codec_zlib);
+        bool is_open() const { return ofs_.is_open(); }
+        void write_chunk(const ChunkBuilder& chunk);
+        // Writes records of consecutive TBs laid out contiguously, where boundaries
+        // holds the offset of each TB within records (see ChunkBuilder)
+        void write_chunk(ChunkType type, uint64_t first_tb,
+                         const std::vector<uint64_t>& boundaries,
+                         const void* records, uint64_t size);
+        // Flushes the chunks written so far to disk
+        void sync();
+        // Writes the chunk index, which is required by TraceReader, and syncs the file
+        void close();
+
+    private:
+        void write_padding();
+
+    private:
+        std::ofstream ofs_;
+        std::string path_;
+        ChunkCodec codec_;
+        std::vector<ChunkIndexEntry> index_;
+        std::vector<uint8_t> raw_;        // Scratch buffers of compression
+        std::vector<uint8_t> compressed_;
+    };
+
+    // Flushes the file at path to disk (fsync()), throwing on failure
+    void sync_file(const std::string& path);
+
+    // The file is validated by open() and get_tb_records(), which throw on a truncated
+    // or corrupt trace. Not thread-safe: compressed chunks are inflated on access.
+    class TraceReader : boost::noncopyable
+    {
+    public:
+        TraceReader();
+        ~TraceReader();
+
+        void open(const std::string& path);
+        bool is_open() const { return data_ != NULL; }
+        void close();
+
+        // Total number of TBs over all the chunks of type
+        uint64_t get_tb_count(ChunkType type) const;
+        // Records of tb_index within the chunks of type: <begin, size>, where size is 0 if
+        // the TB has no record. Records not ending at an 8-byte boundary are followed by
+        // padding, which is counted in size. Records of a compressed chunk are valid until
+        // a record of another chunk of the same type is accessed, or close().
+        std::pair<const uint8_t*, uint64_t> get_tb_records(ChunkType type, uint64_t tb_index) const;
+
+    private:
+        const ChunkIndexEntry* find_chunk(ChunkType type, uint64_t tb_index) const;
+        void validate_chunk(const ChunkIndexEntry& entry, uint64_t index_offset) const;
+        void validate_boundaries(const uint8_t* payload, uint64_t raw_size, uint64_t tb_count) const;
+        // Boundaries and records of the chunk, inflated if need be
+        const uint8_t* get_payload(const ChunkIndexEntry& entry) const;
+
+        struct InflatedChunk
+        {
+            InflatedChunk() : entry(NULL) {}
+
+            const ChunkIndexEntry* entry;
+            std::vector<uint8_t> payload;
+        };
+
+    private:
+        std::string path_;
+        const uint8_t* data_;
+        uint64_t size_;
+        std::vector<ChunkIndexEntry> index_; // Sorted by type and first TB
+        mutable std::map<uint32_t, InflatedChunk> inflated_; // Keyed by chunk type
+    };
+} // namespace trace
+} // namespace crete
+
+#endif // CRETE_TRACE_FILE_H
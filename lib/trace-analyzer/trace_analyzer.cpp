@@ -1,6 +1,8 @@
 #include <crete/trace_analyzer.h>
+#include <crete/trace_file.h>
 #include <crete/util/cycle.h>
 
+#include <cstring>
 #include <iostream>
 #include <functional>
 
@@ -47,8 +49,8 @@ auto TraceAnalyzer::operator=(const TraceAnalyzer& other) -> TraceAnalyzer&
 
 bool TraceAnalyzer::insert_trace(const filesystem::path& path)
 {
-    std::cerr << "before parse_trace: " << (path / "tb-seq.bin").string() << std::endl;
-    auto trace = parse_trace(path / "tb-seq.bin");
+    std::cerr << "before parse_trace: " << (path / "dump_trace.bin").string() << std::endl;
+    auto trace = parse_trace(path / "dump_trace.bin");
 
     if(compress_traces_)
     {
@@ -262,17 +264,27 @@ void TraceAnalyzer::initialize_log()
     assert(0 && "pending implementation of crete::logger");
 }
 
+// The blocks are the chunk_tb_exec_sequence of the trace file at path
 Trace parse_trace(const boost::filesystem::path& path)
 {
-    filesystem::ifstream ifs(path, ios_base::in | ios_base::binary);
-    if(!ifs.good())
-        throw runtime_error("failed to open file: " + path.generic_string());
+    trace::TraceReader reader;
+    reader.open(path.string());
+
+    auto count = reader.get_tb_count(trace::chunk_tb_exec_sequence);
 
     Trace::Blocks blocks;
+    blocks.reserve(count);
+
+    for(auto i = uint64_t{0}; i < count; ++i)
+    {
+        auto record = reader.get_tb_records(trace::chunk_tb_exec_sequence, i);
+        if(record.second != sizeof(uint64_t))
+            throw runtime_error("invalid tb sequence in file: " + path.generic_string());
 
-    auto block_addr = uint64_t{0};
-    while(ifs.read(reinterpret_cast<char*>(&block_addr), sizeof(uint64_t)))
+        auto block_addr = uint64_t{0};
+        memcpy(&block_addr, record.first, sizeof(uint64_t));
         blocks.push_back(block_addr);
+    }
 
     return Trace{path.parent_path().generic_string(), blocks};
 }
@@ -0,0 +1,514 @@
+#include <crete/trace_file.h>
+#include <crete/exception.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <zlib.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace crete
+{
+namespace trace
+{
+    static const uint64_t section_alignment = 8;
+
+    static uint64_t align_up(uint64_t value)
+    {
+        return (value + section_alignment - 1) & ~(section_alignment - 1);
+    }
+
+    // Order of the chunk index kept by TraceReader: by type, then by first TB
+    static bool chunk_less(const ChunkIndexEntry& lhs, const ChunkIndexEntry& rhs)
+    {
+        if(lhs.type != rhs.type)
+            return lhs.type < rhs.type;
+
+        return lhs.first_tb < rhs.first_tb;
+    }
+
+    ChunkBuilder::ChunkBuilder(ChunkType type, uint64_t first_tb) :
+        type_(type),
+        first_tb_(first_tb)
+    {
+    }
+
+    void ChunkBuilder::begin_tb()
+    {
+        records_.resize(align_up(records_.size()), 0);
+        boundaries_.push_back(records_.size());
+    }
+
+    void ChunkBuilder::append(const void* data, uint64_t size)
+    {
+        assert(!boundaries_.empty() && "begin_tb() must be called before appending records");
+
+        const uint8_t* begin = static_cast<const uint8_t*>(data);
+        records_.insert(records_.end(), begin, begin + size);
+    }
+
+    void sync_file(const string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path));
+        }
+
+        int ret;
+        do
+        {
+            ret = fsync(fd);
+        } while(ret != 0 && errno == EINTR);
+        int error = errno;
+
+        ::close(fd);
+
+        if(ret != 0)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path)
+                                              << err::msg(string("fsync failed: ") + strerror(error)));
+        }
+    }
+
+    // Largest expansion of zlib's deflate, used to bound the size of inflated chunks
+    static const uint64_t zlib_max_ratio = 1032;
+
+    TraceWriter::TraceWriter() :
+        codec_(codec_none)
+    {
+    }
+
+    TraceWriter::~TraceWriter()
+    {
+        if(is_open())
+        {
+            try
+            {
+                close();
+            }
+            catch(std::exception& e)
+            {
+                cerr << "[CRETE ERROR] " << e.what() << endl;
+            }
+        }
+    }
+
+    void TraceWriter::open(const string& path, ChunkCodec codec)
+    {
+        assert(!is_open());
+
+        ofs_.open(path.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+        if(!ofs_.good())
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path));
+        }
+
+        path_ = path;
+        codec_ = codec;
+        index_.clear();
+
+        // Patched by close()
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        ofs_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    void TraceWriter::write_padding()
+    {
+        static const char zeros[section_alignment] = {0};
+
+        uint64_t pos = ofs_.tellp();
+        ofs_.write(zeros, align_up(pos) - pos);
+    }
+
+    void TraceWriter::write_chunk(const ChunkBuilder& chunk)
+    {
+        const vector<uint8_t>& records = chunk.get_records();
+
+        write_chunk(chunk.get_type(),
+                    chunk.get_first_tb(),
+                    chunk.get_boundaries(),
+                    records.data(),
+                    records.size());
+    }
+
+    void TraceWriter::write_chunk(ChunkType type,
+                                  uint64_t first_tb,
+                                  const vector<uint64_t>& boundaries,
+                                  const void* records,
+                                  uint64_t size)
+    {
+        assert(is_open());
+
+        const uint64_t end_of_records = size;
+        const uint64_t boundaries_size = boundaries.size() * sizeof(uint64_t);
+
+        ChunkIndexEntry entry;
+        entry.type = type;
+        entry.codec = codec_none;
+        entry.offset = ofs_.tellp();
+        entry.first_tb = first_tb;
+        entry.tb_count = boundaries.size();
+
+        ChunkHeader header;
+        header.type = entry.type;
+        header.codec = entry.codec;
+        header.first_tb = entry.first_tb;
+        header.tb_count = entry.tb_count;
+        header.raw_size = boundaries_size + sizeof(uint64_t) + size;
+        header.stored_size = header.raw_size;
+
+        if(codec_ == codec_zlib)
+        {
+            raw_.resize(header.raw_size);
+            memcpy(raw_.data(), boundaries.data(), boundaries_size);
+            memcpy(raw_.data() + boundaries_size, &end_of_records, sizeof(uint64_t));
+            memcpy(raw_.data() + boundaries_size + sizeof(uint64_t), records, size);
+
+            uLongf compressed_size = compressBound(raw_.size());
+            compressed_.resize(compressed_size);
+
+            // Stored as is if compression doesn't pay off
+            if(compress2(compressed_.data(), &compressed_size,
+                         raw_.data(), raw_.size(), Z_BEST_SPEED) == Z_OK &&
+               compressed_size < header.raw_size)
+            {
+                entry.codec = header.codec = codec_zlib;
+                header.stored_size = compressed_size;
+            }
+        }
+
+        ofs_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if(entry.codec == codec_zlib)
+        {
+            ofs_.write(reinterpret_cast<const char*>(compressed_.data()), header.stored_size);
+        }
+        else
+        {
+            ofs_.write(reinterpret_cast<const char*>(boundaries.data()), boundaries_size);
+            ofs_.write(reinterpret_cast<const char*>(&end_of_records), sizeof(uint64_t));
+            ofs_.write(reinterpret_cast<const char*>(records), size);
+        }
+        write_padding();
+
+        if(!ofs_.good())
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("failed to write chunk"));
+        }
+
+        index_.push_back(entry);
+    }
+
+    void TraceWriter::sync()
+    {
+        assert(is_open());
+
+        ofs_.flush();
+        if(!ofs_.good())
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("failed to write chunk"));
+        }
+
+        sync_file(path_);
+    }
+
+    void TraceWriter::close()
+    {
+        assert(is_open());
+
+        FileHeader header;
+        memcpy(header.magic, file_magic, sizeof(header.magic));
+        header.version = file_version;
+        header.flags = 0;
+        header.chunk_count = index_.size();
+        header.index_offset = ofs_.tellp();
+
+        ofs_.write(reinterpret_cast<const char*>(index_.data()),
+                   index_.size() * sizeof(ChunkIndexEntry));
+        ofs_.seekp(0);
+        ofs_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs_.flush();
+
+        bool good = ofs_.good();
+        ofs_.close();
+
+        if(!good)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("failed to write chunk index"));
+        }
+
+        sync_file(path_);
+    }
+
+    TraceReader::TraceReader() :
+        data_(NULL),
+        size_(0)
+    {
+    }
+
+    TraceReader::~TraceReader()
+    {
+        close();
+    }
+
+    void TraceReader::open(const string& path)
+    {
+        assert(!is_open());
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file_open_failed(path));
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(FileHeader))
+        {
+            ::close(fd);
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path)
+                                              << err::msg("invalid trace file size"));
+        }
+
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if(data == MAP_FAILED)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path)
+                                              << err::msg("mmap failed"));
+        }
+
+        path_ = path;
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = st.st_size;
+
+        const FileHeader* header = reinterpret_cast<const FileHeader*>(data_);
+        if(memcmp(header->magic, file_magic, sizeof(header->magic)) != 0 ||
+           header->version != file_version ||
+           header->index_offset < sizeof(FileHeader) ||
+           header->index_offset > size_ ||
+           header->chunk_count > (size_ - header->index_offset) / sizeof(ChunkIndexEntry))
+        {
+            close();
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path)
+                                              << err::msg("not a valid trace file or version mismatch"));
+        }
+
+        const ChunkIndexEntry* entries =
+                reinterpret_cast<const ChunkIndexEntry*>(data_ + header->index_offset);
+        index_.assign(entries, entries + header->chunk_count);
+        sort(index_.begin(), index_.end(), chunk_less);
+
+        try
+        {
+            for(vector<ChunkIndexEntry>::const_iterator it = index_.begin();
+                it != index_.end();
+                ++it)
+            {
+                validate_chunk(*it, header->index_offset);
+
+                // Chunks of a type don't overlap, which find_chunk() relies on
+                vector<ChunkIndexEntry>::const_iterator next = it + 1;
+                if(next != index_.end() && next->type == it->type &&
+                   next->first_tb < it->first_tb + it->tb_count)
+                {
+                    BOOST_THROW_EXCEPTION(Exception() << err::file(path)
+                                                      << err::msg("overlapping trace chunks"));
+                }
+            }
+        }
+        catch(...)
+        {
+            close();
+            throw;
+        }
+    }
+
+    // Checks the chunk against the index and the size of the file. The boundaries of
+    // compressed chunks are checked once inflated.
+    void TraceReader::validate_chunk(const ChunkIndexEntry& entry, uint64_t index_offset) const
+    {
+        if(entry.codec != codec_none && entry.codec != codec_zlib)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("unsupported chunk codec"));
+        }
+
+        if(entry.offset % section_alignment != 0 ||
+           entry.offset < sizeof(FileHeader) ||
+           entry.offset > index_offset ||
+           index_offset - entry.offset < sizeof(ChunkHeader) ||
+           entry.first_tb + entry.tb_count < entry.first_tb)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("trace chunk out of the bounds of the file"));
+        }
+
+        const ChunkHeader* header = reinterpret_cast<const ChunkHeader*>(data_ + entry.offset);
+        const uint64_t available = index_offset - entry.offset - sizeof(ChunkHeader);
+
+        if(header->type != entry.type ||
+           header->codec != entry.codec ||
+           header->first_tb != entry.first_tb ||
+           header->tb_count != entry.tb_count ||
+           header->stored_size > available ||
+           header->raw_size / sizeof(uint64_t) <= header->tb_count ||
+           (header->codec == codec_none && header->stored_size != header->raw_size) ||
+           (header->codec == codec_zlib && header->raw_size / zlib_max_ratio > header->stored_size))
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("invalid trace chunk header"));
+        }
+
+        if(header->codec == codec_none)
+        {
+            validate_boundaries(reinterpret_cast<const uint8_t*>(header + 1),
+                                header->raw_size,
+                                header->tb_count);
+        }
+    }
+
+    // Boundaries are non-decreasing and within the records
+    void TraceReader::validate_boundaries(const uint8_t* payload,
+                                          uint64_t raw_size,
+                                          uint64_t tb_count) const
+    {
+        const uint64_t* boundaries = reinterpret_cast<const uint64_t*>(payload);
+        const uint64_t records_size = raw_size - (tb_count + 1) * sizeof(uint64_t);
+
+        for(uint64_t i = 0; i < tb_count; ++i)
+        {
+            if(boundaries[i] > boundaries[i + 1])
+            {
+                BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                                  << err::msg("invalid trace chunk boundaries"));
+            }
+        }
+
+        if(boundaries[tb_count] > records_size)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("trace chunk records out of bounds"));
+        }
+    }
+
+    const uint8_t* TraceReader::get_payload(const ChunkIndexEntry& entry) const
+    {
+        const ChunkHeader* header = reinterpret_cast<const ChunkHeader*>(data_ + entry.offset);
+        const uint8_t* stored = reinterpret_cast<const uint8_t*>(header + 1);
+
+        if(entry.codec == codec_none)
+            return stored;
+
+        // Replaces the last inflated chunk of the type, so that reading a trace in order
+        // holds one inflated chunk per type
+        InflatedChunk& inflated = inflated_[entry.type];
+        if(inflated.entry != &entry)
+        {
+            inflated.entry = NULL;
+            vector<uint8_t>().swap(inflated.payload);
+
+            vector<uint8_t> raw(header->raw_size);
+            uLongf raw_size = raw.size();
+
+            if(uncompress(raw.data(), &raw_size, stored, header->stored_size) != Z_OK ||
+               raw_size != header->raw_size)
+            {
+                BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                                  << err::msg("corrupt compressed trace chunk"));
+            }
+
+            validate_boundaries(raw.data(), header->raw_size, header->tb_count);
+
+            inflated.payload.swap(raw);
+            inflated.entry = &entry;
+        }
+
+        return inflated.payload.data();
+    }
+
+    void TraceReader::close()
+    {
+        if(data_)
+        {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+
+        data_ = NULL;
+        size_ = 0;
+        index_.clear();
+        inflated_.clear();
+    }
+
+    uint64_t TraceReader::get_tb_count(ChunkType type) const
+    {
+        uint64_t count = 0;
+        for(vector<ChunkIndexEntry>::const_iterator it = index_.begin();
+            it != index_.end();
+            ++it)
+        {
+            if(it->type == (uint32_t)type)
+                count += it->tb_count;
+        }
+
+        return count;
+    }
+
+    const ChunkIndexEntry* TraceReader::find_chunk(ChunkType type, uint64_t tb_index) const
+    {
+        // The last chunk of type starting at or before tb_index is the only candidate
+        ChunkIndexEntry key;
+        memset(&key, 0, sizeof(key));
+        key.type = type;
+        key.first_tb = tb_index;
+
+        vector<ChunkIndexEntry>::const_iterator it =
+                upper_bound(index_.begin(), index_.end(), key, chunk_less);
+        if(it == index_.begin())
+            return NULL;
+
+        --it;
+        if(it->type == (uint32_t)type && tb_index < it->first_tb + it->tb_count)
+            return &*it;
+
+        return NULL;
+    }
+
+    pair<const uint8_t*, uint64_t> TraceReader::get_tb_records(ChunkType type, uint64_t tb_index) const
+    {
+        assert(is_open());
+
+        const ChunkIndexEntry* entry = find_chunk(type, tb_index);
+        if(!entry)
+        {
+            BOOST_THROW_EXCEPTION(Exception() << err::file(path_)
+                                              << err::msg("tb is out of range of trace chunks"));
+        }
+
+        // Validated by open() (or get_payload() for compressed chunks)
+        const uint64_t* boundaries =
+                reinterpret_cast<const uint64_t*>(get_payload(*entry));
+        const uint8_t* records =
+                reinterpret_cast<const uint8_t*>(boundaries + entry->tb_count + 1);
+
+        uint64_t i = tb_index - entry->first_tb;
+        uint64_t begin = boundaries[i];
+        uint64_t end = boundaries[i + 1];
+
+        return make_pair(records + begin, end - begin);
+    }
+} // namespace trace
+} // namespace crete